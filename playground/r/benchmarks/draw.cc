@@ -0,0 +1,198 @@
+// Draw throughput in triangles/second: the indexed pipeline on the
+// head model and on generated grids of up to 1M triangles, against
+// the original per-vertex path, which copies the vertex array on
+// each access; and on stacks of grids drawn front to back, which the
+// depth pyramid rejects.
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <vector>
+
+#include "../r.h"
+
+namespace {
+
+// The width and height of the canvas, as main.cc.
+static const size_t resolution = 2048;
+
+static const vec3f light{0, 0, -1};
+static const pixel color{255, 180, 140};
+
+// An indexed triangle list.
+struct mesh {
+  std::vector<vec3f> verts;
+  std::vector<int> faces;
+};
+
+// Return a square grid of about n triangles which covers most of the
+// screen, with a displaced depth. The grid stays clear of the bottom
+// row, which is out of bounds on an inverted canvas.
+mesh grid(const size_t n) {
+  const size_t side = static_cast<size_t>(std::sqrt(n / 2.0));
+  mesh out;
+
+  for (size_t y = 0; y <= side; y++) {
+    for (size_t x = 0; x <= side; x++) {
+      const float u = static_cast<float>(x) / side;
+      const float v = static_cast<float>(y) / side;
+      out.verts.emplace_back(1.8f * u - .9f, 1.8f * v - .9f,
+                             .1f * std::sin(20 * u) * std::cos(20 * v));
+    }
+  }
+
+  for (size_t y = 0; y < side; y++) {
+    for (size_t x = 0; x < side; x++) {
+      const auto i = static_cast<int>(y * (side + 1) + x);
+      const auto j = static_cast<int>(i + side + 1);
+      out.faces.insert(out.faces.end(), {i, i + 1, j, i + 1, j + 1, j});
+    }
+  }
+
+  return out;
+}
+
+// Return n copies of a grid of about 16K triangles, each further from
+// the viewer than the last.
+mesh layers(const size_t n) {
+  const mesh layer = grid(1 << 14);
+  mesh out;
+
+  for (size_t i = 0; i < n; i++) {
+    const auto base = static_cast<int>(out.verts.size());
+    for (const auto& v : layer.verts)
+      out.verts.push_back(v - vec3f{0, 0, static_cast<float>(i)});
+    for (const int f : layer.faces)
+      out.faces.push_back(base + f);
+  }
+
+  return out;
+}
+
+mesh head() {
+  const Model model{"playground/r/african_head.obj"};
+  return mesh{model.verts(), model.faces()};
+}
+
+// The original draw loop, with a by-value vertex accessor.
+class Legacy : public Canvas {
+ public:
+  Legacy() : Canvas(resolution, resolution, pixel{255}) {}
+
+  void solid(const mesh& m) {
+    const auto verts = [&]() { return m.verts; };
+
+    for (size_t f = 0; f < m.faces.size(); f += 3) {
+      vec3f screen_coords[3];
+      vec3f world_coords[3];
+
+      for (unsigned int i = 0; i < 3; ++i) {
+        vec3f v = verts()[size_t(m.faces[f + i])];
+        world_coords[i] = v;
+        screen_coords[i] = world2screen(v);
+      }
+
+      vec3f n = (world_coords[2] - world_coords[0]) ^
+                (world_coords[1] - world_coords[0]);
+      n.normalize();
+
+      float intensity = n * light;
+      if (intensity > 0)
+        triangle(screen_coords[0], screen_coords[1], screen_coords[2],
+                 color * intensity);
+    }
+  }
+};
+
+// Draw into a new canvas on each iteration, so that the depth test
+// does not reject every pixel after the first.
+void draw(benchmark::State& state, const mesh& m) {
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    Canvas canvas{resolution, resolution, pixel{255}};
+    state.ResumeTiming();
+
+    canvas.draw(m.verts.data(), m.verts.size(),
+                m.faces.data(), m.faces.size(), light, color);
+  }
+
+  state.SetItemsProcessed(state.iterations() * (m.faces.size() / 3));
+}
+
+void legacy(benchmark::State& state, const mesh& m) {
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    Legacy canvas;
+    state.ResumeTiming();
+
+    canvas.solid(m);
+  }
+
+  state.SetItemsProcessed(state.iterations() * (m.faces.size() / 3));
+}
+
+void BM_DrawHead(benchmark::State& state) {
+  draw(state, head());
+}
+BENCHMARK(BM_DrawHead)->Unit(benchmark::kMillisecond);
+
+void BM_DrawHeadLegacy(benchmark::State& state) {
+  legacy(state, head());
+}
+BENCHMARK(BM_DrawHeadLegacy)->Unit(benchmark::kMillisecond);
+
+void BM_DrawGrid(benchmark::State& state) {
+  draw(state, grid(static_cast<size_t>(state.range(0))));
+}
+BENCHMARK(BM_DrawGrid)->Range(1 << 10, 1 << 20)
+    ->Unit(benchmark::kMillisecond);
+
+// Quadratic in the mesh size, so limited to small grids.
+void BM_DrawGridLegacy(benchmark::State& state) {
+  legacy(state, grid(static_cast<size_t>(state.range(0))));
+}
+BENCHMARK(BM_DrawGridLegacy)->Range(1 << 10, 1 << 14)
+    ->Unit(benchmark::kMillisecond);
+
+void BM_DrawLayers(benchmark::State& state) {
+  const mesh m = layers(static_cast<size_t>(state.range(0)));
+  render_stats stats;
+
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    Canvas canvas{resolution, resolution, pixel{255}};
+    state.ResumeTiming();
+
+    canvas.draw(m.verts.data(), m.verts.size(),
+                m.faces.data(), m.faces.size(), light, color);
+
+    state.PauseTiming();
+    stats = canvas.stats();
+    state.ResumeTiming();
+  }
+
+  state.SetItemsProcessed(state.iterations() * (m.faces.size() / 3));
+  state.counters["occluded"] = static_cast<double>(stats.tiles_occluded)
+                               / static_cast<double>(stats.tiles);
+  state.counters["overdraw"] = static_cast<double>(stats.writes)
+                               / static_cast<double>(stats.pixels);
+}
+BENCHMARK(BM_DrawLayers)->RangeMultiplier(4)->Range(1, 64)
+    ->Unit(benchmark::kMillisecond);
+
+void BM_Transform(benchmark::State& state) {
+  const mesh m = grid(static_cast<size_t>(state.range(0)));
+  const Canvas canvas{resolution, resolution};
+  screen_buffer screen;
+
+  while (state.KeepRunning()) {
+    canvas.transform(m.verts.data(), m.verts.size(), &screen);
+    benchmark::DoNotOptimize(screen.x.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * m.verts.size());
+}
+BENCHMARK(BM_Transform)->Range(1 << 10, 1 << 20);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,93 @@
+// Fill rate in pixels/second: the edge function rasteriser against
+// the per-pixel barycentric() path, for random triangles from 4 to
+// 1024 pixels across.
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "../r.h"
+
+namespace {
+
+// The width and height of the depth buffer, as main.cc.
+static const int resolution = 2048;
+
+// Return n random triangles of about `size' pixels across, with whole
+// pixel vertices, and the number of pixels they cover.
+std::vector<vec3f> triangles(const int size, const size_t n,
+                             size_t* pixels) {
+  std::mt19937 rng{0};
+  std::uniform_int_distribution<int> origin{0, resolution - size - 1};
+  std::uniform_int_distribution<int> offset{0, size};
+  std::uniform_real_distribution<float> depth{-1, 1};
+  std::vector<vec3f> out;
+
+  *pixels = 0;
+  for (size_t i = 0; i < n; i++) {
+    const int x = origin(rng), y = origin(rng);
+    vec3f t[3];
+    for (auto& v : t)
+      v = vec3f{static_cast<float>(x + offset(rng)),
+                static_cast<float>(y + offset(rng)), depth(rng)};
+    out.insert(out.end(), t, t + 3);
+
+    raster::fill(t[0], t[1], t[2], 0, 0, resolution - 1, resolution - 1,
+                 [&](size_t, size_t, float) { ++*pixels; });
+  }
+
+  return out;
+}
+
+// Rasterise the triangles into a depth buffer with `fill(t0, t1, t2,
+// plot)'.
+template<typename Fill>
+void fill_rate(benchmark::State& state, Fill fill) {
+  size_t pixels;
+  const auto tris = triangles(static_cast<int>(state.range(0)), 256,
+                              &pixels);
+  std::vector<float> zbuffer(resolution * resolution,
+                             -std::numeric_limits<float>::max());
+
+  const auto plot = [&](const size_t x, const size_t y, const float z) {
+    float& depth = zbuffer[y * resolution + x];
+    if (depth < z)
+      depth = z;
+  };
+
+  while (state.KeepRunning()) {
+    for (size_t i = 0; i < tris.size(); i += 3)
+      fill(tris[i], tris[i + 1], tris[i + 2], plot);
+    benchmark::DoNotOptimize(zbuffer.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * pixels);
+}
+
+void BM_FillEdge(benchmark::State& state) {
+  fill_rate(state, [](const vec3f& t0, const vec3f& t1, const vec3f& t2,
+                      const auto& plot) {
+    raster::fill(t0, t1, t2, 0, 0, resolution - 1, resolution - 1, plot);
+  });
+}
+BENCHMARK(BM_FillEdge)->Range(4, 1024);
+
+void BM_FillBarycentric(benchmark::State& state) {
+  fill_rate(state, [](const vec3f& t0, const vec3f& t1, const vec3f& t2,
+                      const auto& plot) {
+    vec2f bboxmin, bboxmax;
+    for (unsigned int j = 0; j < 2; ++j) {
+      bboxmin[j] = std::max(0.0f, std::min({t0[j], t1[j], t2[j]}));
+      bboxmax[j] = std::min(float(resolution - 1),
+                            std::max({t0[j], t1[j], t2[j]}));
+    }
+    raster::fill_barycentric(t0, t1, t2, bboxmin, bboxmax, plot);
+  });
+}
+BENCHMARK(BM_FillBarycentric)->Range(4, 1024);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,122 @@
+// Model load time: the memory mapped parser, with one thread and
+// with one thread per core, against the original getline and
+// istringstream parser, on generated models of up to 4M faces.
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../r.h"
+
+namespace {
+
+// Return the path of a generated model of n faces, writing it on
+// first use. The model is a square grid of vertices with a
+// displaced height, and faces in "v/vt/vn" form.
+std::string grid(const size_t n) {
+  const std::string path = "load_" + std::to_string(n) + ".obj";
+
+  if (std::ifstream{path}.good())
+    return path;
+
+  const size_t side = static_cast<size_t>(std::sqrt(n / 2.0));
+  FILE* out = std::fopen(path.c_str(), "w");
+
+  for (size_t y = 0; y <= side; y++) {
+    for (size_t x = 0; x <= side; x++) {
+      const float u = static_cast<float>(x) / side;
+      const float v = static_cast<float>(y) / side;
+      std::fprintf(out, "v %.6f %.6f %.6f\n", 2 * u - 1, 2 * v - 1,
+                   .1 * std::sin(20 * u) * std::cos(20 * v));
+    }
+  }
+
+  for (size_t y = 0; y < side; y++) {
+    for (size_t x = 0; x < side; x++) {
+      const size_t i = y * (side + 1) + x + 1, j = i + side + 1;
+      std::fprintf(out, "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n",
+                   i, i, i, j, j, j, i + 1, i + 1, i + 1);
+      std::fprintf(out, "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n",
+                   i + 1, i + 1, i + 1, j, j, j, j + 1, j + 1, j + 1);
+    }
+  }
+
+  std::fclose(out);
+  return path;
+}
+
+// The original loader, which reads a line at a time and stores each
+// face as its own vector.
+size_t legacy(const std::string& filename) {
+  std::vector<vec3f> verts;
+  std::vector<std::vector<int>> faces;
+  std::ifstream in{filename, std::ifstream::in};
+  std::string line;
+
+  while (!in.eof()) {
+    std::getline(in, line);
+    std::istringstream iss(line.c_str());
+
+    char trash;
+    if (!line.compare(0, 2, "v ")) {
+      iss >> trash;
+      vec3f v;
+      for (size_t i = 0; i < 3; i++)
+        iss >> v[i];
+      verts.push_back(v);
+    } else if (!line.compare(0, 2, "f ")) {
+      std::vector<int> f;
+      int itrash, idx;
+      iss >> trash;
+      while (iss >> idx >> trash >> itrash >> trash >> itrash)
+        f.push_back(idx - 1);
+      faces.push_back(f);
+    }
+  }
+
+  return faces.size();
+}
+
+void BM_LoadLegacy(benchmark::State& state) {
+  const std::string path = grid(static_cast<size_t>(state.range(0)));
+  size_t faces = 0;
+
+  while (state.KeepRunning())
+    faces = legacy(path);
+
+  state.SetItemsProcessed(state.iterations() * faces);
+}
+BENCHMARK(BM_LoadLegacy)->Range(1 << 16, 1 << 22)
+    ->Unit(benchmark::kMillisecond);
+
+// Arguments: number of faces, and number of threads (0 for one per
+// core).
+void BM_LoadMapped(benchmark::State& state) {
+  const std::string path = grid(static_cast<size_t>(state.range(0)));
+  const auto nthreads = static_cast<size_t>(state.range(1));
+  size_t faces = 0;
+
+  while (state.KeepRunning())
+    faces = Model{path, nthreads}.nfaces();
+
+  state.SetItemsProcessed(state.iterations() * faces);
+}
+BENCHMARK(BM_LoadMapped)->Ranges({{1 << 16, 1 << 22}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+void BM_LoadHead(benchmark::State& state) {
+  size_t faces = 0;
+
+  while (state.KeepRunning())
+    faces = Model{"playground/r/african_head.obj"}.nfaces();
+
+  state.SetItemsProcessed(state.iterations() * faces);
+}
+BENCHMARK(BM_LoadHead)->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
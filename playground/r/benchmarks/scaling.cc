@@ -0,0 +1,90 @@
+// Thread scaling of the sort-middle rasteriser: triangles/second of
+// Canvas::draw() with 1 to 16 threads, against draw_serial(), on the
+// head model and on a generated grid of 1M triangles.
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <vector>
+
+#include "../r.h"
+
+namespace {
+
+// The width and height of the canvas, as main.cc.
+static const size_t resolution = 2048;
+
+static const vec3f light{0, 0, -1};
+static const pixel color{255, 180, 140};
+
+// An indexed triangle list.
+struct mesh {
+  std::vector<vec3f> verts;
+  std::vector<int> faces;
+};
+
+// Return a square grid of about n triangles which covers most of the
+// screen, with a displaced depth.
+mesh grid(const size_t n) {
+  const size_t side = static_cast<size_t>(std::sqrt(n / 2.0));
+  mesh out;
+
+  for (size_t y = 0; y <= side; y++) {
+    for (size_t x = 0; x <= side; x++) {
+      const float u = static_cast<float>(x) / side;
+      const float v = static_cast<float>(y) / side;
+      out.verts.emplace_back(1.8f * u - .9f, 1.8f * v - .9f,
+                             .1f * std::sin(20 * u) * std::cos(20 * v));
+    }
+  }
+
+  for (size_t y = 0; y < side; y++) {
+    for (size_t x = 0; x < side; x++) {
+      const auto i = static_cast<int>(y * (side + 1) + x);
+      const auto j = static_cast<int>(i + side + 1);
+      out.faces.insert(out.faces.end(), {i, i + 1, j, i + 1, j + 1, j});
+    }
+  }
+
+  return out;
+}
+
+mesh head() {
+  const Model model{"playground/r/african_head.obj"};
+  return mesh{model.verts(), model.faces()};
+}
+
+// Draw into a new canvas on each iteration. If `nthreads' is 0, use
+// draw_serial().
+void draw(benchmark::State& state, const mesh& m, const size_t nthreads) {
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    Canvas canvas{resolution, resolution, pixel{255}};
+    canvas.threads(nthreads);
+    state.ResumeTiming();
+
+    if (nthreads)
+      canvas.draw(m.verts.data(), m.verts.size(),
+                  m.faces.data(), m.faces.size(), light, color);
+    else
+      canvas.draw_serial(m.verts.data(), m.verts.size(),
+                         m.faces.data(), m.faces.size(), light, color);
+  }
+
+  state.SetItemsProcessed(state.iterations() * (m.faces.size() / 3));
+}
+
+void BM_Head(benchmark::State& state) {
+  draw(state, head(), static_cast<size_t>(state.range(0)));
+}
+BENCHMARK(BM_Head)->Arg(0)->RangeMultiplier(2)->Range(1, 16)
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void BM_Grid(benchmark::State& state) {
+  draw(state, grid(1 << 20), static_cast<size_t>(state.range(0)));
+}
+BENCHMARK(BM_Grid)->Arg(0)->RangeMultiplier(2)->Range(1, 16)
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,92 @@
+// Image output in bytes/second: the P6 file written with a single
+// writev() and through an ofstream, against the original writer,
+// which streams each channel of each pixel separately; and the QOI
+// encoder, on the rendered head model.
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <fstream>
+
+#include "../r.h"
+
+namespace {
+
+// The width and height of the image, as main.cc.
+static const size_t resolution = 2048;
+
+static const char* const path = "write.ppm";
+
+const Image& head() {
+  static const Image img = [] {
+    Image img{resolution, resolution, pixel{255}};
+    img.solid(Model{"playground/r/african_head.obj"},
+              {0, 0, -1}, {255, 180, 140});
+    return img;
+  }();
+  return img;
+}
+
+// The size of the P6 payload, excluding the header.
+int64_t payload() {
+  return static_cast<int64_t>(resolution * resolution * sizeof(pixel));
+}
+
+void BM_Write(benchmark::State& state) {
+  const Image& img = head();
+
+  while (state.KeepRunning())
+    img.write(path);
+
+  state.SetBytesProcessed(state.iterations() * payload());
+  std::remove(path);
+}
+BENCHMARK(BM_Write)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void BM_WriteStream(benchmark::State& state) {
+  const Image& img = head();
+
+  while (state.KeepRunning()) {
+    std::ofstream file{path};
+    file << img;
+  }
+
+  state.SetBytesProcessed(state.iterations() * payload());
+  std::remove(path);
+}
+BENCHMARK(BM_WriteStream)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// The original writer, with three stream insertions per pixel.
+void BM_WriteLegacy(benchmark::State& state) {
+  const Image& img = head();
+  const pixel* const data = img.data();
+  const size_t n = img.width() * img.height();
+
+  while (state.KeepRunning()) {
+    std::ofstream file{path};
+    file << "P6\n" << img.width() << ' ' << img.height() << '\n'
+         << int(std::numeric_limits<pixel::value_type>::max()) << '\n';
+
+    for (size_t i = 0; i < n; i++)
+      file << data[i].r << data[i].g << data[i].b;
+  }
+
+  state.SetBytesProcessed(state.iterations() * payload());
+  std::remove(path);
+}
+BENCHMARK(BM_WriteLegacy)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void BM_EncodeQoi(benchmark::State& state) {
+  const Image& img = head();
+
+  while (state.KeepRunning()) {
+    const auto bytes = qoi::encode(img.data(), img.width(), img.height());
+    benchmark::DoNotOptimize(bytes.data());
+  }
+
+  state.SetBytesProcessed(state.iterations() * payload());
+}
+BENCHMARK(BM_EncodeQoi)->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
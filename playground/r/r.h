@@ -0,0 +1,1672 @@
+#ifndef R_R_H_
+#define R_R_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+template<typename T>
+class vec2 {
+ public:
+  using value_type = T;
+
+  value_type x, y;
+
+  value_type& operator[](const size_t i) {
+    switch (i) {
+      case 1: return y;
+      default: return x;
+    }
+  }
+
+  const value_type& operator[](const size_t i) const {
+    switch (i) {
+      case 1: return y;
+      default: return x;
+    }
+  }
+
+  explicit vec2(const value_type& fill = value_type{}) : x(fill), y(fill) {}
+
+  vec2(const value_type& _x, const value_type& _y) : x(_x), y(_y) {}
+
+  inline vec2 operator+(const vec2& rhs) const {
+    return vec2(x + rhs.x, y + rhs.y);
+  }
+
+  inline vec2 operator-(const vec2& rhs) const {
+    return vec2(x - rhs.x, y - rhs.y);
+  }
+
+  inline vec2 operator*(const float f) const {
+    return vec2(static_cast<int>(x * f), static_cast<int>(y * f));
+  }
+
+  inline value_type operator*(const vec2& rhs) const {
+    return x * rhs.x + y * rhs.y;
+  }
+
+  // implicit conversion between types
+  template<typename U>
+  operator vec2<U>() const {
+    return vec2<U>{ static_cast<U>(x), static_cast<U>(y) };
+  }
+
+  float norm() const {
+    return std::sqrt(x * x + y * y);
+  }
+
+  vec2& normalize(const value_type& l = value_type{1}) {
+    *this = *this * (l / norm());
+    return *this;
+  }
+
+  friend std::ostream& operator<<(std::ostream& out, const vec2& v) {
+    out << "(" << v.x << ", " << v.y << ", " << v.z << ")\n";
+    return out;
+  }
+};
+
+using vec2f = vec2<float>;
+using vec2i = vec2<int>;
+
+
+template<typename T>
+class vec3 {
+ public:
+  using value_type = T;
+
+  value_type x, y, z;
+
+  value_type& operator[](const size_t i) {
+    switch (i) {
+      case 1: return y;
+      case 2: return z;
+      default: return x;
+    }
+  }
+
+  const value_type& operator[](const size_t i) const {
+    switch (i) {
+      case 1: return y;
+      case 2: return z;
+      default: return x;
+    }
+  }
+
+  explicit vec3(const value_type& fill = value_type{})
+      : x(fill), y(fill), z(fill) {}
+
+  vec3(const value_type& _x, const value_type& _y, const value_type& _z)
+      : x(_x), y(_y), z(_z) {}
+
+  // cross product
+  inline vec3 operator^(const vec3& rhs) const {
+    return vec3(y * rhs.z - z * rhs.y,
+                z * rhs.x - x * rhs.z,
+                x * rhs.y - y * rhs.x);
+  }
+
+  inline vec3 operator+(const vec3& rhs) const {
+    return vec3(x + rhs.x, y + rhs.y, z + rhs.z);
+  }
+
+  inline vec3 operator-(const vec3& rhs) const {
+    return vec3(x - rhs.x, y - rhs.y, z - rhs.z);
+  }
+
+  inline vec3 operator*(const float f) const {
+    return vec3(x * f, y * f, z * f);
+  }
+
+  inline value_type operator*(const vec3& rhs) const {
+    return x * rhs.x + y * rhs.y + z * rhs.z;
+  }
+
+  // implicit conversion between types
+  template<typename U>
+  operator vec3<U>() const {
+    return vec3<U>{
+      static_cast<U>(x), static_cast<U>(y), static_cast<U>(z)
+    };
+  }
+
+  float norm() const {
+    return std::sqrt(x * x + y * y + z * z);
+  }
+
+  vec3& normalize(const value_type& l = value_type{1}) {
+    *this = *this * (l / norm());
+    return *this;
+  }
+
+  friend std::ostream& operator<<(std::ostream& out, const vec3& v) {
+    out << "(" << v.x << ", " << v.y << ", " << v.z << ")\n";
+    return out;
+  }
+};
+
+using vec3f = vec3<float>;
+
+
+inline vec3f barycentric(vec3f a, vec3f b, vec3f c, vec3f p) {
+  vec3f s[2];
+  for (unsigned int i = 2; i--; ) {
+    s[i][0] = c[i] - a[i];
+    s[i][1] = b[i] - a[i];
+    s[i][2] = a[i] - p[i];
+  }
+  vec3f u = s[0] ^ s[1];
+
+  // dont forget that u[2] is integer. If it is zero then triangle ABC
+  // is degenerate:
+  if (std::abs(u[2]) > 1e-2)
+    return vec3f(1.0f - (u.x + u.y) / u.z, u.y / u.z, u.x / u.z);
+  // in this case generate negative coordinates, it will be thrown
+  // away by the rasterizer:
+  return vec3f(-1, 1, 1);
+}
+
+inline vec3f barycentric(vec2f a, vec2f b, vec2f c, vec2f p) {
+  vec3f u = vec3f{c[0] - a[0], b[0] - a[0], a[0] - p[0]}  // NOLINT
+            ^ vec3f{c[1] - a[1], b[1] - a[1], a[1] - p[1]};
+  // triangle is degenerate, in this case return smth with negative
+  // coordinates:
+  if (std::abs(u[2]) < 1)
+    return vec3f(-1, 1, 1);
+  return vec3f(1.0f - (u.x + u.y) / u.z, u.y / u.z, u.x / u.z);
+}
+
+
+namespace raster {
+
+// The width and height of the blocks of pixels tested by fill().
+static constexpr int block_size = 8;
+
+// The pixels of a block row tested at once. These are GCC vector
+// extensions of the native register width, so that the header builds
+// for any target: with -mavx2 a block row is one vector of eight
+// pixels, otherwise two of four.
+#ifdef __AVX2__
+static constexpr int lanes = 8;
+#else
+static constexpr int lanes = 4;
+#endif
+
+typedef int32_t int_lanes __attribute__((vector_size(lanes * 4)));
+typedef float float_lanes __attribute__((vector_size(lanes * 4)));
+
+// The largest extent in x or y of a triangle rasterised by fill().
+// Beyond this, its edge functions are not exact as floats.
+static constexpr int max_span = 2048;
+
+// Return a bitmask of the negative lanes.
+inline unsigned movemask(const int_lanes m) {
+#if defined(__AVX2__)
+  return static_cast<unsigned>(
+      _mm256_movemask_ps(_mm256_castsi256_ps(__m256i(m))));
+#elif defined(__SSE2__)
+  return static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(__m128i(m))));
+#else
+  unsigned bits = 0;
+  for (int k = 0; k < lanes; ++k)
+    bits |= unsigned(m[k] < 0) << k;
+  return bits;
+#endif
+}
+
+// Convert a whole number to an int, or return false if it is not one.
+inline bool whole(const float f, int* out) {
+  if (!(std::abs(f) <= 1 << 24))
+    return false;
+  *out = static_cast<int>(f);
+  return static_cast<float>(*out) == f;
+}
+
+// Bounds on the depth interpolated by fill() or fill_barycentric() at
+// pixels of a triangle whose barycentric coordinates for t1 and t2 lie
+// within [lo1, hi1] and [lo2, hi2], allowing for rounding.
+struct depth_bounds {
+  float min, max;
+
+  depth_bounds(const vec3f& t0, const vec3f& t1, const vec3f& t2,
+               const float lo1 = 0, const float hi1 = 1,
+               const float lo2 = 0, const float hi2 = 1) {
+    const float slack = (std::abs(t0.z) + std::abs(t1.z) + std::abs(t2.z))
+                        * 16 * std::numeric_limits<float>::epsilon();
+    const float d1 = t1.z - t0.z, d2 = t2.z - t0.z;
+
+    min = std::max(t0.z + std::min(d1 * lo1, d1 * hi1)
+                   + std::min(d2 * lo2, d2 * hi2),
+                   std::min({t0.z, t1.z, t2.z})) - slack;
+    max = std::min(t0.z + std::max(d1 * lo1, d1 * hi1)
+                   + std::max(d2 * lo2, d2 * hi2),
+                   std::max({t0.z, t1.z, t2.z})) + slack;
+  }
+};
+
+// A block visitor for fill() which rasterises every block.
+struct all_blocks {
+  bool test(int, int, const depth_bounds&) const { return true; }
+  void cover(int, int, const depth_bounds&, uint64_t) const {}
+};
+
+// Rasterise a triangle by evaluating barycentric() at each point of
+// the bounding box [bboxmin, bboxmax], calling plot(x, y, z) for the
+// covered points with their interpolated depth.
+template<typename Plot>
+void fill_barycentric(const vec3f& t0, const vec3f& t1, const vec3f& t2,
+                      const vec2f& bboxmin, const vec2f& bboxmax,
+                      Plot plot) {
+  vec3f p;
+  for (p.x = bboxmin.x; p.x <= bboxmax.x; ++p.x) {
+    for (p.y = bboxmin.y; p.y <= bboxmax.y; ++p.y) {
+      vec3f bc_screen  = barycentric(t0, t1, t2, p);
+      if (bc_screen.x < 0 || bc_screen.y < 0 || bc_screen.z < 0)
+        continue;
+
+      p.z = t0[2] * bc_screen[0];
+      p.z += t1[2] * bc_screen[1];
+      p.z += t2[2] * bc_screen[2];
+
+      plot(size_t(p.x), size_t(p.y), p.z);
+    }
+  }
+}
+
+// Rasterise a triangle with whole pixel vertex coordinates within the
+// clip rectangle [xmin, xmax] x [ymin, ymax], calling plot(x, y, z) for
+// each covered pixel with its interpolated depth.
+//
+// Each barycentric coordinate is an integer edge function over twice
+// the triangle's area. The edge functions are stepped incrementally
+// over 8x8 blocks, skipping those wholly outside an edge, and each
+// block row is tested `lanes' pixels at a time. Coverage and depth are
+// exactly those of fill_barycentric(), including pixels on an edge.
+//
+// Before a block is rasterised, blocks.test(x0, y0, depth) is called
+// with its first pixel and the bounds of the triangle's depth within
+// it; if this returns false, the block is skipped. Otherwise, it is
+// followed by blocks.cover(x0, y0, depth, mask) with the pixels that
+// were plotted, bit 8 * y + x set for pixel (x0 + x, y0 + y).
+//
+// Returns false without plotting anything if the vertices are not
+// whole pixels or span more than max_span pixels.
+template<typename Plot, typename Blocks = all_blocks>
+bool fill(const vec3f& t0, const vec3f& t1, const vec3f& t2,
+          int xmin, int ymin, int xmax, int ymax, Plot plot,
+          Blocks&& blocks = Blocks()) {
+  int ax, ay, bx, by, cx, cy;
+  if (!whole(t0.x, &ax) || !whole(t0.y, &ay) ||
+      !whole(t1.x, &bx) || !whole(t1.y, &by) ||
+      !whole(t2.x, &cx) || !whole(t2.y, &cy))
+    return false;
+
+  if (std::max({ax, bx, cx}) - std::min({ax, bx, cx}) > max_span ||
+      std::max({ay, by, cy}) - std::min({ay, by, cy}) > max_span)
+    return false;
+
+  xmin = std::max(xmin, std::min({ax, bx, cx}));
+  ymin = std::max(ymin, std::min({ay, by, cy}));
+  xmax = std::min(xmax, std::max({ax, bx, cx}));
+  ymax = std::min(ymax, std::max({ay, by, cy}));
+  if (xmin > xmax || ymin > ymax)
+    return true;
+
+  // twice the signed area, zero for a degenerate triangle:
+  const int area2 = (cx - ax) * (by - ay) - (bx - ax) * (cy - ay);
+  if (!area2)
+    return true;
+  const int sign = area2 > 0 ? 1 : -1;
+  const int area = sign * area2;
+
+  // The edge functions, with steps of one pixel in x and y. Edge i is
+  // the numerator of barycentric coordinate i, so is `area' at vertex
+  // i and zero on the opposite edge.
+  const int dx0 = sign * (cy - by), dy0 = sign * (bx - cx);
+  const int dx1 = sign * (ay - cy), dy1 = sign * (cx - ax);
+  const int dx2 = sign * (by - ay), dy2 = sign * (ax - bx);
+
+  const int xbegin = xmin & ~(block_size - 1);
+  const int ybegin = ymin & ~(block_size - 1);
+  int row0 = area + dx0 * (xbegin - ax) + dy0 * (ybegin - ay);
+  int row1 = dx1 * (xbegin - ax) + dy1 * (ybegin - ay);
+  int row2 = dx2 * (xbegin - ax) + dy2 * (ybegin - ay);
+
+  // The greatest offset of each edge function across a block from its
+  // value at the block's first pixel, and the least.
+  const int n = block_size - 1;
+  const int hi0 = (std::max(dx0, 0) + std::max(dy0, 0)) * n;
+  const int hi1 = (std::max(dx1, 0) + std::max(dy1, 0)) * n;
+  const int hi2 = (std::max(dx2, 0) + std::max(dy2, 0)) * n;
+  const int lo0 = (std::min(dx0, 0) + std::min(dy0, 0)) * n;
+  const int lo1 = (std::min(dx1, 0) + std::min(dy1, 0)) * n;
+  const int lo2 = (std::min(dx2, 0) + std::min(dy2, 0)) * n;
+
+  int_lanes lane;
+  for (int k = 0; k < lanes; ++k)
+    lane[k] = k;
+  const int_lanes step0 = lane * dx0;
+  const int_lanes step1 = lane * dx1;
+  const int_lanes step2 = lane * dx2;
+
+  const auto farea = static_cast<float>(area);
+  const float rarea = 1 / farea;
+
+  for (int y0 = ybegin; y0 <= ymax; y0 += block_size) {
+    int e0 = row0, e1 = row1, e2 = row2;
+
+    for (int x0 = xbegin; x0 <= xmax; x0 += block_size,
+             e0 += dx0 * block_size, e1 += dx1 * block_size,
+             e2 += dx2 * block_size) {
+      if (e0 + hi0 >= 0 && e1 + hi1 >= 0 && e2 + hi2 >= 0) {
+        const depth_bounds depth(t0, t1, t2,
+                                 std::max(e1 + lo1, 0) * rarea,
+                                 std::min(e1 + hi1, area) * rarea,
+                                 std::max(e2 + lo2, 0) * rarea,
+                                 std::min(e2 + hi2, area) * rarea);
+        if (!blocks.test(x0, y0, depth))
+          continue;
+
+        const bool full = e0 + lo0 >= 0 && e1 + lo1 >= 0 && e2 + lo2 >= 0;
+
+        // the columns of the block inside the clip rectangle
+        const int c0 = std::max(xmin - x0, 0);
+        const int c1 = std::min(xmax - x0, block_size - 1);
+        const unsigned clip = (2u << c1) - (1u << c0);
+
+        const int y1 = std::max(y0, ymin);
+        const int y2 = std::min(y0 + block_size - 1, ymax);
+        int w0 = e0 + dy0 * (y1 - y0);
+        int w1 = e1 + dy1 * (y1 - y0);
+        int w2 = e2 + dy2 * (y1 - y0);
+
+        uint64_t mask = 0;
+        for (int y = y1; y <= y2; ++y, w0 += dy0, w1 += dy1, w2 += dy2) {
+          for (int k0 = 0; k0 < block_size; k0 += lanes) {
+            unsigned bits = (clip >> k0) & ((1u << lanes) - 1);
+            if (!bits)
+              continue;
+
+            const int_lanes v1 = (w1 + dx1 * k0) + step1;
+            const int_lanes v2 = (w2 + dx2 * k0) + step2;
+            if (!full) {
+              const int_lanes v0 = (w0 + dx0 * k0) + step0;
+              bits &= ~movemask(v0 | v1 | v2);
+              if (!bits)
+                continue;
+            }
+
+            // interpolate depth with the arithmetic of barycentric():
+            const float_lanes bc0 = 1.0f - __builtin_convertvector(
+                v1 + v2, float_lanes) / farea;
+            const float_lanes bc1 = __builtin_convertvector(
+                v1, float_lanes) / farea;
+            const float_lanes bc2 = __builtin_convertvector(
+                v2, float_lanes) / farea;
+            const float_lanes z = t0.z * bc0 + t1.z * bc1 + t2.z * bc2;
+
+            mask |= uint64_t(bits) << ((y - y0) * block_size + k0);
+            for (; bits; bits &= bits - 1) {
+              const int k = __builtin_ctz(bits);
+              plot(size_t(x0 + k0 + k), size_t(y), z[k]);
+            }
+          }
+        }
+
+        blocks.cover(x0, y0, depth, mask);
+      }
+    }
+
+    row0 += dy0 * block_size;
+    row1 += dy1 * block_size;
+    row2 += dy2 * block_size;
+  }
+
+  return true;
+}
+
+}  // namespace raster
+
+
+// Return the number of hardware threads.
+inline size_t hardware_threads() {
+  return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+// Call fn(i) for i in [0, n), each on its own thread, with the last
+// on the calling thread. The first exception thrown is rethrown once
+// all threads have finished.
+template<typename Function>
+void parallel(const size_t n, Function fn) {
+  std::vector<std::thread> threads;
+  std::vector<std::exception_ptr> errors(n);
+
+  for (size_t i = 0; i < n; i++) {
+    const auto work = [&, i]() {
+      try {
+        fn(i);
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    };
+
+    if (i + 1 < n)
+      threads.emplace_back(work);
+    else
+      work();
+  }
+
+  for (auto& thread : threads)
+    thread.join();
+  for (const auto& error : errors)
+    if (error)
+      std::rethrow_exception(error);
+}
+
+
+namespace obj {
+
+// A read-only memory mapped file.
+class mapped_file {
+ public:
+  explicit mapped_file(const std::string& filename) {
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error{"loading model"};
+
+    struct stat st;
+    if (fstat(fd, &st)) {
+      close(fd);
+      throw std::runtime_error{"loading model"};
+    }
+    _size = static_cast<size_t>(st.st_size);
+
+    if (_size) {
+      void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error{"loading model"};
+      }
+      _data = static_cast<const char*>(data);
+      madvise(data, _size, MADV_SEQUENTIAL);
+    }
+
+    close(fd);
+  }
+
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  ~mapped_file() {
+    if (_data)
+      munmap(const_cast<char*>(_data), _size);
+  }
+
+  const char* begin() const { return _data; }
+  const char* end() const { return _data + _size; }
+  size_t size() const { return _size; }
+
+ private:
+  const char* _data = nullptr;
+  size_t _size = 0;
+};
+
+inline bool is_space(const char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool is_digit(const char c) {
+  return c >= '0' && c <= '9';
+}
+
+// Parse a decimal integer at *p, advancing *p past it. Fails if its
+// magnitude exceeds INT_MAX.
+inline bool parse_int(const char** p, const char* end, int* out) {
+  const char* s = *p;
+  bool negative = false;
+
+  if (s < end && (*s == '-' || *s == '+'))
+    negative = *s++ == '-';
+  if (s == end || !is_digit(*s))
+    return false;
+
+  int64_t value = 0;
+  while (s < end && is_digit(*s)) {
+    value = value * 10 + (*s++ - '0');
+    if (value > std::numeric_limits<int>::max())
+      return false;
+  }
+
+  *out = static_cast<int>(negative ? -value : value);
+  *p = s;
+  return true;
+}
+
+// Parse a decimal floating point number at *p, advancing *p past it.
+inline bool parse_float(const char** p, const char* end, float* out) {
+  static const double powers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  const char* s = *p;
+  bool negative = false;
+
+  if (s < end && (*s == '-' || *s == '+'))
+    negative = *s++ == '-';
+
+  // Accumulate up to 19 significant digits, which fit in 64 bits.
+  uint64_t mantissa = 0;
+  int exponent = 0, digits = 0;
+  bool any = false;
+
+  for (; s < end && is_digit(*s); ++s, any = true) {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + static_cast<uint64_t>(*s - '0');
+      digits += mantissa > 0;
+    } else {
+      ++exponent;
+    }
+  }
+
+  if (s < end && *s == '.') {
+    for (++s; s < end && is_digit(*s); ++s, any = true) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + static_cast<uint64_t>(*s - '0');
+        digits += mantissa > 0;
+        --exponent;
+      }
+    }
+  }
+
+  if (!any)
+    return false;
+
+  if (s < end && (*s == 'e' || *s == 'E')) {
+    int e;
+    const char* t = s + 1;
+    if (parse_int(&t, end, &e)) {
+      // Any exponent beyond this range overflows or underflows.
+      exponent = static_cast<int>(std::max<int64_t>(
+          std::min<int64_t>(int64_t{exponent} + e, 1000), -1000));
+      s = t;
+    }
+  }
+
+  double value = static_cast<double>(mantissa);
+  if (exponent < 0)
+    value = -exponent <= 22 ? value / powers[-exponent]
+                            : value * std::pow(10.0, exponent);
+  else if (exponent > 0)
+    value = exponent <= 22 ? value * powers[exponent]
+                           : value * std::pow(10.0, exponent);
+
+  *out = static_cast<float>(negative ? -value : value);
+  *p = s;
+  return true;
+}
+
+// The vertices and faces of a range of lines. Negative (relative)
+// vertex indices are resolved against the chunk's own vertices; the
+// face indices which need the number of vertices in previous chunks
+// adding are listed in `relative'.
+struct chunk {
+  std::vector<vec3f> verts;
+  std::vector<int> faces;
+  std::vector<size_t> relative;
+};
+
+// Parse the lines in [p, end) into a chunk.
+inline void parse(const char* p, const char* end, chunk* out) {
+  std::vector<int> polygon;
+  std::vector<bool> relative;
+
+  while (p < end) {
+    while (p < end && is_space(*p))
+      ++p;
+
+    if (end - p > 1 && p[0] == 'v' && is_space(p[1])) {
+      // vertex position
+      p += 2;
+      vec3f v;
+      for (size_t i = 0; i < 3; i++) {
+        while (p < end && is_space(*p))
+          ++p;
+        if (!parse_float(&p, end, &v[i]))
+          throw std::runtime_error{"loading model"};
+      }
+      out->verts.push_back(v);
+    } else if (end - p > 1 && p[0] == 'f' && is_space(p[1])) {
+      // face, as vertex indices "v", "v/vt", "v//vn" or "v/vt/vn"
+      p += 2;
+      polygon.clear();
+      relative.clear();
+      for (;;) {
+        while (p < end && is_space(*p))
+          ++p;
+        if (p == end || *p == '\n')
+          break;
+
+        int idx;
+        if (!parse_int(&p, end, &idx) || !idx)
+          throw std::runtime_error{"loading model"};
+        // in wavefront obj all indices start at 1, not zero, or count
+        // back from the last vertex if negative
+        if (idx > 0) {
+          polygon.push_back(idx - 1);
+          relative.push_back(false);
+        } else {
+          polygon.push_back(static_cast<int>(out->verts.size()) + idx);
+          relative.push_back(true);
+        }
+
+        // skip texture and normal indices
+        while (p < end && !is_space(*p) && *p != '\n')
+          ++p;
+      }
+
+      if (polygon.size() < 3)
+        throw std::runtime_error{"loading model"};
+
+      // split polygons into triangle fans
+      for (size_t i = 2; i < polygon.size(); i++) {
+        for (const size_t j : {size_t(0), i - 1, i}) {
+          if (relative[j])
+            out->relative.push_back(out->faces.size());
+          out->faces.push_back(polygon[j]);
+        }
+      }
+    }
+
+    // skip to the next line
+    while (p < end && *p++ != '\n') {}
+  }
+}
+
+}  // namespace obj
+
+
+// A triangle mesh, loaded from a wavefront obj file. Vertices and
+// faces are stored in flat arrays, with each face a triple of vertex
+// indices, so faces() has a stride of 3. Polygons are split into
+// triangle fans.
+class Model {
+ public:
+  using vertices_type = std::vector<vec3f>;
+  using faces_type = std::vector<int>;
+
+  // Files larger than this are parsed in parallel chunks.
+  static constexpr size_t parallel_threshold = 1 << 20;
+
+  // Load a model by parsing a memory mapped file in place. If
+  // `nthreads' is 0, large files are parsed by one thread per core.
+  explicit Model(const std::string& filename, size_t nthreads = 0) {
+    const obj::mapped_file file{filename};
+
+    if (!nthreads)
+      nthreads = hardware_threads();
+    if (file.size() < parallel_threshold)
+      nthreads = 1;
+
+    // split the file into chunks of whole lines
+    std::vector<const char*> bounds{file.begin()};
+    for (size_t i = 1; i < nthreads; i++) {
+      const char* p = std::max(file.begin() + file.size() * i / nthreads,
+                               bounds.back());
+      while (p < file.end() && *p++ != '\n') {}
+      bounds.push_back(p);
+    }
+    bounds.push_back(file.end());
+
+    std::vector<obj::chunk> chunks(nthreads);
+    parallel(nthreads, [&](const size_t i) {
+      obj::parse(bounds[i], bounds[i + 1], &chunks[i]);
+    });
+
+    // concatenate the chunks
+    size_t nverts = 0, nindices = 0;
+    for (const auto& chunk : chunks) {
+      nverts += chunk.verts.size();
+      nindices += chunk.faces.size();
+    }
+    _verts.reserve(nverts);
+    _faces.reserve(nindices);
+
+    for (const auto& chunk : chunks) {
+      const auto base = static_cast<int>(_verts.size());
+      const size_t offset = _faces.size();
+
+      _verts.insert(_verts.end(), chunk.verts.begin(), chunk.verts.end());
+      _faces.insert(_faces.end(), chunk.faces.begin(), chunk.faces.end());
+      for (const size_t i : chunk.relative)
+        _faces[offset + i] += base;
+    }
+
+    for (const int idx : _faces)
+      if (idx < 0 || static_cast<size_t>(idx) >= _verts.size())
+        throw std::runtime_error{"loading model"};
+  }
+
+  const vertices_type& verts() const { return _verts; }
+  const faces_type& faces() const { return _faces; }
+
+  size_t nverts() const { return _verts.size(); }
+  size_t nfaces() const { return _faces.size() / 3; }
+
+ private:
+  vertices_type _verts;
+  faces_type _faces;
+};
+
+
+// An RGB colour, packed so that an array of pixels is an image's raw
+// P6 payload.
+class pixel {
+ public:
+  using value_type = unsigned char;
+  value_type r, g, b;
+
+  explicit pixel(const value_type fill = 0) : r(fill), g(fill), b(fill) {}
+  pixel(const value_type _r, const value_type _g, const value_type _b)
+      : r(_r), g(_g), b(_b) {}
+
+  inline pixel operator*(const float f) const {
+    return pixel{static_cast<value_type>(r * f),
+          static_cast<value_type>(g * f),
+          static_cast<value_type>(b * f)};
+  }
+
+  // human-readable:
+  friend std::ostream& operator<<(std::ostream& out, const pixel& pixel) {
+    out << static_cast<int>(pixel.r)
+        << ' ' << static_cast<int>(pixel.g)
+        << ' ' << static_cast<int>(pixel.b) << ' ';
+    return out;
+  }
+};
+
+static_assert(sizeof(pixel) == 3, "pixel is not packed");
+
+namespace colors {
+static const pixel black;
+static const pixel white{255};
+static const pixel red{255, 0, 0};
+static const pixel blue{0, 255, 0};
+static const pixel green{0, 0, 255};
+}  // namespace colors
+
+
+template<typename T>
+class subscriptable_t {
+ public:
+  using value_type = T;
+  using pointer = value_type*;
+  using reference = value_type&;
+
+  explicit subscriptable_t(pointer root) : _root(root) {}
+  reference operator[](const size_t x) { return _root[x]; }
+
+ private:
+  pointer _root;
+};
+
+template<typename T>
+class col_iterator {
+ public:
+  using value_type = T;
+
+  explicit col_iterator(value_type* data) : _data(data) {}
+
+  col_iterator& operator++() {
+    ++_data;
+    return *this;
+  }
+
+  col_iterator operator++(int) {
+    auto tmp = col_iterator{_data};
+    operator++();
+    return tmp;
+  }
+
+  value_type& operator*() {
+    return *_data;
+  }
+
+  friend bool operator==(const col_iterator& lhs, const col_iterator& rhs) {
+    return lhs._data == rhs._data;
+  }
+
+  friend bool operator!=(const col_iterator& lhs, const col_iterator& rhs) {
+    return !(lhs == rhs);
+  }
+
+ private:
+  pixel* _data;
+};
+
+template<typename T>
+class row_iterator {
+ public:
+  using value_type = T;
+
+  row_iterator(value_type* data, size_t stride)
+      : _data(data), _stride(stride) {}
+  explicit row_iterator(value_type* data) : _data(data), _stride(0) {}
+
+  row_iterator& operator++() {
+    _data += _stride;
+    return *this;
+  }
+
+  row_iterator operator++(int) {
+    auto tmp = row_iterator(_data, _stride);
+    operator++();
+    return tmp;
+  }
+
+  col_iterator<value_type> begin() {
+    return col_iterator<value_type>{_data};
+  }
+
+  col_iterator<value_type> end() {
+    return col_iterator<value_type>{_data + _stride};
+  }
+
+  col_iterator<value_type> operator*() {
+    return col_iterator<value_type>{_data};
+  }
+
+  friend bool operator==(const row_iterator& lhs, const row_iterator& rhs) {
+    return lhs._data == rhs._data;
+  }
+
+  friend bool operator!=(const row_iterator& lhs, const row_iterator& rhs) {
+    return !(lhs == rhs);
+  }
+
+ private:
+  pixel* _data;
+  size_t _stride;
+};
+
+
+// Screen space vertex positions, as a structure of arrays.
+struct screen_buffer {
+  std::vector<float> x, y, z;
+
+  void resize(const size_t n) {
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+  }
+};
+
+
+// Counters of the work done drawing to a Canvas.
+struct render_stats {
+  size_t triangles = 0;        // faces drawn
+  size_t culled = 0;           // back-facing or off screen
+  size_t tiles = 0;            // binned triangles, once per tile
+  size_t tiles_occluded = 0;   // ... rejected by the depth pyramid
+  size_t blocks = 0;           // 8x8 blocks tested against the pyramid
+  size_t blocks_occluded = 0;  // ... and rejected
+  size_t fragments = 0;        // covered pixels, depth tested
+  size_t writes = 0;           // ... which passed
+  size_t pixels = 0;           // distinct pixels drawn
+
+  render_stats& operator+=(const render_stats& rhs) {
+    triangles += rhs.triangles;
+    culled += rhs.culled;
+    tiles += rhs.tiles;
+    tiles_occluded += rhs.tiles_occluded;
+    blocks += rhs.blocks;
+    blocks_occluded += rhs.blocks_occluded;
+    fragments += rhs.fragments;
+    writes += rhs.writes;
+    pixels += rhs.pixels;
+    return *this;
+  }
+
+  friend std::ostream& operator<<(std::ostream& out, const render_stats& s) {
+    const auto percent = [](const size_t n, const size_t d) {
+      return d ? 100.0 * n / d : 0.0;
+    };
+
+    out << "triangles " << s.triangles
+        << ", culled " << percent(s.culled, s.triangles) << "%\n"
+        << "tile triangles " << s.tiles
+        << ", occluded " << percent(s.tiles_occluded, s.tiles) << "%\n"
+        << "blocks " << s.blocks
+        << ", occluded " << percent(s.blocks_occluded, s.blocks) << "%\n"
+        << "fragments " << s.fragments << ", written " << s.writes
+        << ", overdraw " << (s.pixels ? double(s.writes) / s.pixels : 0.0)
+        << "x\n";
+    return out;
+  }
+};
+
+
+class Canvas {
+ public:
+  using iterator = row_iterator<pixel>;
+
+  Canvas(const size_t width, const size_t height,
+         bool inverted = true, const pixel& fill = pixel{})
+      : _width(width), _height(height), _inverted(inverted),
+        _data(width * height, fill),
+        _zbuffer(width * height, -std::numeric_limits<float>::max()),
+        _zmin(blocks_x() * blocks_y(), -std::numeric_limits<float>::max()) {}
+
+  Canvas(const size_t width, const size_t height,
+         const pixel& fill, bool inverted = true)
+      : _width(width), _height(height), _inverted(inverted),
+        _data(width * height, fill),
+        _zbuffer(width * height, -std::numeric_limits<float>::max()),
+        _zmin(blocks_x() * blocks_y(), -std::numeric_limits<float>::max()) {}
+
+  size_t width() const { return _width; }
+  size_t height() const { return _height; }
+  size_t size() const { return width() * height(); }
+
+  // Pixel accessor
+  subscriptable_t<pixel> operator[](const size_t y) {
+    if (_inverted)
+      return subscriptable_t<pixel>{_data.data() + (height() - y) * width()};
+    else
+      return subscriptable_t<pixel>{_data.data() + y * width()};
+  }
+
+  iterator begin() {
+    return iterator{_data.data(), width()};
+  }
+
+  iterator end() {
+    return iterator{_data.data() + _data.size()};
+  }
+
+  void line(int x0, int y0, int x1, int y1, const pixel& color) {
+    bool steep = false;
+
+    if (std::abs(x0 - x1) < std::abs(y0 - y1)) {
+      std::swap(x0, y0);
+      std::swap(x1, y1);
+      steep = true;
+    }
+
+    if (x0 > x1) {
+      std::swap(x0, x1);
+      std::swap(y0, y1);
+    }
+
+    int dx = x1 - x0;
+    int dy = y1 - y0;
+    int derror2 = std::abs(dy) * 2;
+    int error2 = 0;
+    int y = y0;
+
+    for (int x = x0; x <= x1; ++x) {
+      if (steep)
+        (*this)[size_t(x)][size_t(y)] = color;
+      else
+        (*this)[size_t(y)][size_t(x)] = color;
+
+      error2 += derror2;
+      if (error2 > dx) {
+        y += (y1 > y0 ? 1 : -1);
+        error2 -= dx * 2;
+      }
+    }
+  }
+
+  // Compute the bounding box of a triangle, clamped to the canvas.
+  void bounds(const vec3f& t0, const vec3f& t1, const vec3f& t2,
+              vec2f* bboxmin, vec2f* bboxmax) const {
+    const vec2f clamp(static_cast<float>(width() - 1),
+                      static_cast<float>(height() - 1));
+
+    for (unsigned int j = 0; j < 2; ++j) {
+      (*bboxmin)[j] = std::max(0.0f, std::min({t0[j], t1[j], t2[j]}));
+      (*bboxmax)[j] = std::min(clamp[j], std::max({t0[j], t1[j], t2[j]}));
+    }
+  }
+
+  void triangle(vec3f t0, vec3f t1, vec3f t2, const pixel& color) {
+    const auto plot = [&](const size_t x, const size_t y, const float z) {
+      ++_stats.fragments;
+      if (_zbuffer[x + y * width()] < z) {
+        _zbuffer[x + y * width()] = z;
+        (*this)[y][x] = color;
+        ++_stats.writes;
+      }
+    };
+
+    // The bottom row of an inverted canvas is out of bounds.
+    const int ymin = _inverted ? 1 : 0;
+
+    if (!raster::fill(t0, t1, t2, 0, ymin, static_cast<int>(width()) - 1,
+                      static_cast<int>(height()) - 1, plot)) {
+      vec2f bboxmin, bboxmax;
+      bounds(t0, t1, t2, &bboxmin, &bboxmax);
+      bboxmin.y = std::max(bboxmin.y, float(ymin));
+      raster::fill_barycentric(t0, t1, t2, bboxmin, bboxmax, plot);
+    }
+  }
+
+  void wireframe(const Model& model) {
+    const auto& verts = model.verts();
+    const auto& faces = model.faces();
+
+    for (size_t i = 0; i < faces.size(); i += 3) {
+      for (size_t j = 0; j < 3; ++j) {
+        const vec3f& v0 = verts[size_t(faces[i + j])];
+        const vec3f& v1 = verts[size_t(faces[i + (j + 1) % 3])];
+
+        const auto x0 = static_cast<int>((v0.x + 1) * width() / 2);
+        const auto y0 = static_cast<int>((v0.y + 1) * height() / 2);
+        const auto x1 = static_cast<int>((v1.x + 1) * width() / 2);
+        const auto y1 = static_cast<int>((v1.y + 1) * height() / 2);
+
+        line(x0, y0, x1, y1, pixel{255, 255, 255});
+      }
+    }
+  }
+
+  vec3f world2screen(vec3f v) {
+    return vec3f{static_cast<int>((v.x + 1) * width() / 2 + 0.5),
+          static_cast<int>((v.y + 1.) * height() / 2 + 0.5), v.z};
+  }
+
+  // Transform n vertices into screen space, as world2screen().
+  void transform(const vec3f* verts, const size_t n,
+                 screen_buffer* out) const {
+    out->resize(n);
+
+    const float w = static_cast<float>(width());
+    const double h = static_cast<double>(height());
+    float* __restrict__ x = out->x.data();
+    float* __restrict__ y = out->y.data();
+    float* __restrict__ z = out->z.data();
+
+    // one pass per component, so that each loop vectorises
+    for (size_t i = 0; i < n; ++i)
+      x[i] = static_cast<float>(
+          static_cast<int>((verts[i].x + 1) * w / 2 + 0.5));
+    for (size_t i = 0; i < n; ++i)
+      y[i] = static_cast<float>(
+          static_cast<int>((verts[i].y + 1.) * h / 2 + 0.5));
+    for (size_t i = 0; i < n; ++i)
+      z[i] = verts[i].z;
+  }
+
+  // Draw an indexed triangle list, one triangle at a time. Each vertex
+  // is transformed once, then triangles are rasterised by index from
+  // the screen space buffer.
+  void draw_serial(const vec3f* verts, const size_t nverts,
+                   const int* indices, const size_t nindices,
+                   const vec3f& light_direction,
+                   const pixel& surface_color) {
+    transform(verts, nverts, &_screen);
+
+    const float* x = _screen.x.data();
+    const float* y = _screen.y.data();
+    const float* z = _screen.z.data();
+
+    for (size_t f = 0; f + 2 < nindices; f += 3) {
+      const auto a = size_t(indices[f]);
+      const auto b = size_t(indices[f + 1]);
+      const auto c = size_t(indices[f + 2]);
+
+      // normal of face:
+      vec3f n = (verts[c] - verts[a]) ^ (verts[b] - verts[a]);
+      n.normalize();
+
+      float intensity = n * light_direction;
+
+      ++_stats.triangles;
+      // back-face culling
+      if (intensity > 0) {
+        triangle(vec3f{x[a], y[a], z[a]}, vec3f{x[b], y[b], z[b]},
+                 vec3f{x[c], y[c], z[c]}, surface_color * intensity);
+      } else {
+        ++_stats.culled;
+      }
+    }
+  }
+
+  // Draw an indexed triangle list, sort-middle. Faces are split into
+  // one range per thread, which are shaded, culled, and binned into
+  // the screen tiles they overlap. Each tile is then rasterised by a
+  // single thread into a tile-local colour and depth buffer, taking
+  // its triangles in face order, so the output is identical to
+  // draw_serial(). Triangles and blocks of pixels hidden behind those
+  // already drawn are rejected using the tile's depth pyramid.
+  void draw(const vec3f* verts, const size_t nverts,
+            const int* indices, const size_t nindices,
+            const vec3f& light_direction, const pixel& surface_color) {
+    transform(verts, nverts, &_screen);
+
+    const size_t nfaces = nindices / 3;
+    const size_t nthreads = std::max<size_t>(
+        std::min(threads(), nfaces / 64), 1);
+    const size_t ntiles = tiles_x() * tiles_y();
+
+    // setup and binning
+    _bins.resize(nthreads);
+    parallel(nthreads, [&](const size_t i) {
+      bin(verts, indices, nfaces * i / nthreads, nfaces * (i + 1) / nthreads,
+          light_direction, surface_color, &_bins[i]);
+    });
+
+    // rasterisation
+    const size_t nworkers = std::min(threads(), ntiles);
+    std::vector<render_stats> stats(nworkers);
+    std::atomic<size_t> next{0};
+    parallel(nworkers, [&](const size_t i) {
+      tile_buffer tile;
+      for (size_t t; (t = next++) < ntiles; )
+        rasterise(_bins, t, &tile, &stats[i]);
+    });
+
+    _stats.triangles += nfaces;
+    for (const auto& b : _bins)
+      _stats.culled += b.culled;
+    for (const auto& s : stats)
+      _stats += s;
+  }
+
+  void solid(const Model& model, const vec3f& light_direction,
+             const pixel& surface_color) {
+    draw(model.verts().data(), model.nverts(),
+         model.faces().data(), model.faces().size(),
+         light_direction, surface_color);
+  }
+
+  // Set the number of threads used by draw(), or 0 for one per core.
+  void threads(const size_t n) { _threads = n; }
+
+  size_t threads() const {
+    return _threads ? _threads : hardware_threads();
+  }
+
+  // The width and height of the screen tiles used by draw().
+  static constexpr size_t tile_size = 64;
+
+  size_t tiles_x() const { return (width() + tile_size - 1) / tile_size; }
+  size_t tiles_y() const { return (height() + tile_size - 1) / tile_size; }
+
+  // The number of blocks in the depth pyramid.
+  size_t blocks_x() const {
+    return (width() + raster::block_size - 1) / raster::block_size;
+  }
+  size_t blocks_y() const {
+    return (height() + raster::block_size - 1) / raster::block_size;
+  }
+
+  // Return the counters of the work done by all draws so far.
+  render_stats stats() const {
+    render_stats out = _stats;
+    out.pixels = static_cast<size_t>(std::count_if(
+        _zbuffer.begin(), _zbuffer.end(), [](const float z) {
+          return z > -std::numeric_limits<float>::max();
+        }));
+    return out;
+  }
+
+ private:
+  // A triangle after setup: the indices of its vertices in the
+  // screen space buffer, and its shaded colour.
+  struct setup_triangle {
+    uint32_t v[3];
+    pixel color;
+  };
+
+  // The triangles of a range of faces, and the indices of those
+  // which overlap each tile.
+  struct tile_bins {
+    std::vector<setup_triangle> triangles;
+    std::vector<std::vector<uint32_t>> tiles;
+    size_t culled = 0;
+  };
+
+  // The colour and depth of one tile, and a two level depth pyramid:
+  // a lower bound on the depth of each 8x8 block, and on the whole
+  // tile. A pixel is only drawn if nearer, with a greater depth, than
+  // the one in the buffer, so nothing which is no nearer than the
+  // bound of a block can be drawn in it.
+  //
+  // Depths only ever increase, so a block's bound is raised once the
+  // triangles drawn since have covered all of it, to the least depth
+  // they could have drawn there.
+  struct tile_buffer {
+    static constexpr size_t blocks = tile_size / raster::block_size;
+
+    pixel data[tile_size * tile_size];
+    float zbuffer[tile_size * tile_size];
+    float zmin[blocks * blocks];
+    float tile_zmin;
+    bool stale;
+
+    // The pixels of each block drawn since its bound was last raised,
+    // and a lower bound on the depth drawn to them. Once every pixel is
+    // covered, the block's bound is raised to it.
+    uint64_t covered[blocks * blocks];
+    float zcovered[blocks * blocks];
+
+    // Return the index of the block containing tile pixel (x, y).
+    static size_t block(const size_t x, const size_t y) {
+      return (y / raster::block_size) * blocks + x / raster::block_size;
+    }
+
+    // Return the bit of pixel (x, y) in its block's coverage mask.
+    static uint64_t bit(const size_t x, const size_t y) {
+      return uint64_t(1) << ((y % raster::block_size) * raster::block_size +
+                             x % raster::block_size);
+    }
+
+    // Record the pixels in mask of block b as drawn at depth z or more.
+    void cover(const size_t b, const uint64_t mask, const float z) {
+      covered[b] |= mask;
+      zcovered[b] = std::min(zcovered[b], z);
+      if (~covered[b])
+        return;
+
+      if (zcovered[b] > zmin[b]) {
+        stale |= zmin[b] == tile_zmin;
+        zmin[b] = zcovered[b];
+      }
+      covered[b] = 0;
+      zcovered[b] = std::numeric_limits<float>::max();
+    }
+
+    // Recompute the tile's bound from those of its blocks.
+    void refresh() {
+      tile_zmin = *std::min_element(zmin, zmin + blocks * blocks);
+      stale = false;
+    }
+  };
+
+  // Shade, cull, and bin faces [first, last).
+  void bin(const vec3f* verts, const int* indices,
+           const size_t first, const size_t last,
+           const vec3f& light_direction, const pixel& surface_color,
+           tile_bins* out) const {
+    const float* x = _screen.x.data();
+    const float* y = _screen.y.data();
+    const float* z = _screen.z.data();
+
+    out->triangles.clear();
+    out->triangles.reserve(last - first);
+    out->culled = 0;
+    out->tiles.resize(tiles_x() * tiles_y());
+    for (auto& tile : out->tiles)
+      tile.clear();
+
+    for (size_t f = first * 3; f < last * 3; f += 3) {
+      const auto a = size_t(indices[f]);
+      const auto b = size_t(indices[f + 1]);
+      const auto c = size_t(indices[f + 2]);
+
+      // normal of face:
+      vec3f n = (verts[c] - verts[a]) ^ (verts[b] - verts[a]);
+      n.normalize();
+
+      float intensity = n * light_direction;
+
+      // back-face culling
+      if (!(intensity > 0)) {
+        ++out->culled;
+        continue;
+      }
+
+      vec2f bboxmin, bboxmax;
+      bounds(vec3f{x[a], y[a], z[a]}, vec3f{x[b], y[b], z[b]},
+             vec3f{x[c], y[c], z[c]}, &bboxmin, &bboxmax);
+
+      // off screen
+      if (bboxmin.x > bboxmax.x || bboxmin.y > bboxmax.y) {
+        ++out->culled;
+        continue;
+      }
+
+      const auto index = static_cast<uint32_t>(out->triangles.size());
+      out->triangles.push_back(setup_triangle{
+          {uint32_t(a), uint32_t(b), uint32_t(c)},
+          surface_color * intensity});
+
+      const auto tx0 = size_t(bboxmin.x) / tile_size;
+      const auto tx1 = size_t(bboxmax.x) / tile_size;
+      const auto ty0 = size_t(bboxmin.y) / tile_size;
+      const auto ty1 = size_t(bboxmax.y) / tile_size;
+      for (size_t ty = ty0; ty <= ty1; ++ty)
+        for (size_t tx = tx0; tx <= tx1; ++tx)
+          out->tiles[ty * tiles_x() + tx].push_back(index);
+    }
+  }
+
+  // Rasterise the triangles binned to tile t, in face order. Triangle
+  // coordinates are whole pixels, so clamping the bounding box to the
+  // tile samples the same points as triangle().
+  void rasterise(const std::vector<tile_bins>& bins, const size_t t,
+                 tile_buffer* tile, render_stats* stats) {
+    const float* sx = _screen.x.data();
+    const float* sy = _screen.y.data();
+    const float* sz = _screen.z.data();
+
+    const size_t x0 = (t % tiles_x()) * tile_size;
+    const size_t y0 = (t / tiles_x()) * tile_size;
+    const size_t x1 = std::min(x0 + tile_size, width());
+    const size_t y1 = std::min(y0 + tile_size, height());
+    // The bottom row of an inverted canvas is out of bounds.
+    const size_t ymin = _inverted ? std::max<size_t>(y0, 1) : y0;
+
+    bool empty = true;
+    for (const auto& b : bins)
+      empty &= b.tiles[t].empty();
+    if (empty)
+      return;
+
+    for (size_t y = ymin; y < y1; ++y) {
+      std::copy_n(&(*this)[y][x0], x1 - x0,
+                  tile->data + (y - y0) * tile_size);
+      std::copy_n(&_zbuffer[y * width() + x0], x1 - x0,
+                  tile->zbuffer + (y - y0) * tile_size);
+    }
+
+    // Blocks outside the canvas are never drawn, so they are given the
+    // greatest depth to keep them out of the tile's bound, and pixels
+    // outside the canvas count as covered.
+    const size_t bx0 = x0 / raster::block_size;
+    const size_t by0 = y0 / raster::block_size;
+    for (size_t by = 0; by < tile_buffer::blocks; ++by) {
+      for (size_t bx = 0; bx < tile_buffer::blocks; ++bx) {
+        tile->zmin[by * tile_buffer::blocks + bx] =
+            bx0 + bx < blocks_x() && by0 + by < blocks_y()
+            ? _zmin[(by0 + by) * blocks_x() + bx0 + bx]
+            : std::numeric_limits<float>::max();
+      }
+    }
+    std::fill_n(tile->covered, tile_buffer::blocks * tile_buffer::blocks, 0);
+    std::fill_n(tile->zcovered, tile_buffer::blocks * tile_buffer::blocks,
+                std::numeric_limits<float>::max());
+    if (ymin > y0 || x1 - x0 < tile_size || y1 - y0 < tile_size) {
+      for (size_t y = 0; y < tile_size; ++y)
+        for (size_t x = 0; x < tile_size; ++x)
+          if (y + y0 < ymin || x + x0 >= x1 || y + y0 >= y1)
+            tile->covered[tile_buffer::block(x, y)] |= tile_buffer::bit(x, y);
+    }
+    tile->refresh();
+
+    render_stats local;
+
+    // Skip occluded blocks, and raise the bounds of those covered.
+    struct occlusion {
+      tile_buffer* tile;
+      size_t x0, y0;
+      render_stats* stats;
+
+      bool test(const int x, const int y, const raster::depth_bounds& depth) {
+        ++stats->blocks;
+        if (depth.max > tile->zmin[tile_buffer::block(x - x0, y - y0)])
+          return true;
+        ++stats->blocks_occluded;
+        return false;
+      }
+
+      void cover(const int x, const int y, const raster::depth_bounds& depth,
+                 const uint64_t mask) {
+        tile->cover(tile_buffer::block(x - x0, y - y0), mask, depth.min);
+      }
+    } blocks{tile, x0, y0, &local};
+
+    for (const auto& b : bins) {
+      for (const uint32_t i : b.tiles[t]) {
+        const setup_triangle& tri = b.triangles[i];
+        const vec3f t0{sx[tri.v[0]], sy[tri.v[0]], sz[tri.v[0]]};
+        const vec3f t1{sx[tri.v[1]], sy[tri.v[1]], sz[tri.v[1]]};
+        const vec3f t2{sx[tri.v[2]], sy[tri.v[2]], sz[tri.v[2]]};
+
+        ++local.tiles;
+        if (tile->stale)
+          tile->refresh();
+        if (raster::depth_bounds(t0, t1, t2).max <= tile->tile_zmin) {
+          ++local.tiles_occluded;
+          continue;
+        }
+
+        const auto plot = [&](const size_t x, const size_t y, const float z) {
+          const size_t p = (y - y0) * tile_size + (x - x0);
+          ++local.fragments;
+          if (tile->zbuffer[p] < z) {
+            tile->zbuffer[p] = z;
+            tile->data[p] = tri.color;
+            ++local.writes;
+          }
+        };
+
+        if (!raster::fill(t0, t1, t2, static_cast<int>(x0),
+                          static_cast<int>(ymin), static_cast<int>(x1) - 1,
+                          static_cast<int>(y1) - 1, plot, blocks)) {
+          vec2f bboxmin, bboxmax;
+          bounds(t0, t1, t2, &bboxmin, &bboxmax);
+          bboxmin.x = std::max(bboxmin.x, float(x0));
+          bboxmin.y = std::max(bboxmin.y, float(ymin));
+          bboxmax.x = std::min(bboxmax.x, float(x1 - 1));
+          bboxmax.y = std::min(bboxmax.y, float(y1 - 1));
+          raster::fill_barycentric(t0, t1, t2, bboxmin, bboxmax, plot);
+        }
+      }
+    }
+    *stats += local;
+
+    for (size_t y = ymin; y < y1; ++y) {
+      std::copy_n(tile->data + (y - y0) * tile_size, x1 - x0,
+                  &(*this)[y][x0]);
+      std::copy_n(tile->zbuffer + (y - y0) * tile_size, x1 - x0,
+                  &_zbuffer[y * width() + x0]);
+    }
+
+    for (size_t by = 0; by < tile_buffer::blocks; ++by)
+      for (size_t bx = 0; bx < tile_buffer::blocks; ++bx)
+        if (bx0 + bx < blocks_x() && by0 + by < blocks_y())
+          _zmin[(by0 + by) * blocks_x() + bx0 + bx] =
+              tile->zmin[by * tile_buffer::blocks + bx];
+  }
+
+ protected:
+  const size_t _width, _height;
+  const bool _inverted;
+  std::vector<pixel> _data;
+  std::vector<float> _zbuffer;
+  // The lower bound on the depth of each block, as tile_buffer.
+  std::vector<float> _zmin;
+  screen_buffer _screen;
+  size_t _threads = 0;
+  std::vector<tile_bins> _bins;
+  render_stats _stats;
+};
+
+
+namespace qoi {
+
+// Encode an image in the "Quite OK Image" format: each pixel is a run
+// of the previous one, an index into a hash table of recent colours,
+// a small difference from the previous pixel, or a literal.
+inline std::vector<unsigned char> encode(const pixel* data,
+                                         const size_t width,
+                                         const size_t height) {
+  std::vector<unsigned char> out;
+  out.reserve(14 + width * height + 8);
+
+  const auto put32 = [&](const uint32_t v) {
+    for (int shift = 24; shift >= 0; shift -= 8)
+      out.push_back(static_cast<unsigned char>(v >> shift));
+  };
+
+  out.insert(out.end(), {'q', 'o', 'i', 'f'});
+  put32(static_cast<uint32_t>(width));
+  put32(static_cast<uint32_t>(height));
+  out.push_back(3);  // RGB
+  out.push_back(0);  // sRGB with linear alpha
+
+  // The colours in the index are RGBA, and start as transparent black,
+  // so never match an opaque pixel until stored.
+  const auto rgba = [](const pixel& px) {
+    return uint32_t(px.r) << 24 | uint32_t(px.g) << 16 |
+           uint32_t(px.b) << 8 | 0xff;
+  };
+  uint32_t index[64] = {};
+  pixel prev{0};
+  int run = 0;
+
+  const size_t n = width * height;
+  for (size_t i = 0; i < n; i++) {
+    const pixel& px = data[i];
+
+    if (px.r == prev.r && px.g == prev.g && px.b == prev.b) {
+      if (++run == 62 || i == n - 1) {
+        out.push_back(static_cast<unsigned char>(0xc0 | (run - 1)));
+        run = 0;
+      }
+      continue;
+    }
+    if (run) {
+      out.push_back(static_cast<unsigned char>(0xc0 | (run - 1)));
+      run = 0;
+    }
+
+    const int h = (px.r * 3 + px.g * 5 + px.b * 7 + 255 * 11) % 64;
+    if (index[h] == rgba(px)) {
+      out.push_back(static_cast<unsigned char>(h));
+    } else {
+      index[h] = rgba(px);
+
+      const auto dr = static_cast<signed char>(px.r - prev.r);
+      const auto dg = static_cast<signed char>(px.g - prev.g);
+      const auto db = static_cast<signed char>(px.b - prev.b);
+      const int dr_dg = dr - dg, db_dg = db - dg;
+
+      if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 &&
+          db >= -2 && db <= 1) {
+        out.push_back(static_cast<unsigned char>(
+            0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+      } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 &&
+                 db_dg >= -8 && db_dg <= 7) {
+        out.push_back(static_cast<unsigned char>(0x80 | (dg + 32)));
+        out.push_back(static_cast<unsigned char>((dr_dg + 8) << 4 |
+                                                 (db_dg + 8)));
+      } else {
+        out.insert(out.end(), {0xfe, px.r, px.g, px.b});
+      }
+    }
+
+    prev = px;
+  }
+
+  out.insert(out.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+  return out;
+}
+
+}  // namespace qoi
+
+
+class Image : public Canvas {
+ public:
+  Image(const size_t width, const size_t height,
+        bool inverted = true, const pixel& fill = pixel{})
+      : Canvas(width, height, inverted, fill) {}
+  Image(const size_t width, const size_t height,
+        const pixel& fill, bool inverted = true)
+      : Canvas(width, height, inverted, fill) {}
+
+  // The packed pixel buffer, in P6 payload order.
+  const pixel* data() const { return _data.data(); }
+
+  // Write the image to a P6 file with a single system call.
+  void write(const std::string& filename) const {
+    const std::string head = header();
+    iovec iov[2] = {
+      {const_cast<char*>(head.data()), head.size()},
+      {const_cast<pixel*>(_data.data()), _data.size() * sizeof(pixel)}};
+    write_file(filename, iov, 2);
+  }
+
+  // Write the image to a QOI file on a background thread, from a copy
+  // taken now. Errors are rethrown by the returned future's get().
+  std::future<void> write_qoi(const std::string& filename) const {
+    return std::async(std::launch::async,
+                      [filename, w = width(), h = height(), data = _data]() {
+      auto bytes = qoi::encode(data.data(), w, h);
+      iovec iov = {bytes.data(), bytes.size()};
+      write_file(filename, &iov, 1);
+    });
+  }
+
+  // P6 file format:
+  friend auto& operator<<(std::ostream& out, const Image& img) {
+    out << img.header();
+    out.write(reinterpret_cast<const char*>(img._data.data()),
+              static_cast<std::streamsize>(img._data.size() * sizeof(pixel)));
+    return out;
+  }
+
+ private:
+  std::string header() const {
+    return "P6\n" + std::to_string(width()) + ' ' +
+           std::to_string(height()) + '\n' +
+           std::to_string(std::numeric_limits<pixel::value_type>::max()) +
+           '\n';
+  }
+
+  // Write the buffers in iov to a file, resuming after short writes.
+  static void write_file(const std::string& filename, iovec* iov, int n) {
+    const int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+      throw std::runtime_error{"writing image"};
+
+    while (n) {
+      const ssize_t written = writev(fd, iov, n);
+      if (written < 0) {
+        if (errno == EINTR)
+          continue;
+        close(fd);
+        throw std::runtime_error{"writing image"};
+      }
+
+      auto left = static_cast<size_t>(written);
+      for (; n && left >= iov->iov_len; ++iov, --n)
+        left -= iov->iov_len;
+      if (n) {
+        iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+        iov->iov_len -= left;
+      }
+    }
+
+    if (close(fd))
+      throw std::runtime_error{"writing image"};
+  }
+};
+
+#endif  // R_R_H_
@@ -0,0 +1,168 @@
+// The tiled rasteriser against the serial one, and the edge function
+// fill against the barycentric one, on random triangles.
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "../r.h"
+
+namespace {
+
+struct mesh {
+  std::vector<vec3f> verts;
+  std::vector<int> faces;
+};
+
+// A soup of n triangles, with sizes from a pixel or so up to the whole
+// screen, some of them partly off screen.
+mesh soup(const size_t n, const unsigned seed) {
+  std::mt19937 rng{seed};
+  std::uniform_real_distribution<float> position{-1.2f, 1.2f};
+  std::uniform_real_distribution<float> depth{-1, 1};
+  std::uniform_real_distribution<float> scale{-7, 0};
+  mesh out;
+
+  for (size_t i = 0; i < n; ++i) {
+    const vec3f centre{position(rng), position(rng), depth(rng)};
+    const float size = std::exp2(scale(rng));
+    for (int j = 0; j < 3; ++j) {
+      out.faces.push_back(static_cast<int>(out.verts.size()));
+      out.verts.push_back(centre + vec3f{size * position(rng),
+                                         size * position(rng),
+                                         size * depth(rng)});
+    }
+  }
+
+  return out;
+}
+
+// Layers of a wavy grid of about n triangles each, drawn front to
+// back, so that most of each layer is hidden by the one before.
+mesh layers(const size_t n, const size_t count) {
+  const auto side = static_cast<size_t>(std::sqrt(n / 2.0));
+  mesh out;
+
+  for (size_t l = 0; l < count; ++l) {
+    const auto base = static_cast<int>(out.verts.size());
+    for (size_t y = 0; y <= side; ++y) {
+      for (size_t x = 0; x <= side; ++x) {
+        const float u = float(x) / side, v = float(y) / side;
+        out.verts.emplace_back(
+            1.8f * u - .9f, 1.8f * v - .9f,
+            .1f * std::sin(20 * u) * std::cos(20 * v) - .3f * l);
+      }
+    }
+    for (size_t y = 0; y < side; ++y) {
+      for (size_t x = 0; x < side; ++x) {
+        const int i = base + static_cast<int>(y * (side + 1) + x);
+        const int j = i + static_cast<int>(side + 1);
+        out.faces.insert(out.faces.end(), {i, i + 1, j, i + 1, j + 1, j});
+      }
+    }
+  }
+
+  return out;
+}
+
+// Draw the meshes with draw_serial() and with draw() at each thread
+// count, and expect identical images.
+void expect_identical(const std::vector<mesh>& meshes, const size_t width,
+                      const size_t height, const bool inverted) {
+  const vec3f light{.3f, .2f, -1};
+  const pixel color{100, 200, 140};
+
+  Image serial{width, height, inverted, pixel{255}};
+  for (const auto& m : meshes)
+    serial.draw_serial(m.verts.data(), m.verts.size(), m.faces.data(),
+                       m.faces.size(), light, color);
+
+  for (const size_t threads : {1, 2, 3, 4, 8}) {
+    Image tiled{width, height, inverted, pixel{255}};
+    tiled.threads(threads);
+    for (const auto& m : meshes)
+      tiled.draw(m.verts.data(), m.verts.size(), m.faces.data(),
+                 m.faces.size(), light, color);
+
+    EXPECT_EQ(0, std::memcmp(serial.data(), tiled.data(),
+                             width * height * sizeof(pixel)))
+        << width << "x" << height << (inverted ? " inverted" : "")
+        << ", " << threads << " threads";
+  }
+}
+
+TEST(draw, soup_matches_serial) {
+  for (unsigned seed = 0; seed < 4; ++seed) {
+    const mesh m = soup(20000, seed);
+    expect_identical({m}, 500, 300, true);
+    expect_identical({m}, 130, 777, false);
+  }
+}
+
+TEST(draw, layers_match_serial) {
+  expect_identical({layers(50000, 4)}, 1024, 1024, true);
+  expect_identical({layers(20000, 2), soup(5000, 7)}, 200, 200, false);
+}
+
+TEST(draw, redraw_matches_serial) {
+  const mesh m = soup(10000, 11);
+  expect_identical({m, m, soup(10000, 12)}, 320, 240, true);
+}
+
+// The pixels plotted by a rasteriser, and their depths.
+using fragments = std::map<std::pair<size_t, size_t>, float>;
+
+TEST(fill, matches_barycentric) {
+  std::mt19937 rng{1234};
+  std::uniform_int_distribution<int> origin{-50, 250};
+  std::uniform_int_distribution<int> size{0, 7};
+  std::uniform_real_distribution<float> depth{-1, 1};
+
+  const int xmin = 3, ymin = 5, xmax = 200, ymax = 150;
+
+  for (size_t i = 0; i < 5000; ++i) {
+    // whole pixel vertices, from within a pixel of each other up to
+    // well beyond the clip rectangle
+    const int x = origin(rng), y = origin(rng), span = 300 >> size(rng);
+    std::uniform_int_distribution<int> offset{-span, span};
+    const vec3f t0(float(x + offset(rng)), float(y + offset(rng)),
+                   depth(rng));
+    const vec3f t1(float(x + offset(rng)), float(y + offset(rng)),
+                   depth(rng));
+    const vec3f t2(float(x + offset(rng)), float(y + offset(rng)),
+                   depth(rng));
+
+    fragments a, b;
+    ASSERT_TRUE(raster::fill(t0, t1, t2, xmin, ymin, xmax, ymax,
+        [&](const size_t x, const size_t y, const float z) {
+          EXPECT_TRUE(a.emplace(std::make_pair(x, y), z).second);
+        }));
+
+    vec2f bboxmin, bboxmax;
+    for (unsigned j = 0; j < 2; ++j) {
+      bboxmin[j] = std::max(float(j ? ymin : xmin),
+                            std::min({t0[j], t1[j], t2[j]}));
+      bboxmax[j] = std::min(float(j ? ymax : xmax),
+                            std::max({t0[j], t1[j], t2[j]}));
+    }
+    raster::fill_barycentric(t0, t1, t2, bboxmin, bboxmax,
+        [&](const size_t x, const size_t y, const float z) {
+          b.emplace(std::make_pair(x, y), z);
+        });
+
+    ASSERT_EQ(b, a) << "triangle " << i << ": (" << t0.x << ", " << t0.y
+                    << ") (" << t1.x << ", " << t1.y << ") (" << t2.x
+                    << ", " << t2.y << ")";
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Scene construction and teardown time, and closest-hit traces/second,
+// against object count, for scenes with individually heap allocated
+// objects and for scenes built by a SceneBuilder.
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "./fixtures.h"
+#include "rt/builder.h"
+
+namespace {
+
+static const size_t numRays = 1024;
+static const size_t numMaterials = 16;
+
+// A cube of randomly placed spheres with random materials.
+template<typename Add>
+void generate(const size_t n, const rt::Material *const *const materials,
+              Add add) {
+  std::mt19937_64 rng(1234567);
+  std::uniform_int_distribution<size_t> material(0, numMaterials - 1);
+
+  fixtures::spheres(n, [&](const rt::Vector &p, const rt::Scalar r) {
+    add(p, r, materials[material(rng)]);
+  });
+}
+
+// Build a scene with new.
+std::unique_ptr<rt::Scene> heapScene(
+    const size_t n, std::vector<std::unique_ptr<rt::Material>> *materials) {
+  std::vector<const rt::Material *> m;
+  for (size_t i = 0; i < numMaterials; i++) {
+    materials->emplace_back(new rt::Material(rt::Colour(0xffffff),
+                                             0, 1, 0, 0, 0));
+    m.push_back(materials->back().get());
+  }
+
+  std::vector<rt::Object *> objects;
+  generate(n, m.data(), [&](const rt::Vector &p, const rt::Scalar r,
+                            const rt::Material *const material) {
+    objects.push_back(new rt::Sphere(p, r, material));
+  });
+
+  const std::vector<rt::Light *> lights = {
+    new rt::SoftLight(rt::Vector(0, 3000, 0))
+  };
+
+  return std::unique_ptr<rt::Scene>(new rt::Scene(objects, lights));
+}
+
+// Build a scene with a SceneBuilder.
+std::unique_ptr<rt::Scene> arenaScene(const size_t n) {
+  rt::SceneBuilder builder;
+
+  std::vector<const rt::Material *> m;
+  for (size_t i = 0; i < numMaterials; i++)
+    m.push_back(builder.material(rt::Colour(0xffffff), 0, 1, 0, 0, 0));
+
+  generate(n, m.data(), [&](const rt::Vector &p, const rt::Scalar r,
+                            const rt::Material *const material) {
+    builder.object<rt::Sphere>(p, r, material);
+  });
+
+  builder.light(rt::Vector(0, 3000, 0));
+
+  return builder.build();
+}
+
+// Shade the closest hit of each ray, so that object data is read
+// through the Object interface as it would be when rendering.
+void trace(benchmark::State &state, const rt::Scene &scene) {
+  const std::vector<rt::Ray> r = fixtures::rays(numRays);
+  rt::Scalar t;
+
+  while (state.KeepRunning()) {
+    for (const auto &ray : r) {
+      const rt::Object *const object =
+          scene.index.closestIntersect(ray, &t);
+      if (object) {
+        const rt::Vector point = ray.position + ray.direction * t;
+        benchmark::DoNotOptimize(object->normal(point));
+        benchmark::DoNotOptimize(object->surface(point));
+      }
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * numRays);
+}
+
+void BM_Build_Heap(benchmark::State &state) {
+  const size_t n = static_cast<size_t>(state.range(0));
+
+  while (state.KeepRunning()) {
+    std::vector<std::unique_ptr<rt::Material>> materials;
+    benchmark::DoNotOptimize(heapScene(n, &materials));
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Build_Heap)->RangeMultiplier(10)->Range(1000, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+void BM_Build_Arena(benchmark::State &state) {
+  const size_t n = static_cast<size_t>(state.range(0));
+
+  while (state.KeepRunning())
+    benchmark::DoNotOptimize(arenaScene(n));
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Build_Arena)->RangeMultiplier(10)->Range(1000, 1000000)
+    ->Unit(benchmark::kMillisecond);
+
+void BM_Trace_Heap(benchmark::State &state) {
+  std::vector<std::unique_ptr<rt::Material>> materials;
+  const auto scene = heapScene(static_cast<size_t>(state.range(0)),
+                               &materials);
+  trace(state, *scene);
+}
+BENCHMARK(BM_Trace_Heap)->RangeMultiplier(10)->Range(1000, 1000000);
+
+void BM_Trace_Arena(benchmark::State &state) {
+  const auto scene = arenaScene(static_cast<size_t>(state.range(0)));
+  trace(state, *scene);
+}
+BENCHMARK(BM_Trace_Arena)->RangeMultiplier(10)->Range(1000, 1000000);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Closest-hit and any-hit traces/second against object count, for
+// the BVH and for a linear scan over all objects.
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <vector>
+
+#include "./fixtures.h"
+#include "rt/objects.h"
+
+namespace {
+
+static const size_t numRays = 1024;
+
+// A cube of randomly placed spheres, with a ray set aimed into it.
+class Fixture {
+ public:
+  explicit Fixture(const size_t n)
+      : material(rt::Colour(0xffffff), 0, 1, 0, 0, 0) {
+    fixtures::spheres(n, [&](const rt::Vector &p, const rt::Scalar r) {
+      spheres.emplace_back(new rt::Sphere(p, r, &material));
+      objects.push_back(spheres.back().get());
+    });
+
+    rays = fixtures::rays(numRays);
+    index.reset(new rt::ObjectIndex(objects));
+  }
+
+  const rt::Material material;
+  std::vector<std::unique_ptr<rt::Sphere>> spheres;
+  std::vector<rt::Object *> objects;
+  std::vector<rt::Ray> rays;
+  std::unique_ptr<rt::ObjectIndex> index;
+};
+
+const rt::Object *linearClosest(const rt::Ray &ray,
+                                const std::vector<rt::Object *> &objects,
+                                rt::Scalar *const t) {
+  const rt::Object *closest = nullptr;
+  *t = INFINITY;
+
+  for (const auto object : objects) {
+    const rt::Scalar currentT = object->intersect(ray);
+    if (currentT != 0 && currentT < *t) {
+      *t = currentT;
+      closest = object;
+    }
+  }
+
+  return closest;
+}
+
+void BM_ClosestIntersect_Linear(benchmark::State &state) {
+  const Fixture fixture(static_cast<size_t>(state.range(0)));
+  rt::Scalar t;
+
+  while (state.KeepRunning()) {
+    for (const auto &ray : fixture.rays)
+      benchmark::DoNotOptimize(linearClosest(ray, fixture.objects, &t));
+  }
+
+  state.SetItemsProcessed(state.iterations() * numRays);
+}
+BENCHMARK(BM_ClosestIntersect_Linear)->RangeMultiplier(4)->Range(16, 16384);
+
+void BM_ClosestIntersect_BVH(benchmark::State &state) {
+  const Fixture fixture(static_cast<size_t>(state.range(0)));
+  rt::Scalar t;
+
+  while (state.KeepRunning()) {
+    for (const auto &ray : fixture.rays)
+      benchmark::DoNotOptimize(fixture.index->closestIntersect(ray, &t));
+  }
+
+  state.SetItemsProcessed(state.iterations() * numRays);
+}
+BENCHMARK(BM_ClosestIntersect_BVH)->RangeMultiplier(4)->Range(16, 262144);
+
+void BM_AnyIntersect_BVH(benchmark::State &state) {
+  const Fixture fixture(static_cast<size_t>(state.range(0)));
+
+  while (state.KeepRunning()) {
+    for (const auto &ray : fixture.rays)
+      benchmark::DoNotOptimize(fixture.index->intersects(ray, 6000));
+  }
+
+  state.SetItemsProcessed(state.iterations() * numRays);
+}
+BENCHMARK(BM_AnyIntersect_BVH)->RangeMultiplier(4)->Range(16, 262144);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Primary ray generation: the per-sample matrix transform and random
+// aperture sample which the renderer used to compute, against the
+// precomputed CameraRays increments and lens table.
+#include <benchmark/benchmark.h>
+
+#include "rt/camera.h"
+#include "rt/random.h"
+
+namespace {
+
+static const size_t width = 512;
+static const size_t height = 512;
+
+// A camera with a wide aperture.
+rt::Camera camera() {
+  return rt::Camera(rt::Vector(0, 0, -1000), rt::Vector(0, 0, 0),
+                    36, 36, rt::Lens(30, 5, .8));
+}
+
+void BM_TransformRays(benchmark::State &state) {
+  const rt::Camera camera = ::camera();
+  const size_t samples = static_cast<size_t>(state.range(0));
+  const rt::Matrix transform =
+      rt::Scale(camera.width / width, camera.height / height, 1)
+      * rt::Translation(-(width * .5), -(height * .5), 0);
+  rt::Scalar sum = 0;
+
+  while (state.KeepRunning()) {
+    for (size_t y = 0; y < height; y++) {
+      for (size_t x = 0; x < width; x++) {
+        const rt::Vector imageOrigin =
+            transform * rt::Vector(x + .5, y + .5, 0);
+        const rt::Vector focalOrigin = camera.right * imageOrigin.x
+            + camera.up * imageOrigin.y + camera.position;
+        const rt::Vector focalPoint = camera.filmBack
+            + (focalOrigin - camera.filmBack).normalise()
+            * camera.focusDistance;
+        const rt::seed key = rt::random::key(x + .5, y + .5);
+
+        for (size_t i = 0; i < samples; i++) {
+          rt::RandomStream rng(key, 2 * i);
+          const rt::Vector cameraSpace = imageOrigin
+              + camera.lens.aperture(rng);
+          const rt::Vector worldSpace = camera.right * cameraSpace.x
+              + camera.up * cameraSpace.y + camera.position;
+          const rt::Ray ray(worldSpace,
+                            (focalPoint - worldSpace).normalise());
+          sum += ray.direction.z;
+        }
+      }
+    }
+  }
+
+  benchmark::DoNotOptimize(sum);
+  state.SetItemsProcessed(state.iterations() * width * height * samples);
+}
+BENCHMARK(BM_TransformRays)->Arg(1)->Arg(16)->Unit(benchmark::kMillisecond);
+
+void BM_CameraRays(benchmark::State &state) {
+  const rt::Camera camera = ::camera();
+  const size_t samples = static_cast<size_t>(state.range(0));
+  const rt::CameraRays rays(camera, width, height, samples);
+  rt::Scalar sum = 0;
+
+  while (state.KeepRunning()) {
+    for (size_t y = 0; y < height; y++) {
+      for (size_t x = 0; x < width; x++) {
+        const rt::Vector film = rays.film(x + .5, y + .5);
+        const rt::Vector focus = rays.focus(film);
+
+        for (size_t i = 0; i < samples; i++)
+          sum += rays.ray(film, focus, i).direction.z;
+      }
+    }
+  }
+
+  benchmark::DoNotOptimize(sum);
+  state.SetItemsProcessed(state.iterations() * width * height * samples);
+}
+BENCHMARK(BM_CameraRays)->Arg(1)->Arg(16)->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
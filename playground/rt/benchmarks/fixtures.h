@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Random scenes and ray sets shared by the benchmarks. Each is drawn
+// from its own seeded generator, so is the same on every run.
+#ifndef RT_BENCHMARKS_FIXTURES_H_
+#define RT_BENCHMARKS_FIXTURES_H_
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "rt/math.h"
+#include "rt/ray.h"
+
+namespace fixtures {
+
+// The half width of the cube which scenes are placed in.
+static const rt::Scalar extent = 1000;
+
+// Call add(position, radius) for each of n spheres placed uniformly at
+// random in the cube [-extent, extent]^3, with radii uniform in
+// [minRadius, maxRadius).
+template<typename Add>
+void spheres(const size_t n, Add add, const rt::Scalar minRadius = 1,
+             const rt::Scalar maxRadius = 20,
+             const uint64_t seed = 1234567) {
+  std::mt19937_64 rng(seed);
+  std::uniform_real_distribution<rt::Scalar> position(-extent, extent);
+  std::uniform_real_distribution<rt::Scalar> radius(minRadius, maxRadius);
+
+  for (size_t i = 0; i < n; i++) {
+    const rt::Vector p(position(rng), position(rng), position(rng));
+    add(p, radius(rng));
+  }
+}
+
+// Return n rays from a point `distance' in front of the cube, each
+// aimed at a random point on its z = 0 cross section.
+inline std::vector<rt::Ray> rays(const size_t n,
+                                 const rt::Scalar distance = 3000,
+                                 const uint64_t seed = 7654321) {
+  std::mt19937_64 rng(seed);
+  std::uniform_real_distribution<rt::Scalar> position(-extent, extent);
+  std::vector<rt::Ray> out;
+  out.reserve(n);
+
+  const rt::Vector origin(0, 0, -distance);
+  for (size_t i = 0; i < n; i++) {
+    const rt::Vector target(position(rng), position(rng), 0);
+    out.emplace_back(origin, (target - origin).normalise());
+  }
+
+  return out;
+}
+
+}  // namespace fixtures
+
+#endif  // RT_BENCHMARKS_FIXTURES_H_
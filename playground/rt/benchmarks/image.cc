@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Image output throughput: the ASCII P3 stream operator of the
+// fixed-size Image, against the binary P6 and PFM writers.
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+
+#include "rt/image.h"
+
+namespace {
+
+static const size_t width = 1024;
+static const size_t height = 1024;
+static const char *const path = "bm_image.out";
+
+// Fill an image with a gradient.
+template<typename Image>
+void fill(Image *const image) {
+  for (size_t y = 0; y < image->height; y++)
+    for (size_t x = 0; x < image->width; x++)
+      image->set(x, y, rt::Colour(rt::Scalar(x) / image->width,
+                                  rt::Scalar(y) / image->height, .5));
+}
+
+void BM_WriteP3(benchmark::State &state) {
+  // Allocate on the heap, since the pixel array is a member.
+  std::unique_ptr<rt::Image<width, height>> image(
+      new rt::Image<width, height>());
+  fill(image.get());
+
+  while (state.KeepRunning()) {
+    std::ofstream out(path);
+    out << *image;
+  }
+
+  state.SetBytesProcessed(state.iterations() * width * height
+                          * sizeof(rt::Pixel));
+  std::remove(path);
+}
+BENCHMARK(BM_WriteP3)->Unit(benchmark::kMillisecond);
+
+void BM_WriteP6(benchmark::State &state) {
+  rt::DynamicImage image(width, height);
+  fill(&image);
+
+  while (state.KeepRunning())
+    rt::image::writeP6(path, image);
+
+  state.SetBytesProcessed(state.iterations() * width * height
+                          * sizeof(rt::Pixel));
+  std::remove(path);
+}
+BENCHMARK(BM_WriteP6)->Unit(benchmark::kMillisecond);
+
+void BM_WritePFM(benchmark::State &state) {
+  rt::DynamicImage image(width, height, 1, rt::Colour(1, 1, 1), true,
+                         true);
+  fill(&image);
+
+  while (state.KeepRunning())
+    rt::image::writePFM(path, width, height, image.hdr.data());
+
+  state.SetBytesProcessed(state.iterations() * width * height
+                          * 3 * sizeof(float));
+  std::remove(path);
+}
+BENCHMARK(BM_WritePFM)->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
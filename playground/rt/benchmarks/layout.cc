@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Closest-hit and any-hit traces/second against object count, for
+// an ObjectIndex which dispatches through the Object interface and
+// one which tests its typed sphere and plane arrays directly.
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <vector>
+
+#include "./fixtures.h"
+#include "rt/objects.h"
+
+namespace {
+
+static const size_t numRays = 1024;
+
+// A cube of randomly placed spheres above a ground plane, with a ray
+// set aimed into it.
+class Fixture {
+ public:
+  Fixture(const size_t n, const bool typed)
+      : material(rt::Colour(0xffffff), 0, 1, 0, 0, 0),
+        plane(rt::Vector(0, -1100, 0), rt::Vector(0, 1, 0), &material) {
+    objects.push_back(&plane);
+    fixtures::spheres(n, [&](const rt::Vector &p, const rt::Scalar r) {
+      spheres.emplace_back(new rt::Sphere(p, r, &material));
+      objects.push_back(spheres.back().get());
+    });
+
+    rays = fixtures::rays(numRays);
+    index.reset(new rt::ObjectIndex(objects, typed));
+  }
+
+  const rt::Material material;
+  rt::Plane plane;
+  std::vector<std::unique_ptr<rt::Sphere>> spheres;
+  std::vector<rt::Object *> objects;
+  std::vector<rt::Ray> rays;
+  std::unique_ptr<rt::ObjectIndex> index;
+};
+
+void closest(benchmark::State &state, const bool typed) {
+  const Fixture fixture(static_cast<size_t>(state.range(0)), typed);
+  rt::Scalar t;
+
+  while (state.KeepRunning()) {
+    for (const auto &ray : fixture.rays)
+      benchmark::DoNotOptimize(fixture.index->closestIntersect(ray, &t));
+  }
+
+  state.SetItemsProcessed(state.iterations() * numRays);
+}
+
+void any(benchmark::State &state, const bool typed) {
+  const Fixture fixture(static_cast<size_t>(state.range(0)), typed);
+
+  while (state.KeepRunning()) {
+    for (const auto &ray : fixture.rays)
+      benchmark::DoNotOptimize(fixture.index->intersects(ray, 6000));
+  }
+
+  state.SetItemsProcessed(state.iterations() * numRays);
+}
+
+void BM_ClosestIntersect_Virtual(benchmark::State &state) {
+  closest(state, false);
+}
+BENCHMARK(BM_ClosestIntersect_Virtual)->RangeMultiplier(8)->Range(16, 262144);
+
+void BM_ClosestIntersect_Typed(benchmark::State &state) {
+  closest(state, true);
+}
+BENCHMARK(BM_ClosestIntersect_Typed)->RangeMultiplier(8)->Range(16, 262144);
+
+void BM_AnyIntersect_Virtual(benchmark::State &state) {
+  any(state, false);
+}
+BENCHMARK(BM_AnyIntersect_Virtual)->RangeMultiplier(8)->Range(16, 262144);
+
+void BM_AnyIntersect_Typed(benchmark::State &state) {
+  any(state, true);
+}
+BENCHMARK(BM_AnyIntersect_Typed)->RangeMultiplier(8)->Range(16, 262144);
+
+}  // namespace
+
+BENCHMARK_MAIN();
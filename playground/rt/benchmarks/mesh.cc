@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Triangle meshes: OBJ load time and traces/second on the head model
+// of playground/r, against testing every triangle, and the build time
+// and traces/second of generated meshes of up to 10^6 triangles.
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "rt/objects.h"
+
+namespace {
+
+// The model, relative to the workspace root.
+static const char *const path = "playground/r/african_head.obj";
+
+static const size_t numRays = 4096;
+
+static const rt::Material material(rt::Colour(0xffffff), 0, 1, 0, 0, 0);
+
+// Return rays from a ring around the origin, aimed at random points
+// within `radius' of it.
+std::vector<rt::Ray> rays(const rt::Scalar radius) {
+  std::mt19937_64 rng(1234567);
+  std::uniform_real_distribution<rt::Scalar> angle(0, 2 * M_PI);
+  std::uniform_real_distribution<rt::Scalar> offset(-radius, radius);
+  std::vector<rt::Ray> out;
+
+  for (size_t i = 0; i < numRays; i++) {
+    const rt::Scalar theta = angle(rng);
+    const rt::Vector origin(4 * radius * std::cos(theta), radius,
+                            4 * radius * std::sin(theta));
+    const rt::Vector target(offset(rng), offset(rng), offset(rng));
+    out.emplace_back(origin, (target - origin).normalise());
+  }
+
+  return out;
+}
+
+// Return a square height field mesh of about n triangles.
+std::unique_ptr<rt::Mesh> grid(const size_t n) {
+  const size_t side = static_cast<size_t>(std::sqrt(n / 2.0)) + 1;
+  std::vector<rt::Scalar> vertices;
+  std::vector<uint32_t> triangles;
+
+  for (size_t z = 0; z <= side; z++) {
+    for (size_t x = 0; x <= side; x++) {
+      const rt::Scalar u = static_cast<rt::Scalar>(x) / side;
+      const rt::Scalar v = static_cast<rt::Scalar>(z) / side;
+      vertices.push_back(2 * u - 1);
+      vertices.push_back(
+          rt::Scalar(.1) * std::sin(20 * u) * std::cos(20 * v));
+      vertices.push_back(2 * v - 1);
+    }
+  }
+
+  for (size_t z = 0; z < side; z++) {
+    for (size_t x = 0; x < side; x++) {
+      const auto i = static_cast<uint32_t>(z * (side + 1) + x);
+      const auto j = static_cast<uint32_t>(i + side + 1);
+      triangles.insert(triangles.end(), {i, j, i + 1, i + 1, j, j + 1});
+    }
+  }
+
+  return std::unique_ptr<rt::Mesh>(new rt::Mesh(
+      std::move(vertices), std::move(triangles), &material));
+}
+
+void BM_LoadObj(benchmark::State &state) {
+  size_t triangles = 0;
+
+  while (state.KeepRunning())
+    triangles = rt::obj::load(path, &material)->size();
+
+  state.SetItemsProcessed(state.iterations() * triangles);
+}
+BENCHMARK(BM_LoadObj)->Unit(benchmark::kMillisecond);
+
+void BM_TraceObj(benchmark::State &state) {
+  const std::unique_ptr<rt::Mesh> mesh = rt::obj::load(path, &material);
+  const std::vector<rt::Ray> rays = ::rays(1);
+
+  while (state.KeepRunning()) {
+    for (const auto &ray : rays)
+      benchmark::DoNotOptimize(mesh->intersect(ray));
+  }
+
+  state.SetItemsProcessed(state.iterations() * numRays);
+}
+BENCHMARK(BM_TraceObj);
+
+void BM_TraceObjLinear(benchmark::State &state) {
+  const std::unique_ptr<rt::Mesh> mesh = rt::obj::load(path, &material);
+  const std::vector<rt::Ray> rays = ::rays(1);
+  const auto vertex = [&](const size_t i) {
+    return &mesh->vertices[3 * mesh->triangles[i]];
+  };
+
+  while (state.KeepRunning()) {
+    for (const auto &ray : rays) {
+      rt::Scalar closest = 0;
+      for (size_t i = 0; i < mesh->triangles.size(); i += 3) {
+        const rt::Scalar t = rt::intersectTriangle(
+            vertex(i), vertex(i + 1), vertex(i + 2), ray);
+        if (t > 0 && (closest == 0 || t < closest))
+          closest = t;
+      }
+      benchmark::DoNotOptimize(closest);
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * numRays);
+}
+BENCHMARK(BM_TraceObjLinear);
+
+void BM_BuildGrid(benchmark::State &state) {
+  size_t triangles = 0;
+
+  while (state.KeepRunning())
+    triangles = grid(static_cast<size_t>(state.range(0)))->size();
+
+  state.SetItemsProcessed(state.iterations() * triangles);
+}
+BENCHMARK(BM_BuildGrid)->Range(1 << 10, 1 << 20)
+    ->Unit(benchmark::kMillisecond);
+
+void BM_TraceGrid(benchmark::State &state) {
+  const std::unique_ptr<rt::Mesh> mesh =
+      grid(static_cast<size_t>(state.range(0)));
+  const std::vector<rt::Ray> rays = ::rays(1);
+
+  while (state.KeepRunning()) {
+    for (const auto &ray : rays)
+      benchmark::DoNotOptimize(mesh->intersect(ray));
+  }
+
+  state.SetItemsProcessed(state.iterations() * numRays);
+}
+BENCHMARK(BM_TraceGrid)->Range(1 << 10, 1 << 20);
+
+}  // namespace
+
+BENCHMARK_MAIN();
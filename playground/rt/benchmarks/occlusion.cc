@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Shadow queries in scanline order over a ground plane scattered with
+// spheres, with and without passing back the last occluder. The
+// label reports the mean number of intersection tests per query, and
+// the fraction of queries answered by the last occluder.
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "./fixtures.h"
+#include "rt/objects.h"
+#include "rt/profiling.h"
+
+namespace {
+
+static const size_t gridSize = 256;
+
+// Spheres resting on a ground plane, lit from above, and a grid of
+// points on the ground.
+class Fixture {
+ public:
+  explicit Fixture(const size_t n)
+      : material(rt::Colour(0xffffff), 0, 1, 0, 0, 0),
+        plane(rt::Vector(0, 0, 0), rt::Vector(0, 1, 0), &material),
+        light(-500, 2000, 300) {
+    objects.push_back(&plane);
+    fixtures::spheres(n, [&](const rt::Vector &p, const rt::Scalar r) {
+      spheres.emplace_back(new rt::Sphere(rt::Vector(p.x, r, p.z), r,
+                                          &material));
+      objects.push_back(spheres.back().get());
+    }, 5, 40);
+
+    for (size_t z = 0; z < gridSize; z++)
+      for (size_t x = 0; x < gridSize; x++)
+        points.emplace_back(-1000 + 2000 * (x + .5) / gridSize, .01,
+                            -1000 + 2000 * (z + .5) / gridSize);
+
+    index.reset(new rt::ObjectIndex(objects));
+  }
+
+  const rt::Material material;
+  rt::Plane plane;
+  std::vector<std::unique_ptr<rt::Sphere>> spheres;
+  std::vector<rt::Object *> objects;
+  std::vector<rt::Vector> points;
+  const rt::Vector light;
+  std::unique_ptr<rt::ObjectIndex> index;
+};
+
+void shadows(benchmark::State &state, const bool cached) {
+  const Fixture fixture(static_cast<size_t>(state.range(0)));
+  size_t occluder = rt::ObjectIndex::noOccluder;
+  size_t blocked = 0;
+
+  rt::profiling::counters::reset();
+  while (state.KeepRunning()) {
+    for (const auto &point : fixture.points) {
+      const rt::Vector toLight = fixture.light - point;
+      const rt::Scalar distance = toLight.size();
+      const rt::Ray ray(point, toLight / distance);
+
+      if (cached)
+        blocked += fixture.index->intersects(ray, distance, &occluder);
+      else
+        blocked += fixture.index->intersects(ray, distance);
+    }
+  }
+
+  const size_t queries = state.iterations() * fixture.points.size();
+  const rt::profiling::Counter hits =
+      rt::profiling::counters::getOccluderHitCount();
+  char label[80];
+  std::snprintf(label, sizeof(label),
+                "%.1f tests/query, %.0f%% blocked, %.0f%% cache hits",
+                static_cast<double>(
+                    rt::profiling::counters::getIntersectionCount())
+                / queries, 100. * blocked / queries,
+                100. * hits / queries);
+  state.SetLabel(label);
+  state.SetItemsProcessed(queries);
+}
+
+void BM_Shadows(benchmark::State &state) { shadows(state, false); }
+BENCHMARK(BM_Shadows)->Range(64, 64 << 10);
+
+void BM_ShadowsCached(benchmark::State &state) { shadows(state, true); }
+BENCHMARK(BM_ShadowsCached)->Range(64, 64 << 10);
+
+}  // namespace
+
+BENCHMARK_MAIN();
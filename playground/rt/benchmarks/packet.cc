@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Closest-hit traces/second for coherent bundles of primary rays,
+// traced one at a time and as packets.
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "./fixtures.h"
+#include "rt/objects.h"
+
+namespace {
+
+static const size_t numBundles = 256;
+
+// Randomly placed spheres above a floor plane, and bundles of DoF
+// rays: each bundle leaves from points on a lens aperture and
+// converges on a single focus point.
+class Fixture {
+ public:
+  explicit Fixture(const size_t n)
+      : material(rt::Colour(0xffffff), 0, 1, 0, 0, 0) {
+    objects.push_back(new rt::Plane(rt::Vector(0, -1000, 0),
+                                    rt::Vector(0, 1, 0), &material));
+    fixtures::spheres(n, [&](const rt::Vector &p, const rt::Scalar r) {
+      objects.push_back(new rt::Sphere(p, r, &material));
+    });
+
+    std::mt19937_64 rng(7654321);
+    std::uniform_real_distribution<rt::Scalar> position(-fixtures::extent,
+                                                        fixtures::extent);
+    std::uniform_real_distribution<rt::Scalar> aperture(-5, 5);
+    for (size_t i = 0; i < numBundles; i++) {
+      const rt::Vector focus(position(rng), position(rng), 0);
+      for (size_t j = 0; j < rt::packetSize; j++) {
+        const rt::Vector origin(aperture(rng), aperture(rng), -3000);
+        rays.emplace_back(origin, (focus - origin).normalise());
+      }
+    }
+
+    index.reset(new rt::ObjectIndex(objects));
+  }
+
+  ~Fixture() {
+    for (auto object : objects)
+      delete object;
+  }
+
+  const rt::Material material;
+  std::vector<rt::Object *> objects;
+  std::vector<rt::Ray> rays;
+  std::unique_ptr<rt::ObjectIndex> index;
+};
+
+void BM_ClosestIntersect_Scalar(benchmark::State &state) {
+  const Fixture fixture(static_cast<size_t>(state.range(0)));
+  rt::Scalar t;
+
+  while (state.KeepRunning()) {
+    for (const auto &ray : fixture.rays)
+      benchmark::DoNotOptimize(fixture.index->closestIntersect(ray, &t));
+  }
+
+  state.SetItemsProcessed(state.iterations() * fixture.rays.size());
+}
+BENCHMARK(BM_ClosestIntersect_Scalar)->RangeMultiplier(8)->Range(8, 32768);
+
+void BM_ClosestIntersect_Packet(benchmark::State &state) {
+  const Fixture fixture(static_cast<size_t>(state.range(0)));
+  rt::PacketHit hit;
+
+  while (state.KeepRunning()) {
+    for (size_t i = 0; i < fixture.rays.size(); i += rt::packetSize) {
+      const rt::RayPacket packet(rt::packetSize, [&](const size_t j) {
+        return fixture.rays[i + j];
+      });
+      fixture.index->closestIntersect(packet, &hit);
+      benchmark::DoNotOptimize(hit);
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * fixture.rays.size());
+}
+BENCHMARK(BM_ClosestIntersect_Packet)->RangeMultiplier(8)->Range(8, 32768);
+
+}  // namespace
+
+BENCHMARK_MAIN();
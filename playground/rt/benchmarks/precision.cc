@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Render throughput at the precision the library was built with. On
+// exit, the rendered image is written to "precision-<type>.ppm", and
+// compared against the image of the other precision, if present.
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rt/rt.h"
+
+namespace {
+
+static const size_t width = 128;
+static const size_t height = 128;
+
+using Image = rt::Image<width, height>;
+
+static const std::string precision =
+    sizeof(rt::Scalar) == sizeof(float) ? "float" : "double";
+static const std::string other =
+    sizeof(rt::Scalar) == sizeof(float) ? "double" : "float";
+
+// Reflective spheres above a checkerboard, with a soft light and
+// depth of field, exercising every precision-sensitive path.
+class Fixture {
+ public:
+  Fixture()
+      : red(rt::Colour(0xff0000), 0, 1, .2, 10, .2),
+        white(rt::Colour(0xffffff), 0, 1, .2, 10, .2),
+        black(rt::Colour(0x101010), 0, 1, .2, 10, .2),
+        scene(rt::Objects{
+            new rt::Sphere(rt::Vector(-110, 70, 0), 50, &red),
+            new rt::Sphere(rt::Vector(0, 70, 0), 50, &red),
+            new rt::Sphere(rt::Vector(110, 70, 0), 50, &red),
+            new rt::CheckerBoard(rt::Vector(0, 0, 0), rt::Vector(0, 1, 0),
+                                 25, &white, &black)},
+              rt::Lights{
+                new rt::SoftLight(rt::Vector(-300, 400, -400),
+                                  rt::Colour(0xffffff), 20, 4),
+                new rt::SoftLight(rt::Vector(300, 200, 100),
+                                  rt::Colour(0x505050))}),
+        camera(rt::Vector(0, 100, -400), rt::Vector(0, 50, 0),
+               50, 50, rt::Lens(50, 2)),
+        renderer(scene, &camera, 4, 8) {}
+
+  const rt::Material red, white, black;
+  const rt::Scene scene;
+  const rt::Camera camera;
+  const rt::Renderer renderer;
+};
+
+const Fixture &fixture() {
+  static const Fixture f;
+  return f;
+}
+
+void BM_Render(benchmark::State &state) {
+  std::unique_ptr<Image> image(new Image());
+
+  while (state.KeepRunning())
+    fixture().renderer.render(image.get());
+
+  state.SetItemsProcessed(state.iterations() * image->size);
+  state.SetLabel(precision);
+}
+BENCHMARK(BM_Render)->Unit(benchmark::kMillisecond);
+
+// Read the pixel values of a P3 image, or an empty vector on error.
+std::vector<int> readImage(const std::string &path) {
+  std::ifstream in(path);
+  std::string magic;
+  size_t w, h;
+  int max, v;
+  std::vector<int> values;
+
+  if (!(in >> magic >> w >> h >> max) || magic != "P3")
+    return values;
+  while (in >> v)
+    values.push_back(v);
+
+  return values;
+}
+
+// Print the difference between this precision's render and the
+// other's.
+void compare() {
+  const auto a = readImage("precision-" + precision + ".ppm");
+  const auto b = readImage("precision-" + other + ".ppm");
+
+  if (b.empty() || a.size() != b.size()) {
+    printf("\nNo %s render to compare against.\n", other.c_str());
+    return;
+  }
+
+  double sum = 0, squares = 0;
+  int max = 0;
+  size_t differing = 0;
+  for (size_t i = 0; i < a.size(); i++) {
+    const int diff = std::abs(a[i] - b[i]);
+    sum += diff;
+    squares += diff * diff;
+    max = std::max(max, diff);
+    differing += diff > 0;
+  }
+
+  const double mse = squares / a.size();
+  printf("\nImage difference, %s vs. %s:\n",
+         precision.c_str(), other.c_str());
+  printf("\tMean absolute error:\t%.4f\n", sum / a.size());
+  printf("\tMax absolute error:\t%d\n", max);
+  printf("\tDiffering components:\t%.3f%%\n",
+         100.0 * differing / a.size());
+  if (mse > 0)
+    printf("\tPSNR:\t\t\t%.2f dB\n", 10 * std::log10(255 * 255 / mse));
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+
+  std::unique_ptr<Image> image(new Image());
+  fixture().renderer.render(image.get());
+  std::ofstream out("precision-" + precision + ".ppm");
+  out << *image;
+  out.close();
+
+  compare();
+
+  return 0;
+}
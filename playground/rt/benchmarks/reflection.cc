@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Reflection tracing in a box of facing mirrors, where paths bounce
+// until their weight is cut off: without a cutoff (so paths run to
+// the maximum ray depth), with a minimum ray weight of 0.002, and
+// with Russian roulette. The label reports the mean path length.
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <memory>
+
+#include "rt/rt.h"
+
+namespace {
+
+static const size_t width = 16;
+static const size_t height = 16;
+
+using Image = rt::Image<width, height>;
+
+// Four mirrors around the z axis, closed by diffuse walls far along
+// it. The camera looks almost straight at one mirror.
+class Fixture {
+ public:
+  Fixture()
+      : mirror(rt::Colour(0xffffff), 0, .2, .2, 10, .9),
+        wall(rt::Colour(0x6f67b2), .1, 1, .2, 10, 0),
+        scene(rt::Objects{
+            new rt::Plane(rt::Vector(-100, 0, 0), rt::Vector(1, 0, 0),
+                          &mirror),
+            new rt::Plane(rt::Vector(100, 0, 0), rt::Vector(-1, 0, 0),
+                          &mirror),
+            new rt::Plane(rt::Vector(0, -100, 0), rt::Vector(0, 1, 0),
+                          &mirror),
+            new rt::Plane(rt::Vector(0, 100, 0), rt::Vector(0, -1, 0),
+                          &mirror),
+            new rt::Plane(rt::Vector(0, 0, 100000), rt::Vector(0, 0, -1),
+                          &wall),
+            new rt::Plane(rt::Vector(0, 0, -100000), rt::Vector(0, 0, 1),
+                          &wall)},
+              rt::Lights{
+                new rt::SoftLight(rt::Vector(0, 50, 0),
+                                  rt::Colour(0xffffff))}),
+        camera(rt::Vector(0, 0, 0), rt::Vector(1000, 200, 50),
+               20, 20, rt::Lens(50)) {}
+
+  const rt::Material mirror, wall;
+  const rt::Scene scene;
+  const rt::Camera camera;
+};
+
+void BM_Reflection(benchmark::State &state) {
+  static const Fixture fixture;
+  const rt::Renderer renderer(fixture.scene, &fixture.camera, 1, 5000, 32,
+                              state.range(0) / rt::Scalar(1e4),
+                              state.range(1) / rt::Scalar(1e4));
+  std::unique_ptr<Image> image(new Image());
+
+  rt::profiling::counters::reset();
+  while (state.KeepRunning())
+    renderer.render(image.get());
+
+  rt::profiling::Counter paths = 0;
+  for (size_t bin = 0; bin < rt::profiling::counters::numRayDepthBins; bin++)
+    paths += rt::profiling::counters::getRayDepthCount(bin);
+
+  char label[32];
+  std::snprintf(label, sizeof(label), "%.1f traces/path",
+                static_cast<double>(rt::profiling::counters::getTraceCount())
+                / paths);
+  state.SetLabel(label);
+  state.SetItemsProcessed(state.iterations() * image->size);
+}
+// Arguments are the minimum ray weight and roulette weight, x 1e4.
+BENCHMARK(BM_Reflection)
+    ->Args({0, 0})
+    ->Args({20, 0})
+    ->Args({20, 1000})
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Thread scaling of the tiled renderer: pixels/second for a full
+// render from 1 to N worker threads, at several tile sizes.
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <thread>
+
+#include "tbb/task_arena.h"
+
+#include "rt/rt.h"
+
+namespace {
+
+static const size_t width = 256;
+static const size_t height = 256;
+
+using Image = rt::Image<width, height>;
+
+// A row of reflective spheres above a checkerboard, lit by two
+// lights.
+class Fixture {
+ public:
+  Fixture()
+      : red(rt::Colour(0xff0000), 0, 1, .2, 10, .2),
+        white(rt::Colour(0xffffff), 0, 1, .2, 10, .2),
+        black(rt::Colour(0x101010), 0, 1, .2, 10, .2),
+        scene(rt::Objects{
+            new rt::Sphere(rt::Vector(-100, 50, 0), 50, &red),
+            new rt::Sphere(rt::Vector(0, 50, 0), 50, &red),
+            new rt::Sphere(rt::Vector(100, 50, 0), 50, &red),
+            new rt::CheckerBoard(rt::Vector(0, 0, 0), rt::Vector(0, 1, 0),
+                                 25, &white, &black)},
+              rt::Lights{
+                new rt::SoftLight(rt::Vector(-300, 400, -400),
+                                  rt::Colour(0xffffff)),
+                new rt::SoftLight(rt::Vector(300, 200, 100),
+                                  rt::Colour(0x505050))}),
+        camera(rt::Vector(0, 100, -400), rt::Vector(0, 50, 0),
+               50, 50, rt::Lens(50)) {}
+
+  const rt::Material red, white, black;
+  const rt::Scene scene;
+  const rt::Camera camera;
+};
+
+void BM_Render(benchmark::State &state) {
+  static const Fixture fixture;
+  const auto threads = static_cast<int>(state.range(0));
+  const auto tileSize = static_cast<size_t>(state.range(1));
+  const rt::Renderer renderer(fixture.scene, &fixture.camera,
+                              1, 5000, tileSize);
+  std::unique_ptr<Image> image(new Image());
+  tbb::task_arena arena(threads);
+
+  while (state.KeepRunning())
+    arena.execute([&]() { renderer.render(image.get()); });
+
+  state.SetItemsProcessed(state.iterations() * image->size);
+}
+
+void Args(benchmark::internal::Benchmark *b) {
+  const int n = static_cast<int>(std::thread::hardware_concurrency());
+
+  for (const int tileSize : {8, 32, 128}) {
+    int threads = 1;
+    for (; threads < n; threads *= 2)
+      b->Args({threads, tileSize});
+    b->Args({n, tileSize});
+  }
+}
+BENCHMARK(BM_Render)->Apply(Args)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
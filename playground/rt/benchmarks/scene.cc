@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Scene loading time against object count: parsing a .rt file and
+// building the BVH, against reading a compiled scene cache.
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "./fixtures.h"
+#include "rt/loader.h"
+
+namespace {
+
+static const char *const scenePath = "bm_scene.rt";
+static const char *const cachePath = "bm_scene.cache";
+
+// Write a scene file of n randomly placed spheres, and its cache.
+void writeScene(const size_t n) {
+  std::ofstream out(scenePath);
+  out << "[Lens.l]\nFocalLength: 36\n"
+      << "[Film.f]\nWidth: 36\nHeight: 36\n"
+      << "[Camera.Perspective]\nPosition: 0 0 3000\nLookat: 0 0 0\n"
+      << "Lens: $Lens.l\nFilm: $Film.f\n"
+      << "[Material.m]\nColour: 0xffffff\nDiffuse: 100\n"
+      << "[Light.Soft]\nPosition: 0 2000 0\nSize: 100\n"
+      << "[Object.Plane]\nPosition: 0 -1000 0\nDirection: 0 1 0\n"
+      << "Material: $Material.m\n";
+
+  fixtures::spheres(n, [&](const rt::Vector &p, const rt::Scalar r) {
+    out << "[Object.Sphere]\nPosition: " << p.x << " " << p.y << " "
+        << p.z << "\nSize: " << r << "\nMaterial: $Material.m\n";
+  });
+  out.close();
+
+  const rt::LoadedScene loaded(rt::scene::parse(scenePath));
+  rt::scene::writeCache(cachePath, loaded.description,
+                        loaded.scene->index.hierarchy());
+}
+
+void BM_Parse(benchmark::State &state) {
+  writeScene(static_cast<size_t>(state.range(0)));
+
+  while (state.KeepRunning()) {
+    const rt::LoadedScene loaded(rt::scene::parse(scenePath));
+    benchmark::DoNotOptimize(loaded.scene.get());
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  std::remove(scenePath);
+  std::remove(cachePath);
+}
+BENCHMARK(BM_Parse)->RangeMultiplier(10)->Range(100, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+void BM_ReadCache(benchmark::State &state) {
+  writeScene(static_cast<size_t>(state.range(0)));
+
+  while (state.KeepRunning()) {
+    const std::unique_ptr<rt::LoadedScene> loaded =
+        rt::scene::readCache(cachePath);
+    benchmark::DoNotOptimize(loaded->scene.get());
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  std::remove(scenePath);
+  std::remove(cachePath);
+}
+BENCHMARK(BM_ReadCache)->RangeMultiplier(10)->Range(100, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -21,40 +21,41 @@
 #include "rt/rt.h"
 
 #include <array>  // NOLINT(build/include_order)
+#include <cstdlib>  // NOLINT(build/include_order)
 
-static const size_t width = 512;
-static const size_t height = 512;
+// Usage: example1 [width height]
+int main(int argc, char **argv) {
+  // Get image size.
+  const size_t width = argc == 3 ? std::strtoul(argv[1], nullptr, 10) : 512;
+  const size_t height = argc == 3 ? std::strtoul(argv[2], nullptr, 10) : 512;
 
-int main() {
   // Create colours.
   static const rt::Colour red   = rt::Colour(0xff0000);
   static const rt::Colour green = rt::Colour(0x00ff00);
   static const rt::Colour blue  = rt::Colour(0x0000ff);
 
+  // The scene builder allocates all of the scene's materials,
+  // objects and lights.
+  rt::SceneBuilder builder;
+
   // Create materials.
-  const std::array<rt::Material *, 3> materials = {
-    new rt::Material(red, 0, 1, .2, 10, 0),
-    new rt::Material(green, 0, 1, .2, 10, 0),
-    new rt::Material(blue, 0, 1, .2, 10, 0)
+  const std::array<const rt::Material *, 3> materials = {
+    builder.material(red, 0, 1, .2, 10, 0),
+    builder.material(green, 0, 1, .2, 10, 0),
+    builder.material(blue, 0, 1, .2, 10, 0)
   };
 
   // Create objects.
-  const std::array<rt::Sphere *, 3> _objects = {
-    new rt::Sphere(rt::Vector(0,    50, 0), 50,
-                   materials[0]),
-    new rt::Sphere(rt::Vector(50,  -50, 0), 50,
-                   materials[1]),
-    new rt::Sphere(rt::Vector(-50, -50, 0), 50,
-                   materials[2])
-  };
+  builder.object<rt::Sphere>(rt::Vector(0,    50, 0), 50,
+                             materials[0]);
+  builder.object<rt::Sphere>(rt::Vector(50,  -50, 0), 50,
+                             materials[1]);
+  builder.object<rt::Sphere>(rt::Vector(-50, -50, 0), 50,
+                             materials[2]);
 
   // Create lights.
-  const std::array<rt::Light *, 2> _lights = {
-    new rt::SoftLight(rt::Vector(-300,  400, -400),
-                      rt::Colour(0xffffff)),
-    new rt::SoftLight(rt::Vector( 300, -200,  100),
-                      rt::Colour(0x505050))
-  };
+  builder.light(rt::Vector(-300,  400, -400), rt::Colour(0xffffff));
+  builder.light(rt::Vector( 300, -200,  100), rt::Colour(0x505050));
 
   // Create camera.
   const rt::Camera *const restrict camera =
@@ -63,18 +64,15 @@ int main() {
                    50, 50,         // film width & height
                    rt::Lens(50));  // focal length
 
-  // Create collections.
-  const rt::Objects objects(_objects.begin(), _objects.end());
-  const rt::Lights  lights(_lights.begin(),  _lights.end());
-
   // Create scene and renderer.
-  const rt::Scene scene(objects, lights);
-  const rt::Renderer renderer(scene, camera);
+  const std::unique_ptr<rt::Scene> scene = builder.build();
+  rt::printStats(builder.stats());
+  const rt::Renderer renderer(*scene, camera);
 
-  rt::Image<width, height> *const image = new rt::Image<width, height>();
+  rt::DynamicImage *const image = new rt::DynamicImage(width, height);
 
   // Run ray tracer.
-  rt::render<rt::Image<width, height>>(renderer, "render1.ppm", image);
+  rt::render(renderer, "render1.ppm", image);
 
   delete image;
 
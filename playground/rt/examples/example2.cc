@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Render a scene file.
+#include "rt/loader.h"
+#include "rt/rt.h"
+
+#include <cstdio>  // NOLINT(build/include_order)
+#include <memory>  // NOLINT(build/include_order)
+
+// Usage: example2 [scene.rt [cache]]
+int main(int argc, char **argv) {
+  const std::string path = argc > 1
+      ? argv[1] : "playground/rt/examples/example2.rt";
+  const std::string cachePath = argc > 2 ? argv[2] : "";
+
+  try {
+    // Load the scene.
+    rt::profiling::Timer t = rt::profiling::Timer();
+    const std::unique_ptr<rt::LoadedScene> loaded =
+        rt::scene::load(path, cachePath);
+    printf("Loaded scene '%s' in %.3f seconds.\n", path.c_str(),
+           t.elapsed());
+
+    const std::unique_ptr<rt::Renderer> renderer = loaded->renderer();
+    const std::unique_ptr<rt::DynamicImage> image = loaded->image();
+
+    // Run ray tracer.
+    rt::render(*renderer, loaded->description.path, image.get());
+  } catch (const std::runtime_error &e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+
+  return 0;
+}
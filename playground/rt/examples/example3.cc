@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Include ray tracer header.
+#include "rt/rt.h"
+
+#include <cstdlib>  // NOLINT(build/include_order)
+#include <memory>  // NOLINT(build/include_order)
+#include <vector>  // NOLINT(build/include_order)
+
+// Render a fly-through of the scene of example1, writing frames to
+// frame0000.ppm, frame0001.ppm, etc.
+//
+// Usage: example3 [frames [width height]]
+int main(int argc, char **argv) {
+  const size_t frames = argc >= 2 ? std::strtoul(argv[1], nullptr, 10) : 24;
+  const size_t width = argc == 4 ? std::strtoul(argv[2], nullptr, 10) : 256;
+  const size_t height = argc == 4 ? std::strtoul(argv[3], nullptr, 10) : 256;
+
+  // Build the scene once, for every frame.
+  rt::SceneBuilder builder;
+  builder.object<rt::Sphere>(
+      rt::Vector(0, 50, 0), 50,
+      builder.material(rt::Colour(0xff0000), 0, 1, .2, 10, 0));
+  builder.object<rt::Sphere>(
+      rt::Vector(50, -50, 0), 50,
+      builder.material(rt::Colour(0x00ff00), 0, 1, .2, 10, 0));
+  builder.object<rt::Sphere>(
+      rt::Vector(-50, -50, 0), 50,
+      builder.material(rt::Colour(0x0000ff), 0, 1, .2, 10, 0));
+  builder.light(rt::Vector(-300,  400, -400), rt::Colour(0xffffff));
+  builder.light(rt::Vector( 300, -200,  100), rt::Colour(0x505050));
+
+  const std::unique_ptr<rt::Scene> scene = builder.build();
+  rt::printStats(builder.stats());
+
+  // Swing the camera around the front of the spheres.
+  const rt::Vector origin(0, 0, 0);
+  const std::vector<rt::Keyframe> keyframes = {
+    {rt::Vector(-200, 0, -100), origin},
+    {rt::Vector(0, 50, -200), origin},
+    {rt::Vector(200, 0, -100), origin}
+  };
+  const std::vector<rt::Camera> cameras =
+      rt::cameraPath(keyframes, frames, 50, 50, rt::Lens(50));
+
+  rt::DynamicImage front(width, height);
+  rt::DynamicImage back(width, height);
+
+  rt::renderAnimation(*scene, cameras, "frame", &front, &back);
+
+  return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Render a scene file with several worker processes.
+#include "rt/loader.h"
+#include "rt/rt.h"
+
+#include <sys/wait.h>  // NOLINT(build/include_order)
+#include <unistd.h>  // NOLINT(build/include_order)
+
+#include <algorithm>  // NOLINT(build/include_order)
+#include <cstdio>  // NOLINT(build/include_order)
+#include <cstdlib>  // NOLINT(build/include_order)
+#include <cstring>  // NOLINT(build/include_order)
+#include <memory>  // NOLINT(build/include_order)
+#include <thread>  // NOLINT(build/include_order)
+#include <vector>  // NOLINT(build/include_order)
+
+// Usage:
+//
+//   example4 scene.rt [workers]
+//       Render with worker processes forked from this one.
+//   example4 --coordinator socket scene.rt workers
+//       Render with workers started separately.
+//   example4 --worker socket scene.rt
+//       Render tiles for a coordinator.
+int main(int argc, char **argv) {
+  const bool coordinator = argc == 5 && !strcmp(argv[1], "--coordinator");
+  const bool worker = argc == 4 && !strcmp(argv[1], "--worker");
+  const bool local = !coordinator && !worker && argc >= 2 && argc <= 3;
+
+  if (!coordinator && !worker && !local) {
+    fprintf(stderr, "Usage: %s scene.rt [workers]\n"
+            "       %s --coordinator socket scene.rt workers\n"
+            "       %s --worker socket scene.rt\n",
+            argv[0], argv[0], argv[0]);
+    return 1;
+  }
+
+  const std::string path = local ? argv[1] : argv[3];
+  const std::string socket = local
+      ? "/tmp/rt-" + std::to_string(getpid()) + ".sock" : argv[2];
+  const size_t workers = coordinator
+      ? std::strtoul(argv[4], nullptr, 10)
+      : argc == 3 ? std::strtoul(argv[2], nullptr, 10) : 4;
+
+  try {
+    // Load the scene.
+    rt::profiling::Timer t = rt::profiling::Timer();
+    const std::unique_ptr<rt::LoadedScene> loaded = rt::scene::load(path);
+    printf("Loaded scene '%s' in %.3f seconds.\n", path.c_str(),
+           t.elapsed());
+
+    const std::unique_ptr<rt::Renderer> renderer = loaded->renderer();
+
+    if (worker) {
+      rt::distributed::serve(socket, *renderer);
+      return 0;
+    }
+
+    // Listen before forking, so that workers can connect at once.
+    rt::TileCoordinator tiles(socket, workers);
+
+    // Share the cores between the local workers.
+    const size_t threads = std::max<size_t>(
+        std::thread::hardware_concurrency() / std::max<size_t>(workers, 1),
+        1);
+
+    std::vector<pid_t> children;
+    for (size_t i = 0; local && i < workers; i++) {
+      const pid_t pid = ::fork();
+      if (pid < 0) {
+        perror("fork");
+        return 1;
+      }
+
+      if (!pid) {
+        int status = 0;
+        try {
+          rt::distributed::serve(socket, *renderer, threads);
+        } catch (const std::runtime_error &e) {
+          fprintf(stderr, "%s\n", e.what());
+          status = 1;
+        }
+        _exit(status);
+      }
+      children.push_back(pid);
+    }
+
+    const std::unique_ptr<rt::DynamicImage> image = loaded->image();
+    rt::renderDistributed(&tiles, loaded->description.path, image.get());
+  } catch (const std::runtime_error &e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+
+  // The coordinator has closed its connections, so workers exit.
+  int status;
+  while (wait(&status) > 0) {}
+
+  return 0;
+}
@@ -0,0 +1,112 @@
+/* -*-c++-*-
+ *
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RT_ARENA_H_
+#define RT_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace rt {
+
+// A bump allocator. Memory is handed out from large chunks in the
+// order in which it is requested, so consecutive allocations are
+// contiguous, and is only released all at once when the arena is
+// destroyed. Values which are not trivially destructible are
+// destroyed with the arena, in the reverse order of construction.
+class Arena {
+ public:
+  // Constructor. The first chunk holds `chunkSize' bytes, and each
+  // subsequent chunk twice as many as the last, up to maxChunkSize.
+  explicit Arena(const size_t chunkSize = 64 << 10);
+
+  // Destructor. Destroys the values, and releases every chunk.
+  ~Arena();
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  // Allocate `size' bytes aligned to `alignment', which must be a
+  // power of two.
+  inline void *allocate(const size_t size, const size_t alignment) {
+    uintptr_t p = (reinterpret_cast<uintptr_t>(next) + alignment - 1)
+                  & ~(alignment - 1);
+
+    if (p + size > reinterpret_cast<uintptr_t>(end)) {
+      grow(size + alignment);
+      p = (reinterpret_cast<uintptr_t>(next) + alignment - 1)
+          & ~(alignment - 1);
+    }
+
+    _used += size;
+    next = reinterpret_cast<char *>(p + size);
+    return reinterpret_cast<void *>(p);
+  }
+
+  // Construct a value in the arena.
+  template<typename T, typename... Args>
+  inline T *make(Args&&... args) {
+    T *const value = new (allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+    if (!std::is_trivially_destructible<T>::value)
+      destructors.push_back({value, &destroy<T>});
+    return value;
+  }
+
+  // Return the number of bytes allocated, excluding alignment
+  // padding.
+  inline size_t used() const { return _used; }
+
+  // Return the number of bytes reserved from the system.
+  inline size_t reserved() const { return _reserved; }
+
+  // The largest chunk size which the arena grows to.
+  static constexpr size_t maxChunkSize = 64 << 20;
+
+ private:
+  // A value which must be destroyed, and the function to do so.
+  struct Destructor {
+    void *value;
+    void (*destroy)(void *const value);
+  };
+
+  template<typename T>
+  static void destroy(void *const value) {
+    static_cast<T *>(value)->~T();
+  }
+
+  std::vector<char *> chunks;
+  std::vector<Destructor> destructors;
+  char *next;
+  char *end;
+  size_t chunkSize;
+  size_t _used;
+  size_t _reserved;
+
+  // Start a new chunk with room for at least `size' bytes.
+  void grow(const size_t size);
+};
+
+}  // namespace rt
+
+#endif  // RT_ARENA_H_
@@ -0,0 +1,120 @@
+/* -*-c++-*-
+ *
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RT_BUILDER_H_
+#define RT_BUILDER_H_
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "rt/arena.h"
+#include "rt/graphics.h"
+#include "rt/lights.h"
+#include "rt/objects.h"
+#include "rt/profiling.h"
+#include "rt/scene.h"
+
+namespace rt {
+
+// Builds a scene whose materials, objects and lights are all
+// allocated in one arena, which is handed to the scene, so the whole
+// scene is freed at once.
+//
+// Materials and lights are placed in the arena as they are added.
+// Objects are staged until build(), when they are moved into the
+// arena in BVH leaf order, so that objects which are tested together
+// during traversal are adjacent in memory.
+//
+// Object types must be movable. Everything is destroyed with the
+// scene, and staged objects once they have been moved from.
+class SceneBuilder {
+ public:
+  // The cost of building a scene.
+  struct Stats {
+    // Seconds from construction of the builder until build()
+    // returns, including the time taken to add entities.
+    Scalar time;
+    size_t materials;
+    size_t objects;
+    size_t lights;
+    // Bytes allocated for the scene's entities, and reserved for
+    // them by the arena.
+    size_t used;
+    size_t reserved;
+  };
+
+  // Constructor.
+  SceneBuilder();
+
+  // Add a material.
+  template<typename... Args>
+  const Material *material(Args&&... args) {
+    _stats.materials++;
+    return arena->make<Material>(std::forward<Args>(args)...);
+  }
+
+  // Add an object of type T. Objects do not have a stable address
+  // until the scene is built, so none is returned.
+  template<typename T, typename... Args>
+  void object(Args&&... args) {
+    staged.push_back({staging->make<T>(std::forward<Args>(args)...),
+                      &relocate<T>});
+  }
+
+  // Add a light of type T.
+  template<typename T = SoftLight, typename... Args>
+  const T *light(Args&&... args) {
+    T *const light = arena->make<T>(std::forward<Args>(args)...);
+    lights.push_back(light);
+    return light;
+  }
+
+  // Build the scene, which takes ownership of everything added. May
+  // only be called once. Throws std::logic_error if called again.
+  std::unique_ptr<Scene> build();
+
+  // Return the cost of building the scene. Valid after build().
+  inline const Stats &stats() const { return _stats; }
+
+ private:
+  // An object in the staging arena, and the function to move it
+  // into another arena.
+  struct Staged {
+    Object *object;
+    Object *(*relocate)(Object *const object, Arena *const arena);
+  };
+
+  template<typename T>
+  static Object *relocate(Object *const object, Arena *const arena) {
+    return arena->make<T>(std::move(*static_cast<T *>(object)));
+  }
+
+  profiling::Timer timer;
+  std::unique_ptr<Arena> arena;
+  std::unique_ptr<Arena> staging;
+  std::vector<Staged> staged;
+  std::vector<Light *> lights;
+  Stats _stats;
+};
+
+}  // namespace rt
+
+#endif  // RT_BUILDER_H_
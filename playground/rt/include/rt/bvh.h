@@ -0,0 +1,365 @@
+/* -*-c++-*-
+ *
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RT_BVH_H_
+#define RT_BVH_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "rt/math.h"
+#include "rt/ray.h"
+#include "rt/restrict.h"
+
+namespace rt {
+
+// An axis-aligned bounding box. Unlike Vectors, boxes are mutable so
+// that they can be grown while building a hierarchy.
+class BoundingBox {
+ public:
+  Scalar min[3];
+  Scalar max[3];
+
+  // Constructor: an empty box, which contains nothing.
+  inline BoundingBox()
+      : min{std::numeric_limits<Scalar>::max(),
+            std::numeric_limits<Scalar>::max(),
+            std::numeric_limits<Scalar>::max()},
+        max{-std::numeric_limits<Scalar>::max(),
+            -std::numeric_limits<Scalar>::max(),
+            -std::numeric_limits<Scalar>::max()} {}
+
+  // Constructor: the box spanning two corners.
+  inline BoundingBox(const Vector &_min, const Vector &_max)
+      : min{_min.x, _min.y, _min.z}, max{_max.x, _max.y, _max.z} {}
+
+  // Grow the box to contain another box.
+  inline void extend(const BoundingBox &b) {
+    for (size_t i = 0; i < 3; i++) {
+      min[i] = std::min(min[i], b.min[i]);
+      max[i] = std::max(max[i], b.max[i]);
+    }
+  }
+
+  // Grow the box to contain a point.
+  inline void extend(const Scalar p[3]) {
+    for (size_t i = 0; i < 3; i++) {
+      min[i] = std::min(min[i], p[i]);
+      max[i] = std::max(max[i], p[i]);
+    }
+  }
+
+  // Return the centre of the box along an axis.
+  inline Scalar centre(const size_t axis) const {
+    return (min[axis] + max[axis]) / 2;
+  }
+
+  // Return the axis along which the box is longest.
+  inline size_t longestAxis() const {
+    const Scalar dx = max[0] - min[0];
+    const Scalar dy = max[1] - min[1];
+    const Scalar dz = max[2] - min[2];
+
+    if (dx > dy && dx > dz)
+      return 0;
+    else if (dy > dz)
+      return 1;
+    else
+      return 2;
+  }
+
+  // Return the surface area of the box (0 if empty).
+  inline Scalar area() const {
+    const Scalar dx = max[0] - min[0];
+    const Scalar dy = max[1] - min[1];
+    const Scalar dz = max[2] - min[2];
+
+    if (dx < 0 || dy < 0 || dz < 0)
+      return 0;
+
+    return 2 * (dx * dy + dy * dz + dz * dx);
+  }
+
+  // Slab test. Return whether a ray with reciprocal direction
+  // `invDirection' enters the box closer than `distance', and if so,
+  // set `t' to the entry distance.
+  inline bool intersect(const Ray &ray,
+                        const Scalar invDirection[3],
+                        const Scalar distance,
+                        Scalar *const restrict t) const {
+    const Scalar origin[3] = {ray.position.x, ray.position.y,
+                              ray.position.z};
+    Scalar tmin = 0;
+    Scalar tmax = distance;
+
+    for (size_t i = 0; i < 3; i++) {
+      Scalar t0 = (min[i] - origin[i]) * invDirection[i];
+      Scalar t1 = (max[i] - origin[i]) * invDirection[i];
+      if (t0 > t1)
+        std::swap(t0, t1);
+
+      // Written so that NaNs (origin on a slab face of a
+      // zero-direction axis) do not reject the box.
+      tmin = t0 > tmin ? t0 : tmin;
+      tmax = t1 < tmax ? t1 : tmax;
+
+      if (tmin > tmax)
+        return false;
+    }
+
+    *t = tmin;
+    return true;
+  }
+};
+
+// A bounding volume hierarchy over a set of primitives, each of
+// which is described only by its bounding box. The hierarchy is
+// built once using a binned surface area heuristic, and is then
+// immutable. Primitives are referred to by their index in the box
+// list passed to the constructor; the `indices' member lists them in
+// leaf order.
+//
+// Traversal is parameterised by an intersection function:
+//
+//   Scalar intersect(const size_t slot, const Ray &ray);
+//
+// which returns the distance to the intersection of the primitive
+// indices[slot], or 0 if there is none. Passing the leaf slot rather
+// than the primitive index lets callers keep primitive data in leaf
+// order.
+class BVH {
+ public:
+  // A node in the flattened hierarchy. Interior nodes store their
+  // left child immediately after themselves, and the index of their
+  // right child in `offset'. Leaf nodes store the index of their
+  // first primitive in `offset' and a non-zero primitive `count'.
+  struct Node {
+    BoundingBox box;
+    uint32_t offset;
+    uint32_t count;
+
+    inline bool leaf() const { return count > 0; }
+  };
+
+  std::vector<Node> nodes;
+  std::vector<uint32_t> indices;
+
+  // The maximum number of primitives in a leaf.
+  static constexpr size_t maxLeafSize = 4;
+
+  // The maximum depth of the hierarchy, which bounds the traversal
+  // stack.
+  static constexpr size_t maxDepth = 64;
+
+  // Constructor. Build the hierarchy over the given boxes.
+  explicit BVH(const std::vector<BoundingBox> &boxes);
+
+  // Constructor. Use a previously built hierarchy, e.g. one read
+  // from a scene cache.
+  BVH(std::vector<Node> &&_nodes, std::vector<uint32_t> &&_indices)
+      : nodes(std::move(_nodes)), indices(std::move(_indices)) {}
+
+  // Return the number of primitives.
+  inline size_t size() const { return indices.size(); }
+
+  // Return the bounds of the whole hierarchy.
+  inline BoundingBox bounds() const {
+    return nodes.empty() ? BoundingBox() : nodes[0].box;
+  }
+
+  // Find the closest primitive intersected by ray which is nearer
+  // than `*t', updating `*t'. Returns the primitive's slot in
+  // `indices', or size() if none.
+  template<typename Intersect>
+  size_t closest(const Ray &ray, Scalar *const restrict t,
+                 Intersect intersect) const;
+
+  // Return whether any primitive is intersected by ray nearer than
+  // `distance'.
+  template<typename Intersect>
+  bool any(const Ray &ray, const Scalar distance,
+           Intersect intersect) const;
+
+  // Call visit(slot) for each primitive in a leaf whose box, grown by
+  // `margin', contains point p.
+  template<typename Visit>
+  void visit(const Scalar p[3], const Scalar margin, Visit visit) const;
+
+ private:
+  // Recursively build the subtree over indices [first, last).
+  void build(const std::vector<BoundingBox> &boxes,
+             const size_t first, const size_t last,
+             const size_t depth);
+};
+
+namespace bvh {
+
+// Compute the reciprocal direction of a ray, for slab tests.
+inline void invert(const Ray &ray, Scalar invDirection[3]) {
+  invDirection[0] = 1 / ray.direction.x;
+  invDirection[1] = 1 / ray.direction.y;
+  invDirection[2] = 1 / ray.direction.z;
+}
+
+}  // namespace bvh
+
+template<typename Intersect>
+size_t BVH::closest(const Ray &ray, Scalar *const restrict t,
+                    Intersect intersect) const {
+  size_t closest = size();
+  Scalar tbox;
+
+  if (nodes.empty())
+    return closest;
+
+  Scalar invDirection[3];
+  bvh::invert(ray, invDirection);
+
+  if (!nodes[0].box.intersect(ray, invDirection, *t, &tbox))
+    return closest;
+
+  // Traverse nearest child first, so that far children are culled
+  // by the closest intersection found so far.
+  uint32_t stack[maxDepth * 2];
+  size_t top = 0;
+  stack[top++] = 0;
+
+  while (top) {
+    const Node &node = nodes[stack[--top]];
+
+    // Re-test the box, since `*t' may have shrunk since the node
+    // was pushed.
+    if (!node.box.intersect(ray, invDirection, *t, &tbox))
+      continue;
+
+    if (node.leaf()) {
+      for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+        const Scalar currentT = intersect(i, ray);
+
+        if (currentT != 0 && currentT < *t) {
+          *t = currentT;
+          closest = i;
+        }
+      }
+    } else {
+      const uint32_t left = static_cast<uint32_t>(&node - &nodes[0]) + 1;
+      const uint32_t right = node.offset;
+      Scalar tleft, tright;
+      const bool hitLeft = nodes[left].box.intersect(
+          ray, invDirection, *t, &tleft);
+      const bool hitRight = nodes[right].box.intersect(
+          ray, invDirection, *t, &tright);
+
+      if (hitLeft && hitRight) {
+        // Push the far child first so the near child is popped next.
+        if (tleft < tright) {
+          stack[top++] = right;
+          stack[top++] = left;
+        } else {
+          stack[top++] = left;
+          stack[top++] = right;
+        }
+      } else if (hitLeft) {
+        stack[top++] = left;
+      } else if (hitRight) {
+        stack[top++] = right;
+      }
+    }
+  }
+
+  return closest;
+}
+
+template<typename Intersect>
+bool BVH::any(const Ray &ray, const Scalar distance,
+              Intersect intersect) const {
+  Scalar tbox;
+
+  if (nodes.empty())
+    return false;
+
+  Scalar invDirection[3];
+  bvh::invert(ray, invDirection);
+
+  uint32_t stack[maxDepth * 2];
+  size_t top = 0;
+  stack[top++] = 0;
+
+  while (top) {
+    const Node &node = nodes[stack[--top]];
+
+    if (!node.box.intersect(ray, invDirection, distance, &tbox))
+      continue;
+
+    if (node.leaf()) {
+      // Any intersection will do, so return on the first.
+      for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+        const Scalar t = intersect(i, ray);
+        if (t > 0 && t < distance)
+          return true;
+      }
+    } else {
+      stack[top++] = node.offset;
+      stack[top++] = static_cast<uint32_t>(&node - &nodes[0]) + 1;
+    }
+  }
+
+  return false;
+}
+
+template<typename Visit>
+void BVH::visit(const Scalar p[3], const Scalar margin,
+                Visit visit) const {
+  if (nodes.empty())
+    return;
+
+  const auto contains = [&](const BoundingBox &box) {
+    for (size_t i = 0; i < 3; i++)
+      if (p[i] < box.min[i] - margin || p[i] > box.max[i] + margin)
+        return false;
+    return true;
+  };
+
+  uint32_t stack[maxDepth * 2];
+  size_t top = 0;
+  stack[top++] = 0;
+
+  while (top) {
+    const Node &node = nodes[stack[--top]];
+
+    if (!contains(node.box))
+      continue;
+
+    if (node.leaf()) {
+      for (uint32_t i = node.offset; i < node.offset + node.count; i++)
+        visit(static_cast<size_t>(i));
+    } else {
+      stack[top++] = node.offset;
+      stack[top++] = static_cast<uint32_t>(&node - &nodes[0]) + 1;
+    }
+  }
+}
+
+}  // namespace rt
+
+#endif  // RT_BVH_H_
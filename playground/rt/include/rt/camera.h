@@ -20,8 +20,13 @@
 #ifndef RT_CAMERA_H_
 #define RT_CAMERA_H_
 
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
 #include "rt/math.h"
 #include "rt/random.h"
+#include "rt/ray.h"
 
 namespace rt {
 
@@ -31,7 +36,7 @@ class Lens {
  public:
   const Scalar focalLength;
   const Scalar focus;
-  mutable UniformDiskDistribution<Scalar> aperture;
+  const UniformDiskDistribution<Scalar> aperture;
 
   inline Lens(const Scalar _focalLength,
               const Scalar _aperture = 1,
@@ -71,6 +76,90 @@ class Camera {
         focusDistance((_position - _lookAt).size() * _lens.focus) {}
 };
 
+// Primary ray generation for a width x height image.
+//
+// The point on the film which an image position maps to is affine in
+// the image coordinates, so it is computed from per-column and
+// per-row increments. Lens samples are taken from a stratified table
+// which is shared by every pixel: sample i of n lies at radius
+// sqrt((i + 1/2) / n) of the aperture, and successive samples are
+// rotated by the golden angle. A single sample is at the centre of
+// the lens.
+class CameraRays {
+ public:
+  // The film position of image position [0,0], and the increments
+  // per image column and row.
+  const Vector origin;
+  const Vector column;
+  const Vector row;
+
+  const Vector filmBack;
+  const Scalar focusDistance;
+
+  // World space offsets of the lens samples.
+  const std::vector<Vector> lens;
+
+  // Constructor.
+  CameraRays(const Camera &camera, const size_t width,
+             const size_t height, const size_t samples);
+
+  // Return the point on the film of image position [x,y].
+  inline Vector film(const Scalar x, const Scalar y) const {
+    return origin + column * x + row * y;
+  }
+
+  // Return the point at which the rays through a film point are
+  // focused.
+  inline Vector focus(const Vector &film) const {
+    return filmBack + (film - filmBack).normalise() * focusDistance;
+  }
+
+  // Return the ray through a film point from the i-th lens sample.
+  inline Ray ray(const Vector &film, const Vector &focus,
+                 const size_t i) const {
+    const Vector position = film + lens[i];
+    return Ray(position, (focus - position).normalise());
+  }
+};
+
+// A camera keyframe: the position of the camera, and the point it
+// is looking at.
+struct Keyframe {
+  Vector position;
+  Vector lookAt;
+};
+
+// Return `frames' cameras along a path through a sequence of
+// keyframes, which is linearly interpolated between consecutive
+// keyframes. The first and last frames are the first and last
+// keyframes.
+inline std::vector<Camera> cameraPath(const std::vector<Keyframe> &keyframes,
+                                      const size_t frames,
+                                      const Scalar width,
+                                      const Scalar height,
+                                      const Lens &lens) {
+  std::vector<Camera> cameras;
+  cameras.reserve(frames);
+
+  for (size_t i = 0; i < frames && !keyframes.empty(); i++) {
+    // Position along the path, in keyframe intervals.
+    const Scalar t = frames > 1
+        ? static_cast<Scalar>(i) * (keyframes.size() - 1) / (frames - 1)
+        : 0;
+    const size_t k = std::min(static_cast<size_t>(t),
+                              keyframes.size() - 1);
+    const Keyframe &a = keyframes[k];
+    const Keyframe &b = keyframes[std::min(k + 1, keyframes.size() - 1)];
+    const Scalar f = t - k;
+
+    cameras.emplace_back(a.position * (1 - f) + b.position * f,
+                         a.lookAt * (1 - f) + b.lookAt * f,
+                         width, height, lens);
+  }
+
+  return cameras;
+}
+
 }  // namespace rt
 
 #endif  // RT_CAMERA_H_
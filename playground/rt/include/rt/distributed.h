@@ -0,0 +1,158 @@
+/* -*-c++-*-
+ *
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RT_DISTRIBUTED_H_
+#define RT_DISTRIBUTED_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "rt/graphics.h"
+#include "rt/image.h"
+#include "rt/math.h"
+#include "rt/profiling.h"
+#include "rt/renderer.h"
+
+// Distributed rendering. A coordinator splits an image into tiles,
+// and hands them out over a Unix domain socket to worker processes,
+// each of which has the same scene loaded. Tiles are rendered with
+// Renderer::renderTile(), so the assembled image is identical to one
+// rendered by a single process.
+namespace rt {
+
+// The cost of a distributed render.
+struct DistributedStats {
+  struct Worker {
+    // Tiles rendered, including duplicates of reissued tiles.
+    size_t tiles;
+    // Microseconds of wall clock time spent rendering tiles.
+    profiling::Counter busy;
+    // Whether the worker was still connected at the end.
+    bool alive;
+  };
+
+  // Seconds taken.
+  Scalar time;
+  // Number of tiles in the image.
+  size_t tiles;
+  // Number of tiles which were sent to a second worker.
+  size_t reissued;
+  std::vector<Worker> workers;
+
+  // Return the scaling efficiency: the time spent rendering tiles,
+  // as a fraction of the wall clock time of every worker. A worker
+  // which waits for tiles is not fully efficient. This is only a
+  // measure of scaling if the workers' threads do not outnumber the
+  // cores (see distributed::serve()).
+  Scalar efficiency() const;
+};
+
+// Distributes the tiles of an image among a set of workers.
+//
+// Each worker is kept busy with up to two tiles at a time, and is
+// sent the next tile as soon as it returns one, so faster workers
+// render more tiles. Once every tile has been handed out, idle
+// workers are sent duplicates of the outstanding tiles, so a slow
+// worker cannot delay the end of a frame. The first copy of a tile
+// to return is used. The tiles of workers which disconnect are
+// handed out again.
+class TileCoordinator {
+ public:
+  // Constructor. Listen on a Unix domain socket at `path', which is
+  // replaced if it exists, for `workers' workers. Workers must
+  // connect, and each message must arrive, within `timeout' seconds.
+  // Throws std::invalid_argument if tileSize is zero, and
+  // std::runtime_error on error.
+  TileCoordinator(const std::string &path, const size_t workers,
+                  const size_t tileSize = 64,
+                  const size_t timeout = 60);
+
+  // Destructor. Closes the connections, which stops the workers, and
+  // removes the socket.
+  ~TileCoordinator();
+
+  TileCoordinator(const TileCoordinator &) = delete;
+  TileCoordinator &operator=(const TileCoordinator &) = delete;
+
+  // Render a width x height image, setting `pixels' to its colours
+  // in row order. The first render waits for every worker to
+  // connect; incompatible workers are turned away. Throws
+  // std::runtime_error if the workers do not connect in time, or if
+  // every worker disconnects.
+  DistributedStats render(std::vector<Colour> *const pixels,
+                          const size_t width,
+                          const size_t height);
+
+  // Render an image.
+  template<typename Image>
+  DistributedStats render(Image *const image) {
+    std::vector<Colour> pixels;
+    const DistributedStats stats = render(&pixels, image->width,
+                                          image->height);
+
+    for (size_t y = 0; y < image->height; y++)
+      for (size_t x = 0; x < image->width; x++)
+        image->set(x, y, pixels[image::index(x, y, image->width)]);
+
+    return stats;
+  }
+
+  const std::string path;
+  const size_t numWorkers;
+  const size_t tileSize;
+  const size_t timeout;
+
+ private:
+  // A worker connection, and the IDs of the tiles it has been sent
+  // but has not yet returned.
+  struct Connection {
+    int fd;
+    std::vector<uint32_t> inflight;
+  };
+
+  int listener;
+  std::vector<Connection> connections;
+  // Tile IDs are unique across frames, so that late duplicates of a
+  // previous frame's tiles can be recognised.
+  uint32_t nextId;
+
+  // Wait for compatible workers to connect.
+  void accept();
+
+  // Close a connection.
+  void disconnect(Connection *const connection);
+};
+
+namespace distributed {
+
+// Connect to the coordinator listening at `path', and render the
+// tiles it sends until it closes the connection. Tiles are rendered
+// with at most `threads' threads, or as many as there are cores if
+// zero, so that workers which share a host need not oversubscribe
+// it. Throws std::runtime_error if the coordinator cannot be reached.
+void serve(const std::string &path, const Renderer &renderer,
+           const size_t threads = 0);
+
+}  // namespace distributed
+
+}  // namespace rt
+
+#endif  // RT_DISTRIBUTED_H_
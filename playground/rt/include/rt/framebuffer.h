@@ -0,0 +1,68 @@
+/* -*-c++-*-
+ *
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RT_FRAMEBUFFER_H_
+#define RT_FRAMEBUFFER_H_
+
+#include <cstddef>
+#include <string>
+
+#include "rt/graphics.h"
+
+namespace rt {
+
+static_assert(sizeof(Pixel) == 3,
+              "Pixel data must be packed 8 bit RGB triplets");
+
+// A binary (P6) PPM image file which is memory mapped for output.
+// The header is written once on construction, and pixel data can
+// then be written to the mapped region repeatedly, e.g. to stream
+// successive passes of a progressive render to a viewer which
+// re-reads the file. Errors throw std::runtime_error.
+class MappedFramebuffer {
+ public:
+  const std::string path;
+  const size_t width;
+  const size_t height;
+
+  MappedFramebuffer(const std::string &_path,
+                    const size_t _width,
+                    const size_t _height);
+
+  ~MappedFramebuffer();
+
+  MappedFramebuffer(const MappedFramebuffer&) = delete;
+  MappedFramebuffer& operator=(const MappedFramebuffer&) = delete;
+
+  // Copy width * height pixels into the mapped file.
+  void write(const Pixel *const data);
+
+  // Flush the mapped file to disk. Blocks until written.
+  void sync();
+
+ private:
+  int fd;
+  size_t headerSize;
+  size_t fileSize;
+  char *map;
+};
+
+}  // namespace rt
+
+#endif  // RT_FRAMEBUFFER_H_
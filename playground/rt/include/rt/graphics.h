@@ -142,7 +142,7 @@ class Colour {
   // Return the sum difference between the r,g,b colour
   // components.
   auto inline diff(const Colour &rhs) const {
-    return fabs(rhs.r - r) + fabs(rhs.g - g) + fabs(rhs.b - b);
+    return std::abs(rhs.r - r) + std::abs(rhs.g - g) + std::abs(rhs.b - b);
   }
 };
 
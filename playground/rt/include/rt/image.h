@@ -21,7 +21,10 @@
 #define RT_IMAGE_H_
 
 #include <array>
+#include <cstdlib>
 #include <limits>
+#include <new>
+#include <string>
 #include <vector>
 
 #include "rt/graphics.h"
@@ -49,6 +52,75 @@ inline T y(const T& index, const T& width) {
   return index / width;
 }
 
+// Apply gamma correction to a colour, where `gamma' holds the
+// reciprocal gamma of each component.
+inline Colour correct(const Colour &value, const Colour &gamma) {
+  return Colour(std::pow(value.r, gamma.r),
+                std::pow(value.g, gamma.g),
+                std::pow(value.b, gamma.b));
+}
+
+// An allocator for memory aligned to `alignment' bytes, e.g. to
+// cache lines or vector registers.
+template<typename T, size_t alignment = 64>
+class AlignedAllocator {
+ public:
+  using value_type = T;
+
+  template<typename U>
+  struct rebind {
+    using other = AlignedAllocator<U, alignment>;
+  };
+
+  AlignedAllocator() {}
+
+  template<typename U>
+  AlignedAllocator(const AlignedAllocator<U, alignment>&) {}
+
+  T *allocate(const size_t n) {
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, alignment, n * sizeof(T)))
+      throw std::bad_alloc();
+    return static_cast<T *>(ptr);
+  }
+
+  void deallocate(T *const ptr, const size_t) {
+    free(ptr);
+  }
+
+  template<typename U>
+  bool operator==(const AlignedAllocator<U, alignment>&) const {
+    return true;
+  }
+
+  template<typename U>
+  bool operator!=(const AlignedAllocator<U, alignment>&) const {
+    return false;
+  }
+};
+
+// Write width x height pixels as a binary (P6) PPM file, using a
+// single write. Throws std::runtime_error on failure.
+void writeP6(const std::string &path,
+             const size_t width,
+             const size_t height,
+             const Pixel *const data);
+
+// Write width x height RGB floats as a PFM file, gathering the rows
+// into as few writes as possible. PFM rows are stored from the bottom
+// up, so `data' is written in reverse row order. Throws
+// std::runtime_error on failure.
+void writePFM(const std::string &path,
+              const size_t width,
+              const size_t height,
+              const float *const data);
+
+// Write an image as a binary PPM file.
+template<typename Image>
+void writeP6(const std::string &path, const Image &image) {
+  writeP6(path, image.width, image.height, image.data.data());
+}
+
 }  // namespace image
 
 // A rendered image.
@@ -153,9 +225,7 @@ template<size_t width, size_t height>
 void Image<width, height>::_set(const size_t i,
                                 const Colour &value) {
   // Apply gamma correction.
-  Colour corrected = Colour(std::pow(value.r, gamma.r),
-                            std::pow(value.g, gamma.g),
-                            std::pow(value.b, gamma.b));
+  Colour corrected = image::correct(value, gamma);
 
   // TODO: Fix strange aliasing effect as a result of
   // RGB -> HSL -> RGB conversion.
@@ -171,6 +241,60 @@ void Image<width, height>::_set(const size_t i,
   data[i] = static_cast<Pixel>(corrected);
 }
 
+// A rendered image, with dimensions set at runtime. Pixel data is
+// stored contiguously on the heap, aligned to cache lines. If `hdr'
+// is set, the gamma corrected colour of each pixel is also stored as
+// RGB floats, before it is quantised.
+class DynamicImage {
+ public:
+  const size_t width;
+  const size_t height;
+  const size_t size;
+  const Scalar saturation;
+  const Colour gamma;
+  const bool inverted;
+  std::vector<Pixel, image::AlignedAllocator<Pixel>> data;
+  std::vector<float, image::AlignedAllocator<float>> hdr;
+
+  DynamicImage(const size_t _width,
+               const size_t _height,
+               const Scalar _saturation = 1,
+               const Colour _gamma = Colour(1, 1, 1),
+               const bool _inverted = true,
+               const bool _hdr = false)
+      : width(_width),
+        height(_height),
+        size(_width * _height),
+        saturation(_saturation),
+        gamma(1 / _gamma.r, 1 / _gamma.g, 1 / _gamma.b),
+        inverted(_inverted),
+        data(size),
+        hdr(_hdr ? 3 * size : 0) {}
+
+  // [x,y] = value
+  inline void set(const size_t x,
+                  const size_t y,
+                  const Colour &value) {
+    // Apply Y axis inversion if needed.
+    const size_t row = inverted ? height - 1 - y : y;
+    const size_t i = image::index(x, row, width);
+    const Colour corrected = image::correct(value, gamma);
+
+    data[i] = static_cast<Pixel>(corrected);
+    if (!hdr.empty()) {
+      hdr[3 * i]     = static_cast<float>(corrected.r);
+      hdr[3 * i + 1] = static_cast<float>(corrected.g);
+      hdr[3 * i + 2] = static_cast<float>(corrected.b);
+    }
+  }
+
+  // [index] = value
+  inline void set(const size_t index,
+                  const Colour &value) {
+    set(image::x(index, width), image::y(index, width), value);
+  }
+};
+
 }  // namespace rt
 
 #endif  // RT_IMAGE_H_
@@ -35,37 +35,67 @@ namespace rt {
 // Base class light source.
 class Light {
  public:
+  // The light's index in the scene which holds it, which indexes
+  // per-thread caches. Set by Scene.
+  size_t id = 0;
+
   // Virtual destructor.
   virtual ~Light() {}
 
   // Calculate the shading colour at `point' for a given surface
-  // material, surface normal, and direction to the ray.
+  // material, surface normal, and direction to the ray. Any random
+  // sampling draws from `rng'.
   virtual Colour shade(const Vector &point,
                        const Vector &normal,
                        const Vector &toRay,
                        const Material *const restrict material,
-                       const Objects objects) const = 0;
+                       const ObjectIndex &objects,
+                       RandomStream &rng) const = 0;
 };
 
 using Lights = const std::vector<Light *>;
 
 // A round light source.
+//
+// Shadows are sampled by casting rays to random points within the
+// light. A light may be adaptive: it first casts a small batch of
+// stratified rays, and only casts the remainder of its samples if
+// the variance of the batch's visibility exceeds a threshold. Points
+// which are fully lit or fully in shadow then cost only the first
+// batch.
 class SoftLight : public Light {
  public:
   const Vector position;
   const Colour colour;
+  const Scalar radius;
   const size_t samples;
-  mutable UniformDistribution<Scalar> sampler;
+  const UniformDistribution<Scalar> sampler;
+
+  // The number of strata along each axis of the first batch of an
+  // adaptive light, which casts strata^3 rays. Zero if the light is
+  // not adaptive.
+  const size_t strata;
+
+  // The visibility variance above which an adaptive light casts the
+  // remainder of its samples.
+  const Scalar threshold;
 
-  // Constructor.
+  // Constructor. If `_minSamples' is non-zero, the light is
+  // adaptive, with a first batch of the largest cube number of rays
+  // no greater than `_minSamples'.
   inline SoftLight(const Vector &_position,
                    const Colour &_colour = Colour(0xff, 0xff, 0xff),
                    const Scalar _radius = 0,
-                   const size_t _samples = 1)
+                   const size_t _samples = 1,
+                   const size_t _minSamples = 0,
+                   const Scalar _threshold = 0)
       : position(_position),
         colour(_colour),
+        radius(_radius),
         samples(_samples),
-        sampler(-_radius, _radius) {
+        sampler(-_radius, _radius),
+        strata(stratify(_samples, _minSamples)),
+        threshold(_threshold) {
     // Register lights with profiling counter.
     profiling::counters::incLightsCount(_samples);
   }
@@ -74,7 +104,28 @@ class SoftLight : public Light {
                        const Vector &normal,
                        const Vector &toRay,
                        const Material *const restrict material,
-                       const Objects objects) const;
+                       const ObjectIndex &objects,
+                       RandomStream &rng) const;
+
+ private:
+  // Return the strata per axis for a first batch of at most
+  // `minSamples' rays, or zero if the batch would not be smaller
+  // than `samples'.
+  static size_t stratify(const size_t samples, const size_t minSamples);
+
+  // Cast a shadow ray from point to origin, adding the shading to
+  // `output' if unblocked. The object `*occluder' is tested first,
+  // and updated if another blocks the ray. Returns whether the light
+  // is visible.
+  bool cast(const Vector &origin,
+            const Vector &point,
+            const Vector &normal,
+            const Vector &toRay,
+            const Material *const restrict material,
+            const ObjectIndex &objects,
+            const Colour &illumination,
+            size_t *const restrict occluder,
+            Colour *const restrict output) const;
 };
 
 }  // namespace rt
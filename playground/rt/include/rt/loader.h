@@ -0,0 +1,176 @@
+/* -*-c++-*-
+ *
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RT_LOADER_H_
+#define RT_LOADER_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rt/bvh.h"
+#include "rt/camera.h"
+#include "rt/graphics.h"
+#include "rt/image.h"
+#include "rt/objects.h"
+#include "rt/renderer.h"
+#include "rt/scene.h"
+
+namespace rt {
+
+// A scene description, as read from a .rt scene file. Records are
+// plain data, so that descriptions can be cached in binary form.
+class SceneDescription {
+ public:
+  struct MaterialRecord {
+    Scalar colour[3];
+    Scalar ambient;
+    Scalar diffuse;
+    Scalar specular;
+    Scalar shininess;
+    Scalar reflectivity;
+  };
+
+  enum ObjectType : uint32_t {
+    plane,
+    checkerboard,
+    sphere
+  };
+
+  // Objects refer to materials by index. Only checkerboards use the
+  // second material. The size is the checker width of checkerboards,
+  // or the radius of spheres.
+  struct ObjectRecord {
+    uint32_t type;
+    uint32_t material1;
+    uint32_t material2;
+    Scalar position[3];
+    Scalar direction[3];
+    Scalar size;
+  };
+
+  // Adaptive lights have a non-zero minimum number of samples. See
+  // SoftLight.
+  struct LightRecord {
+    Scalar position[3];
+    Scalar colour[3];
+    Scalar radius;
+    Scalar threshold;
+    uint64_t samples;
+    uint64_t minSamples;
+  };
+
+  struct CameraRecord {
+    Scalar position[3];
+    Scalar lookAt[3];
+    Scalar width;
+    Scalar height;
+    Scalar focalLength;
+    Scalar aperture;
+    Scalar focus;
+  };
+
+  // Renderer and output image configuration.
+  struct SettingsRecord {
+    uint64_t rayDepth;
+    uint64_t dofSamples;
+    Scalar minRayWeight;
+    Scalar rouletteWeight;
+    uint64_t width;
+    uint64_t height;
+    Scalar saturation;
+    Scalar gamma[3];
+  };
+
+  // A file read by the parse, with the size and a hash of the
+  // contents which were read.
+  struct Source {
+    std::string path;
+    uint64_t size;
+    uint64_t hash;
+  };
+
+  std::vector<MaterialRecord> materials;
+  std::vector<ObjectRecord> objects;
+  std::vector<LightRecord> lights;
+  CameraRecord camera;
+  SettingsRecord settings;
+  // The path of the rendered image.
+  std::string path;
+  // The scene file, followed by each file that it imports.
+  std::vector<Source> sources;
+};
+
+// A scene built from a description, which owns everything which it
+// allocates.
+class LoadedScene {
+ public:
+  const SceneDescription description;
+  const std::vector<std::unique_ptr<Material>> materials;
+  const std::unique_ptr<Camera> camera;
+  const std::unique_ptr<Scene> scene;
+
+  // Constructor. Build the scene and its BVH.
+  explicit LoadedScene(const SceneDescription &_description);
+
+  // Constructor. Build the scene using a previously built BVH.
+  LoadedScene(const SceneDescription &_description, BVH &&bvh);
+
+  // Return a renderer for the scene.
+  std::unique_ptr<Renderer> renderer() const;
+
+  // Return an output image of the configured size, saturation and
+  // gamma.
+  std::unique_ptr<DynamicImage> image() const;
+};
+
+namespace scene {
+
+// Parse a .rt scene file. The format consists of [Section] headers
+// followed by "Key: value" pairs, with "#" comments, "@def name value"
+// macros, and "@import path" directives, which are resolved relative
+// to the importing file. Throws std::runtime_error on error, giving
+// the file and line.
+SceneDescription parse(const std::string &path);
+
+// Write a scene description and the BVH built for it to a binary
+// cache file. Throws std::runtime_error on error.
+void writeCache(const std::string &path,
+                const SceneDescription &description,
+                const BVH &bvh);
+
+// Read a scene from a cache file, which is memory mapped. Throws
+// std::runtime_error if the file cannot be read, was written by an
+// incompatible build (e.g. of a different precision), or is stale:
+// that is, if any of the scene's source files has changed since it
+// was parsed.
+std::unique_ptr<LoadedScene> readCache(const std::string &path);
+
+// Load a .rt scene file. If cachePath is given, the scene is read
+// from the cache if it is up to date, else the scene file is parsed
+// and the cache is rewritten.
+std::unique_ptr<LoadedScene> load(const std::string &path,
+                                  const std::string &cachePath = "");
+
+}  // namespace scene
+
+}  // namespace rt
+
+#endif  // RT_LOADER_H_
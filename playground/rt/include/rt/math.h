@@ -21,6 +21,7 @@
 #define RT_MATH_H_
 
 #include <cmath>
+#include <limits>
 
 namespace rt {
 
@@ -32,17 +33,44 @@ namespace rt {
  */
 
 // Changing between different floating point sizes for scalar values
-// will affect the system's performance.
+// will affect the system's performance. Scalars are double precision,
+// unless RT_SINGLE_PRECISION is defined.
+#ifdef RT_SINGLE_PRECISION
+using Scalar = float;
+#else  // RT_SINGLE_PRECISION
 using Scalar = double;
+#endif  // RT_SINGLE_PRECISION
 
-// The "rounding error" to accomodate for when approximate infinite
-// precision real numbers.
-static const Scalar ScalarPrecision = 1e-6;
+// Precision dependent constants.
+template<typename T>
+class ScalarTraits;
+
+template<>
+class ScalarTraits<double> {
+ public:
+  // The "rounding error" to accomodate for when approximate
+  // infinite precision real numbers.
+  static constexpr double precision = 1e-6;
+};
+
+template<>
+class ScalarTraits<float> {
+ public:
+  // Single precision has ~7 significant digits, so with scene
+  // coordinates in the thousands the rounding error of an
+  // intersection distance is of the order 1e-3.
+  static constexpr float precision = 1e-2f;
+};
+
+static const Scalar ScalarPrecision = ScalarTraits<Scalar>::precision;
+
+// An infinite distance.
+static const Scalar ScalarInfinity = std::numeric_limits<Scalar>::infinity();
 
 namespace radians {
 // Conversion from radians to degrees.
 auto inline toDegrees(const Scalar radians) {
-  return radians * M_PI / 180.0;
+  return radians * static_cast<Scalar>(M_PI / 180.0);
 }
 }  // namespace radians
 
@@ -50,18 +78,13 @@ namespace deg {
 // Trigonometric functions accepting theta angles in degrees
 // rather than radians:
 
-// Ignore recursion warning from deg::sin() clashing with cmath's
-// sin():
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Winfinite-recursion"
 Scalar inline sin(const Scalar theta) {
-  return sin(radians::toDegrees(theta));
+  return std::sin(radians::toDegrees(theta));
 }
 
 Scalar inline cos(const Scalar theta) {
-  return cos(radians::toDegrees(theta));
+  return std::cos(radians::toDegrees(theta));
 }
-#pragma GCC diagnostic pop
 
 }  // namespace deg
 
@@ -138,7 +161,7 @@ class Vector {
 
   // Length of vector: |A| = sqrt(x^2 + y^2 + z^2)
   auto inline size() const {
-    return sqrt(x * x + y * y + z * z);
+    return std::sqrt(x * x + y * y + z * z);
   }
 
   // Product of components: x * y * z
@@ -20,8 +20,13 @@
 #ifndef OBJECTS_H_
 #define OBJECTS_H_
 
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
 #include <vector>
 
+#include "rt/bvh.h"
 #include "rt/graphics.h"
 #include "rt/math.h"
 #include "rt/profiling.h"
@@ -77,10 +82,211 @@ namespace rt {
     virtual Scalar intersect(const Ray &ray) const = 0;
     // Return material at point on surface.
     virtual const Material *surface(const Vector &point) const = 0;
+    // Return whether the object has a finite extent, and if so, set
+    // `box' to its bounds. Unbounded objects are never placed in a
+    // BVH.
+    virtual bool bounds(BoundingBox *const restrict box) const {
+      return false;
+    }
   };
 
   using Objects = const std::vector<Object *>;
 
+  // Ray intersection kernels, shared by the object classes and the
+  // typed geometry of ObjectIndex so that both give identical
+  // results. Return the distance to the intersection, or 0 if none.
+
+  // A sphere at (x,y,z) with squared radius r2.
+  inline Scalar intersectSphere(const Scalar x, const Scalar y,
+                                const Scalar z, const Scalar r2,
+                                const Ray &ray) {
+    const Scalar distx = x - ray.position.x;
+    const Scalar disty = y - ray.position.y;
+    const Scalar distz = z - ray.position.z;
+    const Scalar b = ray.direction.x * distx + ray.direction.y * disty
+                     + ray.direction.z * distz;
+    const Scalar d = b * b + r2
+                     - (distx * distx + disty * disty + distz * distz);
+
+    if (d < 0)
+      return 0;
+
+    const Scalar t0 = b - std::sqrt(d);
+    const Scalar t1 = b + std::sqrt(d);
+
+    if (t0 > ScalarPrecision)
+      return t0;
+    else if (t1 > ScalarPrecision)
+      return t1;
+    else
+      return 0;
+  }
+
+  // A plane through (x,y,z) with unit normal (nx,ny,nz).
+  inline Scalar intersectPlane(const Scalar x, const Scalar y,
+                               const Scalar z, const Scalar nx,
+                               const Scalar ny, const Scalar nz,
+                               const Ray &ray) {
+    const Scalar f = (x - ray.position.x) * nx
+                     + (y - ray.position.y) * ny
+                     + (z - ray.position.z) * nz;
+    const Scalar g = ray.direction.x * nx + ray.direction.y * ny
+                     + ray.direction.z * nz;
+    const Scalar t = f / g;
+
+    // Accommodate for precision errors.
+    const Scalar t0 = t - ScalarPrecision / 2;
+    const Scalar t1 = t + ScalarPrecision / 2;
+
+    if (t0 > ScalarPrecision)
+      return t0;
+    else if (t1 > ScalarPrecision)
+      return t1;
+    else
+      return 0;
+  }
+
+  // A triangle with vertices a, b and c (Moller-Trumbore).
+  inline Scalar intersectTriangle(const Scalar *const restrict a,
+                                  const Scalar *const restrict b,
+                                  const Scalar *const restrict c,
+                                  const Ray &ray) {
+    const Scalar e1x = b[0] - a[0], e1y = b[1] - a[1], e1z = b[2] - a[2];
+    const Scalar e2x = c[0] - a[0], e2y = c[1] - a[1], e2z = c[2] - a[2];
+    const Vector &d = ray.direction;
+
+    // Determinant of the system, which is 0 if the ray is parallel
+    // to the triangle.
+    const Scalar px = d.y * e2z - d.z * e2y;
+    const Scalar py = d.z * e2x - d.x * e2z;
+    const Scalar pz = d.x * e2y - d.y * e2x;
+    const Scalar det = e1x * px + e1y * py + e1z * pz;
+    if (det == 0)
+      return 0;
+    const Scalar inv = 1 / det;
+
+    // Barycentric coordinates of the intersection.
+    const Scalar sx = ray.position.x - a[0];
+    const Scalar sy = ray.position.y - a[1];
+    const Scalar sz = ray.position.z - a[2];
+    const Scalar u = (sx * px + sy * py + sz * pz) * inv;
+    if (u < 0 || u > 1)
+      return 0;
+
+    const Scalar qx = sy * e1z - sz * e1y;
+    const Scalar qy = sz * e1x - sx * e1z;
+    const Scalar qz = sx * e1y - sy * e1x;
+    const Scalar v = (d.x * qx + d.y * qy + d.z * qz) * inv;
+    if (v < 0 || u + v > 1)
+      return 0;
+
+    const Scalar t = (e2x * qx + e2y * qy + e2z * qz) * inv;
+    return t > ScalarPrecision ? t : 0;
+  }
+
+  // The closest intersections of a packet of rays.
+  class PacketHit {
+  public:
+    Scalar t[packetSize];
+    const Object *object[packetSize];
+  };
+
+  // An acceleration structure for ray queries over a set of
+  // objects. Bounded objects are stored in a BVH, and unbounded
+  // objects (e.g. planes) in a separate list which is tested
+  // linearly.
+  //
+  // With typed storage, the geometry of spheres and planes is also
+  // copied into contiguous per-type arrays, which the intersection
+  // loops test directly, without a pointer chase and virtual call
+  // per object. Other objects, including subclasses which may
+  // override intersect(), are tested through the Object interface.
+  // Without typed storage, every object is tested through the Object
+  // interface.
+  class ObjectIndex {
+  public:
+    // Constructor. Build the index over the given objects.
+    explicit ObjectIndex(const Objects &objects, const bool typed = true);
+
+    // Constructor. Use a previously built BVH over the bounded
+    // objects, in the order in which they appear in `objects'.
+    // Throws std::invalid_argument if the BVH does not match.
+    ObjectIndex(const Objects &objects, BVH &&bvh,
+                const bool typed = true);
+
+    // Return the object with the closest intersection to ray, and
+    // set the distance to the intersection `t'. If no intersection,
+    // returns a nullptr.
+    const Object *closestIntersect(const Ray &ray,
+                                   Scalar *const restrict t) const;
+
+    // Find the closest intersection of every ray in a packet. Rays
+    // which intersect nothing have a nullptr object.
+    void closestIntersect(const RayPacket &packet,
+                          PacketHit *const restrict hit) const;
+
+    // Return whether a given ray intersects any of the objects
+    // within a given distance.
+    bool intersects(const Ray &ray, const Scalar distance) const;
+
+    // As above, but first test the object `*occluder', and set
+    // `*occluder' to the object which blocks the ray, or noOccluder
+    // if none does. Shadow rays from nearby points are usually
+    // blocked by the same object, so passing the last occluder back
+    // in usually answers a query with a single intersection test.
+    // Objects are numbered by BVH slot, followed by the unbounded
+    // objects. Other values, such as noOccluder, are ignored.
+    bool intersects(const Ray &ray, const Scalar distance,
+                    size_t *const restrict occluder) const;
+
+    static constexpr size_t noOccluder = ~static_cast<size_t>(0);
+
+    // Return the BVH over the bounded objects.
+    inline const BVH &hierarchy() const { return bvh; }
+
+    // Objects stored in the BVH, and those which are tested linearly.
+    const std::vector<const Object *> bounded;
+    const std::vector<const Object *> unbounded;
+
+    // Whether the typed geometry is used by closestIntersect() and
+    // intersects(). Packet tracing always uses it.
+    const bool typed;
+
+    // Typed copies of the sphere and plane geometry. Spheres are
+    // stored in BVH leaf order, and planes in the order of the
+    // unbounded list. Objects which are neither have a negative
+    // squared radius or a zero normal.
+    class Packed {
+    public:
+      struct Sphere {
+        Scalar x, y, z, r2;
+      };
+
+      struct Plane {
+        Scalar x, y, z, nx, ny, nz;
+      };
+
+      std::vector<Sphere> spheres;
+      std::vector<Plane> planes;
+    };
+
+  private:
+    const BVH bvh;
+    const Packed packed;
+
+    // Build the packed geometry.
+    static Packed pack(const std::vector<const Object *> &bounded,
+                       const std::vector<const Object *> &unbounded,
+                       const BVH &bvh);
+
+    // Intersect the bounded object in a BVH leaf slot, or the i-th
+    // unbounded object.
+    inline Scalar intersectBounded(const size_t slot,
+                                   const Ray &ray) const;
+    inline Scalar intersectUnbounded(const size_t i,
+                                     const Ray &ray) const;
+  };
+
   // A plane.
   class Plane : public Object {
   public:
@@ -100,21 +306,8 @@ namespace rt {
     }
 
     virtual inline Scalar intersect(const Ray &ray) const {
-      // Calculate intersection of line and plane.
-      const Scalar f = (position - ray.position) ^ direction;
-      const Scalar g = ray.direction ^ direction;
-      const Scalar t = f / g;
-
-      // Accommodate for precision errors.
-      const Scalar t0 = t - ScalarPrecision / 2;
-      const Scalar t1 = t + ScalarPrecision / 2;
-
-      if (t0 > ScalarPrecision)
-        return t0;
-      else if (t1 > ScalarPrecision)
-        return t1;
-      else
-        return 0;
+      return intersectPlane(position.x, position.y, position.z,
+                            direction.x, direction.y, direction.z, ray);
     }
 
     virtual inline const Material *surface(const Vector &point) const {
@@ -176,30 +369,116 @@ namespace rt {
     }
 
     virtual inline Scalar intersect(const Ray &ray) const {
-      // Calculate intersection of line and sphere.
-      const Vector distance = position - ray.position;
-      const Scalar b = ray.direction ^ distance;
-      const Scalar d = b * b + radius * radius - (distance ^ distance);
-
-      if (d < 0)
-        return 0;
+      return intersectSphere(position.x, position.y, position.z,
+                             radius * radius, ray);
+    }
 
-      const Scalar t0 = b - sqrt(d);
-      const Scalar t1 = b + sqrt(d);
+    virtual inline const Material *surface(const Vector &point) const {
+      return material;
+    }
 
-      if (t0 > ScalarPrecision)
-        return t0;
-      else if (t1 > ScalarPrecision)
-        return t1;
-      else
-        return 0;
+    virtual inline bool bounds(BoundingBox *const restrict box) const {
+      const Vector extent(radius, radius, radius);
+      *box = BoundingBox(position - extent, position + extent);
+      return true;
     }
+  };
+
+  // A triangle mesh, which is a single object however many triangles
+  // it has. Triangles index a shared vertex buffer, and are
+  // intersected through the mesh's own BVH. Triangles are stored in
+  // the BVH's leaf order. Shading normals are interpolated from
+  // per-vertex normals, which are the area weighted mean of the
+  // normals of the adjacent triangles.
+  class Mesh : public Object {
+  public:
+    // Vertex positions, as x,y,z triples.
+    const std::vector<Scalar> vertices;
+    // Vertex indices, three per triangle.
+    const std::vector<uint32_t> triangles;
+    // Vertex normals, as x,y,z triples.
+    const std::vector<Scalar> normals;
+    const Material *const restrict material;
+
+    // Constructor. Throws std::invalid_argument if the triangles do
+    // not index the vertices.
+    Mesh(std::vector<Scalar> &&vertices,
+         std::vector<uint32_t> &&triangles,
+         const Material *const restrict material);
+
+    // Return the number of triangles.
+    inline size_t size() const { return triangles.size() / 3; }
+
+    virtual Vector normal(const Vector &p) const;
+
+    virtual Scalar intersect(const Ray &ray) const;
 
     virtual inline const Material *surface(const Vector &point) const {
       return material;
     }
+
+    virtual inline bool bounds(BoundingBox *const restrict box) const {
+      *box = bvh.bounds();
+      return true;
+    }
+
+  private:
+    const BVH bvh;
+
+    Mesh(std::vector<Scalar> &&vertices,
+         std::vector<uint32_t> &&triangles,
+         const Material *const restrict material,
+         BVH &&bvh);
+
+    // Build the hierarchy over a mesh's triangles.
+    static BVH hierarchy(const std::vector<Scalar> &vertices,
+                         const std::vector<uint32_t> &triangles);
+
+    // Intersect the i-th triangle.
+    inline Scalar intersectTriangle(const size_t i, const Ray &ray) const {
+      const uint32_t *const t = &triangles[3 * i];
+      return rt::intersectTriangle(&vertices[3 * t[0]],
+                                   &vertices[3 * t[1]],
+                                   &vertices[3 * t[2]], ray);
+    }
   };
 
+  namespace obj {
+
+  // Read a Wavefront OBJ mesh from a stream, one line at a time,
+  // scaling its vertices by `scale' and then translating them by
+  // `offset'. Only vertex positions and faces are read, and polygons
+  // are split into triangle fans. Throws std::runtime_error if the
+  // input is malformed.
+  std::unique_ptr<Mesh> read(std::istream &in,
+                             const Material *const restrict material,
+                             const Vector &offset = Vector(0, 0, 0),
+                             const Scalar scale = 1);
+
+  // Read a Wavefront OBJ mesh from a file.
+  std::unique_ptr<Mesh> load(const std::string &path,
+                             const Material *const restrict material,
+                             const Vector &offset = Vector(0, 0, 0),
+                             const Scalar scale = 1);
+
+  }  // namespace obj
+
+  inline Scalar ObjectIndex::intersectBounded(const size_t slot,
+                                              const Ray &ray) const {
+    const Packed::Sphere &s = packed.spheres[slot];
+    if (typed && s.r2 >= 0)
+      return intersectSphere(s.x, s.y, s.z, s.r2, ray);
+    return bounded[bvh.indices[slot]]->intersect(ray);
+  }
+
+  inline Scalar ObjectIndex::intersectUnbounded(const size_t i,
+                                                const Ray &ray) const {
+    const Packed::Plane &p = packed.planes[i];
+    if (typed && (p.nx != 0 || p.ny != 0 || p.nz != 0))
+      return intersectPlane(p.x, p.y, p.z, p.nx, p.ny, p.nz, ray);
+    return unbounded[i]->intersect(ray);
+  }
+
 }  // namespace rt
 
 #endif  // OBJECTS_H_
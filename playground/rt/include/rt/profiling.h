@@ -22,6 +22,7 @@
 
 #include <atomic>
 #include <chrono>
+#include <ostream>
 
 #include "rt/math.h"
 
@@ -29,13 +30,16 @@ namespace rt {
 
 namespace profiling {
 
+// Counter data type.
+using Counter = uint64_t;
+
 // A profiling timer.
 class Timer {
  public:
   // Create and start timer.
   inline Timer() : start(std::chrono::high_resolution_clock::now()) {}
 
-  // Return the number of milliseconds.
+  // Return the number of seconds.
   auto inline elapsed() {
     const std::chrono::high_resolution_clock::time_point end =
         std::chrono::high_resolution_clock::now();
@@ -44,13 +48,23 @@ class Timer {
             end - start).count() / 1e6);
   }
 
+  // Return the number of microseconds.
+  inline Counter microseconds() const {
+    const std::chrono::high_resolution_clock::time_point end =
+        std::chrono::high_resolution_clock::now();
+    return static_cast<Counter>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            end - start).count());
+  }
+
  private:
   const std::chrono::high_resolution_clock::time_point start;
 };
 
-// Counter data type.
-using Counter = uint64_t;
-
+// Counters are kept separately by each thread, so incrementing a
+// counter does not contend with other threads. Reading a counter
+// merges the values of every thread, so should be done once a frame
+// is finished.
 namespace counters {
 
 // Counter for the number of objects.
@@ -69,8 +83,73 @@ Counter getTraceCount();
 void incRayCount(const size_t n = 1);
 Counter getRayCount();
 
+// Counter for the number of ray-object intersection tests. Packet
+// tests count every ray of the packet.
+void incIntersectionCount(const size_t n = 1);
+Counter getIntersectionCount();
+
+// Counters for the number of shadow rays which hit an occluder, and
+// which miss (reaching the light).
+void incShadowHitCount(const size_t n = 1);
+Counter getShadowHitCount();
+void incShadowMissCount(const size_t n = 1);
+Counter getShadowMissCount();
+
+// Counter for the number of points shaded by a soft light, and for
+// those at which an adaptive light's first batch of shadow rays
+// disagreed, so that the remainder of its samples were cast.
+void incShadowPointCount(const size_t n = 1);
+Counter getShadowPointCount();
+void incPenumbraCount(const size_t n = 1);
+Counter getPenumbraCount();
+
+// Counters for the number of shadow rays which were blocked by the
+// last occluder of their light, and which were not, so had to search
+// for another.
+void incOccluderHitCount(const size_t n = 1);
+Counter getOccluderHitCount();
+void incOccluderMissCount(const size_t n = 1);
+Counter getOccluderMissCount();
+
+// Record the time taken to render a tile.
+void addTileTime(const Counter microseconds);
+Counter getTileCount();
+Counter getTileTime();
+Counter getMaxTileTime();
+
+// Counter for the number of regions evaluated by adaptive
+// supersampling at each depth, where depth 0 is a whole pixel.
+void incRefinementCount(const size_t depth, const size_t n = 1);
+Counter getRefinementCount(const size_t depth);
+
+// Counter for the number of samples traced by adaptive supersampling
+// at each depth. Samples shared between regions are traced once.
+void incSubsampleCount(const size_t depth, const size_t n = 1);
+Counter getSubsampleCount(const size_t depth);
+
+// The number of depths for which the above counters are kept. Deeper
+// counts are added to the deepest counter.
+static constexpr size_t maxRefinementDepth = 16;
+
+// Counter for the number of ray paths which terminated after `depth'
+// reflections. Depths are counted in power of two bins: bin 0 counts
+// paths with no reflections, and bin b > 0 those with between
+// 2^(b-1) and 2^b - 1. Deeper paths are added to the last bin.
+void incRayDepthCount(const size_t depth, const size_t n = 1);
+Counter getRayDepthCount(const size_t bin);
+static constexpr size_t numRayDepthBins = 16;
+
+// Reset all counters except the objects and lights counts, which
+// describe the scene. Must not be called while rendering.
+void reset();
+
 }  // namespace counters
 
+// Write a JSON report of the counters for a frame of `pixels' pixels
+// which took `runTime' seconds.
+void writeJson(std::ostream &out, const size_t pixels,
+               const Scalar runTime);
+
 }  // namespace profiling
 
 }  // namespace rt
@@ -20,7 +20,9 @@
 #ifndef RT_RANDOM_H_
 #define RT_RANDOM_H_
 
+#include <cmath>
 #include <cstdint>
+#include <cstring>
 #include <limits>
 
 #include "rt/math.h"
@@ -30,54 +32,104 @@ namespace rt {
 // Random number seed:
 using seed = uint64_t;
 
-// A random number generator for sampling a uniform distribution
-// within a specific range.
+namespace random {
+
+// A 64-bit finaliser (from SplitMix64), which maps consecutive
+// integers to statistically independent values.
+inline seed mix(seed x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// Combine two values into a single key.
+inline seed combine(const seed a, const seed b) {
+  return mix(a ^ mix(b + 0x9e3779b97f4a7c15ULL));
+}
+
+// Return a key for a sample at image coordinates [x,y]. Coordinates
+// are hashed by their bit patterns, so every pixel and subpixel
+// sample position has its own key.
+inline seed key(const Scalar x, const Scalar y) {
+  static_assert(sizeof(Scalar) <= sizeof(seed), "Scalar too wide");
+  seed a = 0, b = 0;
+  std::memcpy(&a, &x, sizeof(x));
+  std::memcpy(&b, &y, sizeof(y));
+  return combine(a, b);
+}
+
+}  // namespace random
+
+// A counter-based stream of random numbers. Each value is a pure
+// function of the stream's key and a counter, so a stream keyed by
+// e.g. sample position and sample number produces the same sequence
+// regardless of which thread evaluates it, or in what order. Streams
+// are cheap to create, and live on the stack of the code that
+// consumes them, so there are no shared writes.
+class RandomStream {
+ public:
+  explicit RandomStream(const seed key, const seed stream = 0)
+      : _key(random::combine(key, stream)), _counter(0) {}
+
+  // Return the next value in the range [0,1).
+  Scalar operator()() {
+    const seed x = random::mix(_key + 0x9e3779b97f4a7c15ULL * ++_counter);
+    // Use the top bits as the mantissa.
+    constexpr int digits = std::numeric_limits<Scalar>::digits;
+    return static_cast<Scalar>(x >> (64 - digits))
+        * (Scalar{1} / static_cast<Scalar>(1ULL << digits));
+  }
+
+ private:
+  const seed _key;
+  seed _counter;
+};
+
+// A uniform distribution within a specific range. Distributions are
+// stateless, drawing values from a stream.
 template<typename T>
 class UniformDistribution {
  public:
-  UniformDistribution(const T& min, const T& max,
-                      const seed seedval = seed{7564231})
-      : _divisor(std::numeric_limits<T>::max() / (max - min)),
-        _min(min), _seed(seedval) {}  // NOLINT(build/include_what_you_use)
-
-  // Generate a new random value in the range [0,max - min].
-  auto operator()() {
-    _seed *= 62089911ULL;  // magic value
-    return (_seed % std::numeric_limits<seed>::max() / _divisor) + _min;
+  UniformDistribution(const T& min, const T& max)
+      : _min(min), _range(max - min) {}
+
+  // Generate a new random value in the range [min,max).
+  auto operator()(RandomStream &rng) const {
+    return static_cast<T>(_min + _range * rng());
   }
 
-  const T _divisor;
   const T _min;
-  seed _seed;
+  const T _range;
 };
 
-// A generator for sampling random points over a disk.
+// A distribution of random points over a disk.
 template<typename T>
 class UniformDiskDistribution {
  public:
-  UniformDiskDistribution(const T radius,
-                          const seed seed1 = seed{7564231},
-                          const seed seed2 = seed{7564231})
-      : angle(0, 2 * M_PI, seed1),
-        rand01(0, 1, seed2),
+  explicit UniformDiskDistribution(const T radius)
+      : angle(0, static_cast<T>(2 * M_PI)),
+        rand01(0, 1),
         _radius(radius) {}
 
   // Return a random point on the disk, with the vector x and y
   // components corresponding to the x and y coordinates of the
   // point within the disk.
-  auto operator()() {
-    const T theta = angle();
-    const T distance = _radius * sqrt(rand01());
+  auto operator()(RandomStream &rng) const {
+    const T theta = angle(rng);
+    const T distance = _radius * std::sqrt(rand01(rng));
 
-    const T x = distance * cos(theta);
-    const T y = distance * sin(theta);
+    const T x = distance * std::cos(theta);
+    const T y = distance * std::sin(theta);
 
     return Vector(x, y);
   }
 
+  // Return the radius of the disk.
+  inline T radius() const { return _radius; }
+
  private:
-  UniformDistribution<T> angle;
-  UniformDistribution<T> rand01;
+  const UniformDistribution<T> angle;
+  const UniformDistribution<T> rand01;
   const T _radius;
 };
 
@@ -20,6 +20,8 @@
 #ifndef RAY_H_
 #define RAY_H_
 
+#include <cstddef>
+
 #include "rt/math.h"
 
 namespace rt {
@@ -34,6 +36,47 @@ namespace rt {
       : position(_position), direction(_direction) {}
   };
 
+  // The number of rays which are traced together in a packet: one
+  // 256-bit vector register of Scalars.
+  static constexpr size_t packetSize = 32 / sizeof(Scalar);
+
+  // A packet of rays, stored as a structure of arrays so that each
+  // component of every ray can be loaded into a single vector
+  // register. Packets may be partially filled, in which case the
+  // unused lanes duplicate the first ray.
+  class RayPacket {
+  public:
+    alignas(32) Scalar px[packetSize];
+    alignas(32) Scalar py[packetSize];
+    alignas(32) Scalar pz[packetSize];
+    alignas(32) Scalar dx[packetSize];
+    alignas(32) Scalar dy[packetSize];
+    alignas(32) Scalar dz[packetSize];
+    const size_t size;
+
+    // Construct a packet from n <= packetSize rays, where ray(i)
+    // returns the i-th ray.
+    template<typename Generator>
+    inline RayPacket(const size_t n, Generator ray)
+      : size(n) {
+      for (size_t i = 0; i < packetSize; i++) {
+        const Ray r = i < n ? ray(i) : Ray(Vector(px[0], py[0], pz[0]),
+                                           Vector(dx[0], dy[0], dz[0]));
+        px[i] = r.position.x;
+        py[i] = r.position.y;
+        pz[i] = r.position.z;
+        dx[i] = r.direction.x;
+        dy[i] = r.direction.y;
+        dz[i] = r.direction.z;
+      }
+    }
+
+    // Return the i-th ray.
+    inline Ray operator[](const size_t i) const {
+      return Ray(Vector(px[i], py[i], pz[i]), Vector(dx[i], dy[i], dz[i]));
+    }
+  };
+
 }  // namespace rt
 
 #endif  // RAY_H_
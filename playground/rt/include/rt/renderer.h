@@ -20,16 +20,24 @@
 #ifndef RT_RENDERER_H_
 #define RT_RENDERER_H_
 
+#include <algorithm>
 #include <array>
+#include <limits>
+#include <stdexcept>
+#include <string>
 #include <vector>
 #include <cstdint>
 
 #ifdef USE_TBB
+#include "tbb/blocked_range.h"
+#include "tbb/blocked_range2d.h"
 #include "tbb/parallel_for.h"
+#include "tbb/partitioner.h"
 #endif
 
 #include "rt/camera.h"
 #include "rt/image.h"
+#include "rt/profiling.h"
 #include "rt/random.h"
 #include "rt/ray.h"
 #include "rt/scene.h"
@@ -46,7 +54,10 @@ class Renderer {
   Renderer(const Scene &scene,
            const rt::Camera *const restrict camera,
            const size_t numDofSamples = 1,
-           const size_t maxRayDepth   = 5000);
+           const size_t maxRayDepth   = 5000,
+           const size_t tileSize      = 32,
+           const Scalar minRayWeight  = 1 / Scalar(512),
+           const Scalar rouletteWeight = 0);
 
   ~Renderer();
 
@@ -58,131 +69,293 @@ class Renderer {
   // The maximum depth to trace reflected rays to:
   const size_t maxRayDepth;
 
+  // Reflected rays are not traced once the product of the
+  // reflectivities along their path falls below `minRayWeight', since
+  // their contribution would not be visible. Paths with a weight
+  // below `rouletteWeight' are continued with probability
+  // weight / rouletteWeight, and scaled to compensate (Russian
+  // roulette). A `rouletteWeight' of 0 disables roulette:
+  const Scalar minRayWeight;
+  const Scalar rouletteWeight;
+
   // TODO: Super sampling anti-aliasing configuration:
 
   // Number of samples to make for depth of field:
   const size_t numDofSamples;
 
+  // The width and height of the square tiles which the image is
+  // split into for scheduling. Each tile is a unit of work, so it
+  // should be small enough for its samples to stay in cache, and
+  // large enough to amortise scheduling overhead. The constructor
+  // throws std::invalid_argument if it is zero:
+  const size_t tileSize;
+
   // The heart of the raytracing engine.
   template<typename Image>
   void render(Image *const image) const;
 
+  // Render progressively. The first pass samples one pixel in every
+  // 2^(passes - 1) square block, and each following pass halves the
+  // block size until every pixel is sampled. A final pass performs
+  // adaptive supersampling. After each of the `passes' passes, the
+  // image holds a complete (if coarse) frame, and callback(pass) is
+  // called with the zero-based index of the pass. Throws
+  // std::invalid_argument if the first block size does not fit in a
+  // size_t.
+  template<typename Image, typename Callback>
+  void renderProgressive(Image *const image,
+                         const size_t passes,
+                         const Callback &callback) const;
+
+  // Render the w x h tile with its top left pixel at [x,y] of a
+  // width x height image, setting `pixels' to the colours of its
+  // pixels in row order. Samples depend only on their position in
+  // the image, so rendering every tile of an image gives exactly
+  // the pixels of render().
+  void renderTile(std::vector<Colour> *const pixels,
+                  const size_t width,
+                  const size_t height,
+                  const size_t x,
+                  const size_t y,
+                  const size_t w,
+                  const size_t h) const;
+
  private:
-  // Recursively supersample a region.
-  Colour renderRegion(const Scalar x,
-                      const Scalar y,
-                      const Scalar regionSize,
-                      const Matrix &transform,
-                      const size_t depth = 0) const;
+  // Return the primary ray generator for a width x height image.
+  CameraRays cameraRays(const size_t width, const size_t height) const;
+
+  // Sample the centre of every stride-th pixel of a width x height
+  // grid which has a one pixel border. If `skipCoarser' is set,
+  // pixels which were sampled at twice the stride are skipped. The
+  // grid is offset by [originX,originY] within the image.
+  void sample(std::vector<Colour> *const sampled,
+              const size_t width,
+              const size_t height,
+              const CameraRays &rays,
+              const size_t stride,
+              const bool skipCoarser = false,
+              const size_t originX = 0,
+              const size_t originY = 0) const;
+
+  // Write every pixel to the image, supersampling those which
+  // differ from the neighbouring samples.
+  template<typename Image>
+  void supersample(Image *const image,
+                   const std::vector<Colour> &sampled,
+                   const CameraRays &rays) const;
+
+  // Compute the colour of every pixel of a width x height image from
+  // the bordered grid of samples, refining pixels which differ from
+  // their neighbours. The grid is offset by [originX,originY]
+  // within the image.
+  void antialias(std::vector<Colour> *const pixels,
+                 const size_t width,
+                 const size_t height,
+                 const std::vector<Colour> &sampled,
+                 const CameraRays &rays,
+                 const size_t originX = 0,
+                 const size_t originY = 0) const;
+
+  // Adaptive supersampling subdivides pixels into square regions,
+  // whose centres and corners lie on a lattice with latticeSize
+  // points per pixel along each axis.
+  static constexpr uint32_t latticeSize = 2u << maxSubpixelDepth;
+
+  // A refinement work item: a square region of a pixel, with the
+  // origin given in lattice coordinates. Regions at depth d are
+  // 1 / 2^d pixels wide. A region's colour is estimated from five
+  // samples: its centre, followed by its corners in row order. The
+  // samples are indices into a list of sample values, or `unknown'.
+  struct Region {
+    static constexpr uint32_t unknown = UINT32_MAX;
+
+    uint32_t pixel;
+    uint32_t x;
+    uint32_t y;
+    uint32_t depth;
+    std::array<uint32_t, 5> samples;
+  };
+
+  // Drain a queue of refinement work items, accumulating the colour
+  // of each finished region into its pixel. Work items are processed
+  // one depth at a time: the samples required by each depth are
+  // traced in parallel, then the regions are evaluated in parallel,
+  // and those which need further refinement are split into four
+  // items of the next depth. Samples are memoised: subregions
+  // inherit a corner and centre from their parent, and corners which
+  // are shared by neighbouring regions are traced once.
+  void refine(std::vector<Colour> *const pixels,
+              std::vector<Region> queue,
+              const std::vector<Colour> &sampled,
+              const size_t borderedWidth,
+              const CameraRays &rays,
+              const size_t originX,
+              const size_t originY) const;
 
   // Get the colour value at a single point.
   Colour renderPoint(const Scalar x,
                      const Scalar y,
-                     const Matrix &transform) const;
+                     const CameraRays &rays) const;
 
   // Trace a ray trough a given scene and return the final
-  // colour.
+  // colour. Random sampling draws from `rng'.
   Colour trace(const Ray &ray,
-               const unsigned int depth = 0) const;
+               RandomStream &rng) const;
+
+  // Return the colour of a ray which intersects `object' at
+  // distance `t'. Reflections are followed iteratively, so the stack
+  // depth does not grow with the ray depth.
+  Colour shade(const Ray &ray,
+               const Object *restrict object,
+               Scalar t,
+               RandomStream &rng) const;
 
   // Perform supersample interpolation.
   Colour interpolate(const size_t image_x,
                      const size_t image_y,
                      const size_t dataWidth,
                      const Colour *const restrict data) const;
+
+  // Apply a function to every pixel of a width x height grid,
+  // scheduling each tile of the grid as a separate work item:
+  //
+  //   void fn(const size_t x, const size_t y);
+  //
+  // If `timed' is set, the time taken by each tile is recorded.
+  template<typename Fn>
+  void forEachTile(const size_t width, const size_t height,
+                   const Fn &fn, const bool timed = false) const;
+
+  // Apply a function to every index in the range [0,n):
+  //
+  //   void fn(const size_t i);
+  template<typename Fn>
+  void forEachIndex(const size_t n, const Fn &fn) const;
 };
 
+template<typename Fn>
+void Renderer::forEachTile(const size_t width, const size_t height,
+                           const Fn &fn, const bool timed) const {
+  const auto tile = [&](const size_t rowBegin, const size_t rowEnd,
+                        const size_t colBegin, const size_t colEnd) {
+    const profiling::Timer timer;
+
+    for (size_t y = rowBegin; y < rowEnd; y++)
+      for (size_t x = colBegin; x < colEnd; x++)
+        fn(x, y);
+
+    if (timed)
+      profiling::counters::addTileTime(timer.microseconds());
+  };
+
+#ifdef USE_TBB
+  // A simple partitioner with a grain size of one tile splits the
+  // range down to exactly one task per tile, which idle workers
+  // then steal.
+  tbb::parallel_for(
+      tbb::blocked_range2d<size_t>(0, height, tileSize,
+                                   0, width, tileSize),
+      [&](const tbb::blocked_range2d<size_t> &r) {
+        tile(r.rows().begin(), r.rows().end(),
+             r.cols().begin(), r.cols().end());
+      },
+      tbb::simple_partitioner());
+#else  // USE_TBB
+  for (size_t y = 0; y < height; y += tileSize)
+    for (size_t x = 0; x < width; x += tileSize)
+      tile(y, std::min(y + tileSize, height),
+           x, std::min(x + tileSize, width));
+#endif  // USE_TBB
+}
+
+template<typename Fn>
+void Renderer::forEachIndex(const size_t n, const Fn &fn) const {
+#ifdef USE_TBB
+  tbb::parallel_for(tbb::blocked_range<size_t>(0, n),
+                    [&](const tbb::blocked_range<size_t> &r) {
+    for (size_t i = r.begin(); i < r.end(); i++)
+      fn(i);
+  });
+#else
+  for (size_t i = 0; i < n; i++)
+    fn(i);
+#endif
+}
+
 template<typename Image>
 void Renderer::render(Image *const image) const {
-  // Create image to camera transformation matrix.
-  //
-  // Create a transformation matrix to scale from image
-  // space coordinates (i.e. [x,y] coordinates with
-  // reference to the image size) to camera space
-  // coordinates (i.e. [x,y] coordinates with reference
-  // to the camera's film size).
-  //
-  // Scale image coordinates to camera coordinates.
-  const Scale scale(camera->width / image->width,
-                    camera->height / image->height, 1);
-  // Offset from image coordinates to camera coordinates.
-  const Translation offset(-(image->width * .5),
-                           -(image->height * .5), 0);
-  const auto transformMatrix = scale * offset;
+  // Create the primary ray generator.
+  const CameraRays rays = cameraRays(image->width, image->height);
 
   // First, we collect a single sample for every pixel in the
   // image, plus an additional border of 1 pixel on all sides.
   const size_t borderedWidth = image->width + 2;
   const size_t borderedHeight = image->height + 2;
-  const size_t borderedSize = borderedWidth * borderedHeight;
-  std::vector<Colour> sampled(borderedSize);
+  std::vector<Colour> sampled(borderedWidth * borderedHeight);
 
   // Collect pixel samples:
-#ifdef USE_TBB
-  tbb::parallel_for(
-      static_cast<size_t>(0), sampled.size(), [&](const size_t index)
-#else  // USE_TBB
-  for (size_t index = 0; index < sampled.size(); ++index)
-#endif  // USE_TBB
-    {
-      // Get the pixel coordinates.
-      const auto x = image::x(index, borderedWidth);
-      const auto y = image::y(index, borderedWidth);
-
-      // Sample a point in the centre of the pixel.
-      sampled[index] = renderPoint(x + .5, y + .5,
-                                   transformMatrix);
-    }
-#ifdef USE_TBB
-  );  // NOLINT
-#endif  // USE_TBB
+  sample(&sampled, borderedWidth, borderedHeight, rays, 1);
 
-  // Allocate memory for super-sampled image.
-  std::vector<Colour> superSampled(image->size);
-
-  // For each pixel in the image:
-  for (size_t index = 0; index < image->size; index++) {
-    // Get the pixel coordinates.
-    const size_t x = image::x(index, image->width);
-    const size_t y = image::y(index, image->width);
-
-    // Get the previously sampled pixel value.
-    Colour pixel = sampled[image::index(x + 1, y + 1,
-                                        borderedWidth)];
-
-    // Create a list of all neighbouring element indices.
-    const std::array<size_t, 8> neighbour_indices = {
-      image::index(x - 1, y - 1, borderedWidth),
-      image::index(x,     y - 1, borderedWidth),
-      image::index(x + 1, y - 1, borderedWidth),
-      image::index(x - 1, y,     borderedWidth),
-      image::index(x + 1, y,     borderedWidth),
-      image::index(x - 1, y + 1, borderedWidth),
-      image::index(x,     y + 1, borderedWidth),
-      image::index(x + 1, y + 1, borderedWidth)
-    };
-
-    // Calculate the difference between the neighbouring
-    // pixel values.
-    Scalar diffSum = 0;
-    for (const auto neighbour_index : neighbour_indices) {
-      const auto diff = pixel.diff(sampled[neighbour_index]);
-      diffSum += diff;
-    }
+  // Supersample and write pixels to the image.
+  supersample(image, sampled, rays);
+}
 
-    // If the difference is above a given threshold,
-    // recursively supersample the pixel.
-    if (diffSum > maxPixelDiff * neighbour_indices.size()) {
-      pixel = renderRegion(x, y, 1, transformMatrix);
-    }
+template<typename Image, typename Callback>
+void Renderer::renderProgressive(Image *const image,
+                                 const size_t passes,
+                                 const Callback &callback) const {
+  if (passes > size_t(std::numeric_limits<size_t>::digits))
+    throw std::invalid_argument("Too many progressive passes: "
+                                + std::to_string(passes));
+
+  const CameraRays rays = cameraRays(image->width, image->height);
+
+  const size_t borderedWidth = image->width + 2;
+  const size_t borderedHeight = image->height + 2;
+  std::vector<Colour> sampled(borderedWidth * borderedHeight);
 
-    // Set new value.
-    superSampled[index] = pixel;
+  // Each sampling pass halves the stride between samples, down to
+  // one sample per pixel. Points sampled by earlier passes are not
+  // resampled, so the sampling passes together cost the same as the
+  // first pass of render().
+  size_t pass = 0;
+  for (size_t stride = size_t(1) << (passes > 1 ? passes - 1 : 0);
+       stride; stride /= 2) {
+    sample(&sampled, borderedWidth, borderedHeight, rays,
+           stride, pass > 0);
+
+    // Fill each pixel from the nearest sample at or above and to the
+    // left of it.
+    if (stride > 1) {
+      forEachTile(image->width, image->height,
+                  [&](const size_t x, const size_t y) {
+        image->set(x, y, sampled[image::index((x + 1) / stride * stride,
+                                              (y + 1) / stride * stride,
+                                              borderedWidth)]);
+      });
+      callback(pass++);
+    }
   }
 
-  // Write pixel information to image.
-  for (size_t index = 0; index < image->size; index++)
-    image->set(index, superSampled[index]);
+  // Final pass.
+  supersample(image, sampled, rays);
+  callback(pass);
+}
+
+template<typename Image>
+void Renderer::supersample(Image *const image,
+                           const std::vector<Colour> &sampled,
+                           const CameraRays &rays) const {
+  std::vector<Colour> pixels(image->size);
+  antialias(&pixels, image->width, image->height, sampled,
+            rays);
+
+  // Write pixels to the image. Tiles are disjoint, so there are no
+  // conflicting writes.
+  forEachTile(image->width, image->height,
+              [&](const size_t x, const size_t y) {
+    image->set(x, y, pixels[image::index(x, y, image->width)]);
+  });
 }
 
 }  // namespace rt
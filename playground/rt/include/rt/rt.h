@@ -20,11 +20,19 @@
 #ifndef RT_RT_H_
 #define RT_RT_H_
 
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <future>
 #include <string>
 #include <iostream>
+#include <vector>
 
 #include "tbb/parallel_for.h"
 
+#include "rt/builder.h"
+#include "rt/distributed.h"
+#include "rt/framebuffer.h"
 #include "rt/image.h"
 #include "rt/renderer.h"
 #include "rt/restrict.h"
@@ -35,21 +43,39 @@
 //   * Lighting: Point & soft lighting, reflections.
 //   * Shading: Lambert (diffuse) and Phong (specular).
 //   * Anti-aliasing: Stochastic supersampling.
+//   * Output: Progressive rendering to a memory mapped image file.
+//   * Scenes: Arena allocated scene construction.
+//   * Animation: Pipelined rendering of camera paths.
+//   * Distribution: Tiles rendered by worker processes.
 namespace rt {
 
+  // Print the cost of building a scene.
+  inline void printStats(const SceneBuilder::Stats &stats) {
+    printf("Built scene of %lu materials, %lu objects, and %lu lights "
+           "in %.3f seconds.\n", stats.materials, stats.objects,
+           stats.lights, stats.time);
+    printf("\tScene memory:\t\t%lu bytes (%lu reserved)\n\n",
+           stats.used, stats.reserved);
+  }
+
   // Render the target image and write output to path. Prints
-  // profiling information.
+  // profiling information, and if reportPath is not empty, writes
+  // it as JSON to reportPath.
   template<typename Image>
   void render(const Renderer &renderer,
               const std::string path,
-              Image *const image) {
+              Image *const image,
+              const std::string reportPath = "") {
     // Print start message.
     printf("Rendering %lu pixels, with "
-           "%llu objects, and %llu light sources ...\n",
+           "%" PRIu64 " objects, and %" PRIu64 " light sources ...\n",
            image->size,
            profiling::counters::getObjectsCount(),
            profiling::counters::getLightsCount());
 
+    // Count this frame only.
+    profiling::counters::reset();
+
     // Start timer.
     profiling::Timer t = profiling::Timer();
 
@@ -59,18 +85,10 @@ namespace rt {
     // Get elapsed time.
     Scalar runTime = t.elapsed();
 
-    // Open the output file.
-    std::cout << "Opening file '" << path << "'..." << std::endl;
-    std::ofstream out;
-    out.open(path);
-
     // Write image to output file.
-    out << *image;
-
-    // Close the output file.
-    std::cout << "Closing file '" << path << "'..." << std::endl;
+    std::cout << "Writing file '" << path << "'..." << std::endl;
     std::cout << std::endl;
-    out.close();
+    image::writeP6(path, *image);
 
     // Calculate performance information.
     profiling::Counter traceCount = profiling::counters::getTraceCount();
@@ -85,15 +103,208 @@ namespace rt {
       / static_cast<Scalar>(image->size);
 
     // Print performance summary.
-    printf("Rendered %lu pixels from %llu traces in %.3f seconds.\n\n",
+    printf("Rendered %lu pixels from %" PRIu64 " traces in %.3f seconds.\n\n",
            image->size, traceCount, runTime);
     printf("Render performance:\n");
-    printf("\tRays per second:\t%llu\n", rayRate);
-    printf("\tTraces per second:\t%llu\n", traceRate);
-    printf("\tPixels per second:\t%llu\n", pixelRate);
+    printf("\tRays per second:\t%" PRIu64 "\n", rayRate);
+    printf("\tTraces per second:\t%" PRIu64 "\n", traceRate);
+    printf("\tPixels per second:\t%" PRIu64 "\n", pixelRate);
     printf("\tTraces per pixel:\t%.2f\n", tracePerPixel);
+    printf("\tIntersection tests:\t%" PRIu64 "\n",
+           profiling::counters::getIntersectionCount());
+    printf("\tShadow ray hits:\t%" PRIu64 "\n",
+           profiling::counters::getShadowHitCount());
+    printf("\tShadow ray misses:\t%" PRIu64 "\n",
+           profiling::counters::getShadowMissCount());
+    printf("\tShadow rays per pixel:\t%.2f\n",
+           static_cast<Scalar>(profiling::counters::getShadowHitCount()
+                               + profiling::counters::getShadowMissCount())
+           / static_cast<Scalar>(image->size));
+    printf("\tPenumbra points:\t%" PRIu64 " of %" PRIu64 "\n",
+           profiling::counters::getPenumbraCount(),
+           profiling::counters::getShadowPointCount());
+    const profiling::Counter occluderHits =
+        profiling::counters::getOccluderHitCount();
+    const profiling::Counter occluderTests =
+        occluderHits + profiling::counters::getOccluderMissCount();
+    printf("\tOccluder cache hits:\t%" PRIu64 " of %" PRIu64 " (%.1f%%)\n",
+           occluderHits, occluderTests,
+           occluderTests ? 100. * occluderHits / occluderTests : 0);
+    printf("\tMean tile time:\t\t%.3f ms\n",
+           profiling::counters::getTileCount()
+           ? profiling::counters::getTileTime() / 1e3
+             / profiling::counters::getTileCount()
+           : 0);
+    printf("\tMax tile time:\t\t%.3f ms\n",
+           profiling::counters::getMaxTileTime() / 1e3);
+
+    // Print the cost of adaptive supersampling at each depth.
+    printf("\nSupersampling:\n");
+    for (size_t depth = 0;
+         depth < profiling::counters::maxRefinementDepth; depth++) {
+      const profiling::Counter regions =
+          profiling::counters::getRefinementCount(depth);
+      if (!regions)
+        break;
+
+      printf("\tDepth %lu:\t%" PRIu64 " regions, %" PRIu64 " samples\n", depth,
+             regions, profiling::counters::getSubsampleCount(depth));
+    }
+
+    // Print the number of reflections after which paths terminated.
+    printf("\nRay depths:\n");
+    for (size_t bin = 0; bin < profiling::counters::numRayDepthBins; bin++) {
+      const profiling::Counter paths =
+          profiling::counters::getRayDepthCount(bin);
+      if (!paths)
+        continue;
+
+      const size_t first = bin ? 1ul << (bin - 1) : 0;
+      const size_t last = bin ? (1ul << bin) - 1 : 0;
+      if (bin == profiling::counters::numRayDepthBins - 1)
+        printf("\t>= %lu:\t\t%" PRIu64 "\n", first, paths);
+      else if (first == last)
+        printf("\t%lu:\t\t%" PRIu64 "\n", first, paths);
+      else
+        printf("\t%lu-%lu:\t\t%" PRIu64 "\n", first, last, paths);
+    }
+
+    // Write the JSON report.
+    if (!reportPath.empty()) {
+      std::ofstream report(reportPath);
+      profiling::writeJson(report, image->size, runTime);
+      std::cout << "\nWrote report '" << reportPath << "'" << std::endl;
+    }
+  }
+
+  // Render the target image progressively, writing each pass to a
+  // memory mapped binary PPM file at path as soon as it completes.
+  // Prints the time taken by each pass.
+  template<typename Image>
+  void renderProgressive(const Renderer &renderer,
+                         const std::string path,
+                         Image *const image,
+                         const size_t passes = 4) {
+    printf("Rendering %lu pixels progressively in %lu passes ...\n",
+           image->size, std::max(passes, size_t(1)));
+
+    MappedFramebuffer framebuffer(path, image->width, image->height);
+    profiling::counters::reset();
+
+    profiling::Timer t = profiling::Timer();
+    Scalar lastTime = 0;
+
+    renderer.renderProgressive(image, passes, [&](const size_t pass) {
+      const Scalar passTime = t.elapsed();
+
+      framebuffer.write(image->data.data());
+
+      printf("\tPass %lu:\t%.3f seconds (%.3f total)\n",
+             pass + 1, passTime - lastTime, passTime);
+      lastTime = passTime;
+    });
+
+    framebuffer.sync();
+
+    printf("Rendered %lu pixels from %" PRIu64 " traces in %.3f seconds.\n",
+           image->size, profiling::counters::getTraceCount(),
+           t.elapsed());
+  }
+
+
+  // Render an animation of a scene, with one frame per camera. Frame
+  // i is written to a binary PPM file at prefix + "%04d.ppm". The
+  // scene, and so its BVH, is shared by every frame.
+  //
+  // Frames alternate between two images, so that each frame is
+  // written by a background task while the next frame is rendered.
+  // Before rendering into an image, the write of the frame which last
+  // used it is waited for, and any error it threw is rethrown. Prints
+  // the time taken by each frame, and the throughput in frames per
+  // hour. The remaining arguments are passed to each frame's Renderer.
+  template<typename Image>
+  void renderAnimation(const Scene &scene,
+                       const std::vector<Camera> &cameras,
+                       const std::string prefix,
+                       Image *const front,
+                       Image *const back,
+                       const size_t numDofSamples = 1,
+                       const size_t maxRayDepth = 5000,
+                       const size_t tileSize = 32,
+                       const Scalar minRayWeight = 1 / Scalar(512),
+                       const Scalar rouletteWeight = 0) {
+    Image *const images[2] = {front, back};
+    std::future<void> writes[2];
+
+    printf("Rendering %lu frames of %lu pixels ...\n",
+           cameras.size(), front->size);
+
+    profiling::counters::reset();
+    profiling::Timer t = profiling::Timer();
+    Scalar lastTime = 0;
+
+    for (size_t i = 0; i < cameras.size(); i++) {
+      Image *const image = images[i % 2];
+      if (writes[i % 2].valid())
+        writes[i % 2].get();
+
+      const Renderer renderer(scene, &cameras[i], numDofSamples,
+                              maxRayDepth, tileSize, minRayWeight,
+                              rouletteWeight);
+      renderer.render(image);
+
+      // Room for the widest size_t, ".ppm", and the terminator.
+      char suffix[32];
+      snprintf(suffix, sizeof(suffix), "%04lu.ppm", i);
+      const std::string path = prefix + suffix;
+      writes[i % 2] = std::async(std::launch::async, [path, image]() {
+        image::writeP6(path, *image);
+      });
+
+      const Scalar frameTime = t.elapsed();
+      printf("\tFrame %lu:\t%.3f seconds (%.3f total)\n",
+             i, frameTime - lastTime, frameTime);
+      lastTime = frameTime;
+    }
+
+    for (auto &write : writes)
+      if (write.valid())
+        write.get();
+
+    const Scalar runTime = t.elapsed();
+    printf("Rendered %lu frames from %" PRIu64 " traces in %.3f seconds.\n",
+           cameras.size(), profiling::counters::getTraceCount(), runTime);
+    printf("\tFrames per hour:\t%.1f\n",
+           runTime > 0 ? cameras.size() * 3600 / runTime : 0);
   }
 
+  // Render the target image with the workers of a coordinator, and
+  // write output to path. Prints the work done by each worker, and
+  // the scaling efficiency.
+  template<typename Image>
+  void renderDistributed(TileCoordinator *const coordinator,
+                         const std::string path,
+                         Image *const image) {
+    printf("Rendering %lu pixels with %lu workers ...\n",
+           image->size, coordinator->numWorkers);
+
+    const DistributedStats stats = coordinator->render(image);
+
+    std::cout << "Writing file '" << path << "'..." << std::endl;
+    std::cout << std::endl;
+    image::writeP6(path, *image);
+
+    printf("Rendered %lu tiles in %.3f seconds.\n\n",
+           stats.tiles, stats.time);
+    for (size_t i = 0; i < stats.workers.size(); i++) {
+      const DistributedStats::Worker &worker = stats.workers[i];
+      printf("\tWorker %lu:\t%lu tiles, %.3f seconds busy%s\n", i,
+             worker.tiles, worker.busy / 1e6,
+             worker.alive ? "" : " (disconnected)");
+    }
+    printf("\tReissued tiles:\t%lu\n", stats.reissued);
+    printf("\tScaling efficiency:\t%.1f%%\n", 100 * stats.efficiency());
+  }
 
 
 }  // namespace rt
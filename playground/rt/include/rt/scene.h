@@ -20,31 +20,71 @@
 #ifndef RT_SCENE_H_
 #define RT_SCENE_H_
 
+#include <memory>
+#include <utility>
 #include <vector>
 
+#include "rt/arena.h"
 #include "rt/lights.h"
 #include "rt/objects.h"
 
 namespace rt {
 
 // A full scene, consisting of objects (spheres) and lighting (point
-// lights).
+// lights). An index over the objects for accelerating ray queries is
+// built once on construction.
+//
+// A scene owns its objects and lights. They are either allocated
+// individually with new, or in an arena which the scene is given.
 class Scene {
  public:
+  // The arena holding the objects and lights, if any.
+  const std::unique_ptr<Arena> arena;
+
   const Objects objects;
   const Lights lights;
+  const ObjectIndex index;
 
   // Constructor.
   inline Scene(const Objects &_objects,
                const Lights &_lights)
-      : objects(_objects), lights(_lights) {}
+      : objects(_objects), lights(number(_lights)), index(_objects) {}
+
+  // Constructor. Use a previously built BVH over the bounded
+  // objects.
+  inline Scene(const Objects &_objects,
+               const Lights &_lights,
+               BVH &&bvh)
+      : objects(_objects), lights(number(_lights)),
+        index(_objects, std::move(bvh)) {}
+
+  // Constructor. Use a previously built BVH over the bounded
+  // objects, which with the lights are allocated in `_arena'.
+  inline Scene(const Objects &_objects,
+               const Lights &_lights,
+               BVH &&bvh,
+               std::unique_ptr<Arena> &&_arena)
+      : arena(std::move(_arena)), objects(_objects),
+        lights(number(_lights)), index(_objects, std::move(bvh)) {}
 
   inline ~Scene() {
+    // Arena allocations are released together with the arena.
+    if (arena)
+      return;
+
     for (auto object : objects)
       delete object;
     for (auto light : lights)
       delete light;
   }
+
+ private:
+  // Set the id of each light to its index.
+  static inline Lights &number(Lights &lights) {
+    for (size_t i = 0; i < lights.size(); i++)
+      lights[i]->id = i;
+    return lights;
+  }
 };
 
 }  // namespace rt
@@ -322,6 +322,9 @@ def set_renderer(pairs):
     renderer["depth"] = consume_int(pairs, "raydepth", default=100)
     renderer["scale"] = consume_int(pairs, "scale", default=1)
     renderer["dof"] = consume_int(pairs, "dofsamples", default=1)
+    renderer["minweight"] = consume_scalar(pairs, "minrayweight",
+                                           default=1. / 512)
+    renderer["roulette"] = consume_scalar(pairs, "rouletteweight", default=0)
     renderer["path"] = consume_str(pairs, "path", default="render.ppm")
 
 def set_renderer_antialiasing(pairs):
@@ -334,6 +337,8 @@ def set_renderer_softlights(pairs):
     renderer["lights"] = lights
     lights["base"] = consume_int(pairs, "base", default=3)
     lights["scalefactor"] = consume_scalar(pairs, "scalefactor", default=.01)
+    lights["adaptive"] = consume_int(pairs, "adaptive", default=0)
+    lights["threshold"] = consume_scalar(pairs, "threshold", default=0)
 
 
 materials = set()
@@ -432,15 +437,23 @@ def get_softlight_code(name, pairs):
     #        s  is the soft light scale factor.
     samples = ceil(base + (size * scale) ** 3)
 
+    # Adaptive lights cast a first batch of samples, and only cast
+    # the rest if the first batch's visibility variance exceeds the
+    # threshold.
+    adaptive = renderer["lights"]["adaptive"]
+    threshold = renderer["lights"]["threshold"]
+
     if name in lights:
         fatal("Duplicate light name '{0}'"
               .format(name))
     lights.add(name)
 
     return ("const SoftLight *const restrict {name} = "
-            "new SoftLight({position}, {colour}, {size}, {samples});"
+            "new SoftLight({position}, {colour}, {size}, {samples}, "
+            "{adaptive}, {threshold});"
             .format(name=name, position=position, size=size,
-                    colour=colour, samples=samples))
+                    colour=colour, samples=samples, adaptive=adaptive,
+                    threshold=threshold))
 
 def get_pointlight_code(name, pairs):
     position = consume_vector(pairs, "position")
@@ -606,11 +619,13 @@ def get_scene_code():
 def get_renderer_code():
     depth = renderer["depth"]
     dofsamples = renderer["dof"]
+    minweight = renderer["minweight"]
+    roulette = renderer["roulette"]
 
     c = ("Renderer *const renderer = new Renderer(*{scene}, {camera}, "
-         "{dof}, {depth});"
+         "{dof}, {depth}, 32, {minweight}, {roulette});"
          .format(scene="scene", camera=camera, depth=depth,
-                 dof=dofsamples))
+                 dof=dofsamples, minweight=minweight, roulette=roulette))
     return c
 
 def get_image():
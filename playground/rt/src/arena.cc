@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/arena.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace rt {
+
+constexpr size_t Arena::maxChunkSize;
+
+Arena::Arena(const size_t _chunkSize)
+    : next(nullptr), end(nullptr), chunkSize(_chunkSize),
+      _used(0), _reserved(0) {}
+
+Arena::~Arena() {
+  for (auto it = destructors.rbegin(); it != destructors.rend(); ++it)
+    it->destroy(it->value);
+  for (const auto chunk : chunks)
+    std::free(chunk);
+}
+
+void Arena::grow(const size_t size) {
+  const size_t n = std::max(chunkSize, size);
+  char *const chunk = static_cast<char *>(std::malloc(n));
+  if (!chunk)
+    throw std::bad_alloc();
+
+  chunks.push_back(chunk);
+  next = chunk;
+  end = chunk + n;
+  _reserved += n;
+  chunkSize = std::min(chunkSize * 2, maxChunkSize);
+}
+
+}  // namespace rt
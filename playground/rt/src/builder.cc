@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/builder.h"
+
+#include <stdexcept>
+
+namespace rt {
+
+SceneBuilder::SceneBuilder()
+    : arena(new Arena()), staging(new Arena()), _stats() {}
+
+std::unique_ptr<Scene> SceneBuilder::build() {
+  if (!arena)
+    throw std::logic_error("Scene has already been built");
+
+  // Build the BVH over the bounded objects in the order they were
+  // added.
+  std::vector<size_t> bounded, unbounded;
+  std::vector<BoundingBox> boxes;
+  BoundingBox box;
+  for (size_t i = 0; i < staged.size(); i++) {
+    if (staged[i].object->bounds(&box)) {
+      bounded.push_back(i);
+      boxes.push_back(box);
+    } else {
+      unbounded.push_back(i);
+    }
+  }
+  BVH bvh(boxes);
+
+  // Move bounded objects into the arena in leaf order, followed by
+  // the unbounded objects. The BVH's leaves then refer to bounded
+  // objects in order.
+  std::vector<Object *> objects;
+  objects.reserve(staged.size());
+  for (auto &index : bvh.indices) {
+    const Staged &s = staged[bounded[index]];
+    objects.push_back(s.relocate(s.object, arena.get()));
+    index = static_cast<uint32_t>(objects.size() - 1);
+  }
+  for (const auto i : unbounded)
+    objects.push_back(staged[i].relocate(staged[i].object, arena.get()));
+
+  staging.reset();
+  staged = std::vector<Staged>();
+
+  _stats.objects = objects.size();
+  _stats.lights = lights.size();
+  _stats.used = arena->used();
+  _stats.reserved = arena->reserved();
+
+  std::unique_ptr<Scene> scene(new Scene(objects, lights, std::move(bvh),
+                                         std::move(arena)));
+  _stats.time = timer.elapsed();
+
+  return scene;
+}
+
+}  // namespace rt
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/bvh.h"
+
+#include <algorithm>
+#include <array>
+
+namespace rt {
+
+namespace {
+
+// The number of buckets to bin centroids into when evaluating split
+// candidates with the surface area heuristic.
+static const size_t numBins = 12;
+
+// Relative cost of traversing a node vs. intersecting a primitive.
+static const Scalar traversalCost = 0.5;
+
+}  // namespace
+
+BVH::BVH(const std::vector<BoundingBox> &boxes)
+    : indices(boxes.size()) {
+  for (size_t i = 0; i < indices.size(); i++)
+    indices[i] = static_cast<uint32_t>(i);
+
+  if (boxes.empty())
+    return;
+
+  // A binary tree with at most one primitive per leaf has fewer than
+  // 2n nodes.
+  nodes.reserve(2 * boxes.size());
+  build(boxes, 0, boxes.size(), 0);
+}
+
+void BVH::build(const std::vector<BoundingBox> &boxes,
+                const size_t first, const size_t last,
+                const size_t depth) {
+  const size_t nodeIndex = nodes.size();
+  nodes.push_back(Node());
+
+  // Determine node bounds, and bounds of the primitive centroids.
+  BoundingBox box, centroids;
+  for (size_t i = first; i < last; i++) {
+    const BoundingBox &b = boxes[indices[i]];
+    const Scalar centre[3] = {b.centre(0), b.centre(1), b.centre(2)};
+    box.extend(b);
+    centroids.extend(centre);
+  }
+  nodes[nodeIndex].box = box;
+
+  const size_t count = last - first;
+  const size_t axis = centroids.longestAxis();
+  const Scalar extent = centroids.max[axis] - centroids.min[axis];
+
+  // Create a leaf if there are few enough primitives, we are too
+  // deep, or all of the centroids coincide.
+  if (count <= maxLeafSize || depth >= maxDepth - 1 || extent <= 0) {
+    nodes[nodeIndex].offset = static_cast<uint32_t>(first);
+    nodes[nodeIndex].count = static_cast<uint32_t>(count);
+    return;
+  }
+
+  // Bin primitives by centroid along the split axis.
+  const auto bin = [&](const uint32_t index) {
+    const Scalar c = boxes[index].centre(axis);
+    const size_t b = static_cast<size_t>(
+        numBins * (c - centroids.min[axis]) / extent);
+    return std::min(b, numBins - 1);
+  };
+
+  std::array<size_t, numBins> binCount{};
+  std::array<BoundingBox, numBins> binBox;
+  for (size_t i = first; i < last; i++) {
+    const size_t b = bin(indices[i]);
+    binCount[b]++;
+    binBox[b].extend(boxes[indices[i]]);
+  }
+
+  // Evaluate the cost of splitting after each bin, sweeping from
+  // the right to accumulate the right-hand side areas.
+  std::array<Scalar, numBins - 1> rightArea;
+  std::array<size_t, numBins - 1> rightCount;
+  BoundingBox right;
+  size_t n = 0;
+  for (size_t b = numBins - 1; b > 0; b--) {
+    right.extend(binBox[b]);
+    n += binCount[b];
+    rightArea[b - 1] = right.area();
+    rightCount[b - 1] = n;
+  }
+
+  BoundingBox left;
+  size_t leftCount = 0;
+  size_t bestSplit = 0;
+  Scalar bestCost = std::numeric_limits<Scalar>::max();
+  for (size_t b = 0; b < numBins - 1; b++) {
+    left.extend(binBox[b]);
+    leftCount += binCount[b];
+    const Scalar cost = left.area() * leftCount
+                        + rightArea[b] * rightCount[b];
+    if (cost < bestCost) {
+      bestCost = cost;
+      bestSplit = b;
+    }
+  }
+
+  // Compare against the cost of not splitting.
+  const Scalar area = box.area();
+  const Scalar splitCost = area > 0
+      ? traversalCost + bestCost / area
+      : std::numeric_limits<Scalar>::max();
+  if (count <= 2 * maxLeafSize && splitCost >= count) {
+    nodes[nodeIndex].offset = static_cast<uint32_t>(first);
+    nodes[nodeIndex].count = static_cast<uint32_t>(count);
+    return;
+  }
+
+  // Partition primitives about the split.
+  auto middle = std::partition(
+      indices.begin() + static_cast<std::ptrdiff_t>(first),
+      indices.begin() + static_cast<std::ptrdiff_t>(last),
+      [&](const uint32_t index) { return bin(index) <= bestSplit; });
+  size_t mid = static_cast<size_t>(middle - indices.begin());
+
+  // Guard against a degenerate partition by splitting in half.
+  if (mid == first || mid == last) {
+    mid = first + count / 2;
+    std::nth_element(
+        indices.begin() + static_cast<std::ptrdiff_t>(first),
+        indices.begin() + static_cast<std::ptrdiff_t>(mid),
+        indices.begin() + static_cast<std::ptrdiff_t>(last),
+        [&](const uint32_t a, const uint32_t b) {
+          return boxes[a].centre(axis) < boxes[b].centre(axis);
+        });
+  }
+
+  // Left child is stored immediately after this node.
+  build(boxes, first, mid, depth + 1);
+  nodes[nodeIndex].offset = static_cast<uint32_t>(nodes.size());
+  nodes[nodeIndex].count = 0;
+  build(boxes, mid, last, depth + 1);
+}
+
+}  // namespace rt
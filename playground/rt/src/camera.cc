@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/camera.h"
+
+#include <cmath>
+
+namespace rt {
+
+namespace {
+
+// Return the lens sample offsets of a camera.
+std::vector<Vector> lensTable(const Camera &camera, const size_t samples) {
+  static const Scalar goldenAngle = static_cast<Scalar>(
+      M_PI * (3 - std::sqrt(5.0)));
+  const Scalar radius = camera.lens.aperture.radius();
+  std::vector<Vector> lens;
+
+  if (samples <= 1) {
+    lens.push_back(Vector(0, 0, 0));
+    return lens;
+  }
+
+  for (size_t i = 0; i < samples; i++) {
+    const Scalar r = radius * std::sqrt((i + Scalar(.5)) / samples);
+    const Scalar theta = goldenAngle * i;
+    lens.push_back(camera.right * (r * std::cos(theta))
+                   + camera.up * (r * std::sin(theta)));
+  }
+
+  return lens;
+}
+
+}  // namespace
+
+CameraRays::CameraRays(const Camera &camera, const size_t width,
+                       const size_t height, const size_t samples)
+    : origin(camera.position - camera.right * (camera.width / 2)
+             - camera.up * (camera.height / 2)),
+      column(camera.right * (camera.width / width)),
+      row(camera.up * (camera.height / height)),
+      filmBack(camera.filmBack),
+      focusDistance(camera.focusDistance),
+      lens(lensTable(camera, samples)) {}
+
+}  // namespace rt
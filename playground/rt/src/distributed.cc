@@ -0,0 +1,466 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/distributed.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+
+#ifdef USE_TBB
+#include "tbb/task_arena.h"
+#endif  // USE_TBB
+
+namespace rt {
+
+namespace {
+
+// Messages. A worker sends a Hello on connecting, and then a Response
+// followed by 3 Scalars per pixel for each Request it receives. Both
+// ends must be builds of the same precision.
+static const uint32_t helloMagic = 0x4b575452;  // "RTWK"
+static const uint32_t protocolVersion = 1;
+
+struct Hello {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t scalarSize;
+};
+
+struct Request {
+  uint32_t id;
+  uint32_t width;
+  uint32_t height;
+  uint32_t x;
+  uint32_t y;
+  uint32_t w;
+  uint32_t h;
+};
+
+// The wall clock time taken by the worker to render the tile.
+struct Response {
+  uint32_t id;
+  uint32_t count;
+  uint64_t microseconds;
+};
+
+// The maximum number of tiles sent to a worker at once. More than
+// one hides the round trip between tiles.
+static const size_t maxInflight = 2;
+
+#ifdef MSG_NOSIGNAL
+static const int sendFlags = MSG_NOSIGNAL;
+#else
+static const int sendFlags = 0;
+#endif
+
+// Throw an error describing the last failed system call.
+[[noreturn]] void fail(const std::string &what, const std::string &path) {
+  throw std::runtime_error(what + " '" + path + "': "
+                           + std::strerror(errno));
+}
+
+// Read exactly n bytes. Returns false on end of file or error.
+bool readAll(const int fd, void *const data, const size_t n) {
+  char *p = static_cast<char *>(data);
+  size_t remaining = n;
+
+  while (remaining) {
+    const ssize_t r = read(fd, p, remaining);
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r <= 0)
+      return false;
+    p += r;
+    remaining -= static_cast<size_t>(r);
+  }
+
+  return true;
+}
+
+// Write exactly n bytes. Returns false on error.
+bool writeAll(const int fd, const void *const data, const size_t n) {
+  const char *p = static_cast<const char *>(data);
+  size_t remaining = n;
+
+  while (remaining) {
+    const ssize_t r = send(fd, p, remaining, sendFlags);
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r <= 0)
+      return false;
+    p += r;
+    remaining -= static_cast<size_t>(r);
+  }
+
+  return true;
+}
+
+// Return the socket address of a path.
+sockaddr_un address(const std::string &path) {
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+
+  if (path.size() >= sizeof(addr.sun_path))
+    throw std::runtime_error("Socket path '" + path + "' is too long");
+  std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+  return addr;
+}
+
+}  // namespace
+
+Scalar DistributedStats::efficiency() const {
+  profiling::Counter busy = 0;
+  for (const auto &worker : workers)
+    busy += worker.busy;
+
+  return time > 0 && !workers.empty()
+      ? static_cast<Scalar>(busy / 1e6 / (time * workers.size()))
+      : 0;
+}
+
+TileCoordinator::TileCoordinator(const std::string &_path,
+                                 const size_t workers,
+                                 const size_t _tileSize,
+                                 const size_t _timeout)
+    : path(_path), numWorkers(workers), tileSize(_tileSize),
+      timeout(_timeout), nextId(0) {
+  if (!tileSize)
+    throw std::invalid_argument("Tile size must be non-zero");
+
+  const sockaddr_un addr = address(path);
+
+  listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0)
+    fail("Failed to create socket", path);
+
+  unlink(path.c_str());
+  if (bind(listener, reinterpret_cast<const sockaddr *>(&addr),
+           sizeof(addr)) ||
+      listen(listener, static_cast<int>(workers))) {
+    close(listener);
+    fail("Failed to listen on", path);
+  }
+}
+
+TileCoordinator::~TileCoordinator() {
+  for (auto &connection : connections)
+    disconnect(&connection);
+  close(listener);
+  unlink(path.c_str());
+}
+
+void TileCoordinator::accept() {
+  using clock = std::chrono::steady_clock;
+  const clock::time_point deadline =
+      clock::now() + std::chrono::seconds(timeout);
+
+  while (connections.size() < numWorkers) {
+    // Workers which are already waiting are accepted after the
+    // deadline.
+    const auto remaining = std::chrono::duration_cast<
+        std::chrono::milliseconds>(deadline - clock::now()).count();
+    pollfd pending = {listener, POLLIN, 0};
+    const int ready = poll(&pending, 1, static_cast<int>(
+        std::max<decltype(remaining)>(remaining, 0)));
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready < 0)
+      fail("Failed to poll for workers on", path);
+    if (!ready)
+      throw std::runtime_error("Timed out waiting for workers on '"
+                               + path + "'");
+
+    const int fd = ::accept(listener, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR)
+        continue;
+      fail("Failed to accept worker on", path);
+    }
+
+    // A worker which stops part way through a message is dropped.
+    timeval limit = {static_cast<time_t>(timeout), 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &limit, sizeof(limit));
+
+    Hello hello;
+    if (!readAll(fd, &hello, sizeof(hello)) ||
+        hello.magic != helloMagic ||
+        hello.version != protocolVersion ||
+        hello.scalarSize != sizeof(Scalar)) {
+      // Turn the worker away, and wait for another.
+      close(fd);
+      continue;
+    }
+
+    connections.push_back({fd, {}});
+  }
+}
+
+void TileCoordinator::disconnect(Connection *const connection) {
+  if (connection->fd >= 0)
+    close(connection->fd);
+  connection->fd = -1;
+}
+
+DistributedStats TileCoordinator::render(std::vector<Colour> *const pixels,
+                                         const size_t width,
+                                         const size_t height) {
+  accept();
+
+  const profiling::Timer timer;
+
+  struct Tile {
+    uint32_t x, y, w, h;
+    bool done;
+    size_t assigned;
+  };
+
+  std::vector<Tile> tiles;
+  for (size_t y = 0; y < height; y += tileSize)
+    for (size_t x = 0; x < width; x += tileSize)
+      tiles.push_back({static_cast<uint32_t>(x), static_cast<uint32_t>(y),
+                       static_cast<uint32_t>(std::min(tileSize, width - x)),
+                       static_cast<uint32_t>(std::min(tileSize, height - y)),
+                       false, 0});
+
+  const uint32_t first = nextId;
+  nextId += static_cast<uint32_t>(tiles.size());
+  const auto current = [&](const uint32_t id) {
+    return id - first < tiles.size();
+  };
+
+  DistributedStats stats;
+  stats.tiles = tiles.size();
+  stats.reissued = 0;
+  stats.workers.assign(connections.size(), {0, 0, true});
+
+  std::deque<size_t> pending;
+  for (size_t i = 0; i < tiles.size(); i++)
+    pending.push_back(i);
+  size_t remaining = tiles.size();
+
+  pixels->assign(width * height, Colour());
+
+  // Close a connection, and hand out its tiles again.
+  const auto lost = [&](Connection *const connection) {
+    disconnect(connection);
+    for (const auto id : connection->inflight)
+      if (current(id) && !tiles[id - first].done)
+        pending.push_front(id - first);
+    connection->inflight.clear();
+  };
+
+  std::vector<Scalar> buffer;
+  std::vector<pollfd> fds;
+  std::vector<size_t> polled;
+
+  while (remaining) {
+    // Keep every worker busy.
+    for (auto &connection : connections) {
+      while (connection.fd >= 0 && connection.inflight.size() < maxInflight) {
+        size_t tile = tiles.size();
+
+        if (!pending.empty()) {
+          tile = pending.front();
+          pending.pop_front();
+        } else if (connection.inflight.empty()) {
+          // Duplicate the outstanding tile which has been sent to the
+          // fewest workers.
+          for (size_t i = 0; i < tiles.size(); i++)
+            if (!tiles[i].done && (tile == tiles.size() ||
+                                   tiles[i].assigned < tiles[tile].assigned))
+              tile = i;
+          if (tile < tiles.size())
+            stats.reissued++;
+        }
+
+        if (tile == tiles.size())
+          break;
+
+        const Tile &t = tiles[tile];
+        const Request request = {first + static_cast<uint32_t>(tile),
+                                 static_cast<uint32_t>(width),
+                                 static_cast<uint32_t>(height),
+                                 t.x, t.y, t.w, t.h};
+        connection.inflight.push_back(request.id);
+        tiles[tile].assigned++;
+
+        if (!writeAll(connection.fd, &request, sizeof(request)))
+          lost(&connection);
+      }
+    }
+
+    // Wait for results.
+    fds.clear();
+    polled.clear();
+    for (size_t i = 0; i < connections.size(); i++) {
+      if (connections[i].fd >= 0) {
+        fds.push_back({connections[i].fd, POLLIN, 0});
+        polled.push_back(i);
+      }
+    }
+
+    if (fds.empty())
+      throw std::runtime_error("Every worker on '" + path
+                               + "' has disconnected");
+
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      fail("Failed to poll workers on", path);
+    }
+
+    for (size_t i = 0; i < fds.size(); i++) {
+      if (!fds[i].revents)
+        continue;
+
+      Connection &connection = connections[polled[i]];
+      DistributedStats::Worker &worker = stats.workers[polled[i]];
+
+      Response response;
+      if (!readAll(connection.fd, &response, sizeof(response))) {
+        lost(&connection);
+        continue;
+      }
+
+      // Drop a worker which answers a tile it was not sent, or with
+      // the wrong number of pixels, before reading its payload. The
+      // size of a previous frame's tile is no longer known, so is
+      // only bounded.
+      const auto it = std::find(connection.inflight.begin(),
+                                connection.inflight.end(), response.id);
+      const size_t count = size_t(response.count);
+      if (it == connection.inflight.end() ||
+          (current(response.id)
+           ? count != size_t(tiles[response.id - first].w) *
+                      tiles[response.id - first].h
+           : count > tileSize * tileSize)) {
+        lost(&connection);
+        continue;
+      }
+
+      buffer.resize(3 * count);
+      if (!readAll(connection.fd, buffer.data(),
+                   buffer.size() * sizeof(Scalar))) {
+        lost(&connection);
+        continue;
+      }
+      connection.inflight.erase(it);
+
+      // Ignore late duplicates of previous frames' tiles.
+      if (!current(response.id))
+        continue;
+
+      worker.tiles++;
+      worker.busy += response.microseconds;
+
+      Tile &tile = tiles[response.id - first];
+      if (tile.done)
+        continue;
+
+      for (size_t j = 0; j < response.count; j++) {
+        const size_t x = tile.x + j % tile.w;
+        const size_t y = tile.y + j / tile.w;
+        (*pixels)[image::index(x, y, width)] =
+            Colour(buffer[3 * j], buffer[3 * j + 1], buffer[3 * j + 2]);
+      }
+      tile.done = true;
+      remaining--;
+    }
+  }
+
+  for (size_t i = 0; i < connections.size(); i++)
+    stats.workers[i].alive = connections[i].fd >= 0;
+  stats.time = static_cast<Scalar>(timer.microseconds() / 1e6);
+
+  return stats;
+}
+
+namespace distributed {
+
+void serve(const std::string &path, const Renderer &renderer,
+           const size_t threads) {
+  const sockaddr_un addr = address(path);
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    fail("Failed to create socket", path);
+
+  if (connect(fd, reinterpret_cast<const sockaddr *>(&addr),
+              sizeof(addr))) {
+    close(fd);
+    fail("Failed to connect to", path);
+  }
+
+  const Hello hello = {helloMagic, protocolVersion,
+                       static_cast<uint32_t>(sizeof(Scalar))};
+  std::vector<Colour> pixels;
+  std::vector<Scalar> buffer;
+  Request request;
+
+#ifdef USE_TBB
+  tbb::task_arena arena(threads ? static_cast<int>(threads)
+                                : tbb::task_arena::automatic);
+#endif  // USE_TBB
+
+  bool connected = writeAll(fd, &hello, sizeof(hello));
+  while (connected && readAll(fd, &request, sizeof(request))) {
+    const auto start = std::chrono::steady_clock::now();
+    const auto render = [&]() {
+      renderer.renderTile(&pixels, request.width, request.height,
+                          request.x, request.y, request.w, request.h);
+    };
+#ifdef USE_TBB
+    arena.execute(render);
+#else  // USE_TBB
+    render();
+#endif  // USE_TBB
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    buffer.resize(3 * pixels.size());
+    for (size_t i = 0; i < pixels.size(); i++) {
+      buffer[3 * i] = pixels[i].r;
+      buffer[3 * i + 1] = pixels[i].g;
+      buffer[3 * i + 2] = pixels[i].b;
+    }
+
+    const Response response = {
+        request.id, static_cast<uint32_t>(pixels.size()),
+        static_cast<uint64_t>(std::chrono::duration_cast<
+            std::chrono::microseconds>(elapsed).count())};
+    connected = writeAll(fd, &response, sizeof(response)) &&
+                writeAll(fd, buffer.data(), buffer.size() * sizeof(Scalar));
+  }
+
+  close(fd);
+}
+
+}  // namespace distributed
+
+}  // namespace rt
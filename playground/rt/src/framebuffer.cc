@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/framebuffer.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace rt {
+
+namespace {
+
+// Throw an error describing the last failed system call.
+[[noreturn]] void fail(const std::string &what, const std::string &path) {
+  throw std::runtime_error(what + " '" + path + "': "
+                           + std::strerror(errno));
+}
+
+}  // namespace
+
+MappedFramebuffer::MappedFramebuffer(const std::string &_path,
+                                     const size_t _width,
+                                     const size_t _height)
+    : path(_path), width(_width), height(_height), fd(-1), map(nullptr) {
+  const std::string header = "P6\n" + std::to_string(width) + " "
+                             + std::to_string(height) + "\n255\n";
+  headerSize = header.size();
+  fileSize = headerSize + width * height * sizeof(Pixel);
+
+  fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    fail("Failed to open", path);
+
+  if (ftruncate(fd, static_cast<off_t>(fileSize))) {
+    close(fd);
+    fail("Failed to resize", path);
+  }
+
+  void *const addr = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE,
+                          MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    close(fd);
+    fail("Failed to map", path);
+  }
+  map = static_cast<char *>(addr);
+
+  std::memcpy(map, header.data(), headerSize);
+}
+
+MappedFramebuffer::~MappedFramebuffer() {
+  munmap(map, fileSize);
+  close(fd);
+}
+
+void MappedFramebuffer::write(const Pixel *const data) {
+  std::memcpy(map + headerSize, data, width * height * sizeof(Pixel));
+}
+
+void MappedFramebuffer::sync() {
+  if (msync(map, fileSize, MS_SYNC))
+    fail("Failed to sync", path);
+}
+
+}  // namespace rt
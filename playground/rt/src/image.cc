@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/image.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace rt {
+
+namespace image {
+
+namespace {
+
+// Throw an error describing the last failed system call.
+[[noreturn]] void fail(const std::string &what, const std::string &path) {
+  throw std::runtime_error(what + " '" + path + "': "
+                           + std::strerror(errno));
+}
+
+// A file descriptor which is closed on destruction.
+class File {
+ public:
+  const std::string path;
+  const int fd;
+
+  explicit File(const std::string &_path)
+      : path(_path),
+        fd(open(_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)) {
+    if (fd < 0)
+      fail("Failed to open", path);
+  }
+
+  ~File() { close(fd); }
+
+  // Write a list of buffers, in at most IOV_MAX buffers per call.
+  // Resumes after short writes.
+  void write(std::vector<iovec> *const buffers) {
+    size_t first = 0;
+
+    while (first < buffers->size()) {
+      const size_t n = std::min(buffers->size() - first,
+                                static_cast<size_t>(IOV_MAX));
+      ssize_t written = writev(fd, &(*buffers)[first],
+                               static_cast<int>(n));
+      if (written < 0) {
+        if (errno == EINTR)
+          continue;
+        fail("Failed to write", path);
+      }
+
+      // Skip over the buffers which were written.
+      while (first < buffers->size() &&
+             static_cast<size_t>(written) >= (*buffers)[first].iov_len) {
+        written -= (*buffers)[first].iov_len;
+        first++;
+      }
+      if (written > 0) {
+        iovec &buffer = (*buffers)[first];
+        buffer.iov_base = static_cast<char *>(buffer.iov_base) + written;
+        buffer.iov_len -= static_cast<size_t>(written);
+      }
+    }
+  }
+};
+
+}  // namespace
+
+void writeP6(const std::string &path,
+             const size_t width,
+             const size_t height,
+             const Pixel *const data) {
+  static_assert(sizeof(Pixel) == 3,
+                "Pixel data must be packed 8 bit RGB triplets");
+
+  std::string header = "P6\n" + std::to_string(width) + " "
+                       + std::to_string(height) + "\n255\n";
+
+  std::vector<iovec> buffers = {
+    {&header[0], header.size()},
+    {const_cast<Pixel *>(data), width * height * sizeof(Pixel)}
+  };
+
+  File(path).write(&buffers);
+}
+
+void writePFM(const std::string &path,
+              const size_t width,
+              const size_t height,
+              const float *const data) {
+  // The sign of the scale gives the byte order of the data.
+  const uint16_t one = 1;
+  const bool littleEndian = *reinterpret_cast<const uint8_t *>(&one);
+  std::string header = "PF\n" + std::to_string(width) + " "
+                       + std::to_string(height)
+                       + (littleEndian ? "\n-1.0\n" : "\n1.0\n");
+
+  std::vector<iovec> buffers;
+  buffers.reserve(height + 1);
+  buffers.push_back({&header[0], header.size()});
+  for (size_t y = height; y-- > 0;)
+    buffers.push_back({const_cast<float *>(data + 3 * width * y),
+                       3 * width * sizeof(float)});
+
+  File(path).write(&buffers);
+}
+
+}  // namespace image
+
+}  // namespace rt
@@ -19,6 +19,7 @@
 #include "rt/lights.h"
 
 #include <algorithm>
+#include <vector>
 
 #include "rt/profiling.h"
 
@@ -26,74 +27,143 @@ namespace rt {
 
 namespace {
 
-// Return whether a given ray intersects any of the objects within a
-// given distance.
-bool intersects(const Ray &ray,
-                const Objects &objects,
-                const Scalar distance) {
-  // Determine any object intersects ray within distance:
-  for (size_t i = 0; i < objects.size(); i++) {
-    const Scalar t = objects[i]->intersect(ray);
-    if (t > 0 && t < distance)
-      return true;
-  }
+// The object which last blocked each light's shadow rays on this
+// thread, indexed by light id, so the table grows no larger than the
+// most lights in a scene. Occluders are only hints, so entries which
+// refer to another scene's objects are harmless.
+thread_local std::vector<size_t> occluders;
 
-  // No intersect.
-  return false;
+size_t *lastOccluder(const size_t id) {
+  if (id >= occluders.size())
+    occluders.resize(id + 1, ObjectIndex::noOccluder);
+  return &occluders[id];
 }
 
 }  // namespace
 
+size_t SoftLight::stratify(const size_t samples,
+                           const size_t minSamples) {
+  size_t strata = 0;
+  while ((strata + 1) * (strata + 1) * (strata + 1) <= minSamples)
+    strata++;
+
+  return strata * strata * strata < samples ? strata : 0;
+}
+
+bool SoftLight::cast(const Vector &origin,
+                     const Vector &point,
+                     const Vector &normal,
+                     const Vector &toRay,
+                     const Material *const restrict material,
+                     const ObjectIndex &objects,
+                     const Colour &illumination,
+                     size_t *const restrict occluder,
+                     Colour *const restrict output) const {
+  // Vector from point to light.
+  const Vector toLight = origin - point;
+  // Distance from point to light.
+  const Scalar distance = toLight.size();
+  // Direction from point to light.
+  const Vector direction = toLight / distance;
+
+  // Determine whether light is blocked.
+  const bool blocked = objects.intersects(Ray(point, direction),
+                                          distance, occluder);
+  // Do nothing without line of sight.
+  if (blocked) {
+    profiling::counters::incShadowHitCount();
+    return false;
+  }
+
+  // Bump the profiling counters.
+  profiling::counters::incShadowMissCount();
+  profiling::counters::incRayCount();
+
+  // Apply Lambert (diffuse) shading.
+  const Scalar lambert = std::max(normal ^ direction,
+                                  static_cast<Scalar>(0));
+  *output += illumination * material->diffuse * lambert;
+
+  // Apply Blinn-Phong (specular) shading.
+  const Vector bisector = (toRay + direction).normalise();
+  const Scalar phong = std::pow(std::max(normal ^ bisector,
+                                         static_cast<Scalar>(0)),
+                                material->shininess);
+  *output += illumination * material->specular * phong;
+
+  return true;
+}
+
 Colour SoftLight::shade(const Vector &point,
                         const Vector &normal,
                         const Vector &toRay,
                         const Material *const restrict material,
-                        const Objects objects) const {
+                        const ObjectIndex &objects,
+                        RandomStream &rng) const {
   // Shading is additive, starting with black.
   Colour output = Colour();
 
-  // Product of material and light colour.
-  const Colour illumination = (colour * material->colour) / samples;
-
-  // Cast multiple light rays, nomrally distributed about the
-  // light's centre.
-  for (size_t i = 0; i < samples; i++) {
-    // Create a new point origin randomly offset from centre.
-    const Vector origin = Vector(position.x + sampler(),
-                                 position.y + sampler(),
-                                 position.z + sampler());
-    // Vector from point to light.
-    const Vector toLight = origin - point;
-    // Distance from point to light.
-    const Scalar distance = toLight.size();
-    // Direction from point to light.
-    const Vector direction = toLight / distance;
-
-    // Determine whether light is blocked.
-    const bool blocked = intersects(Ray(point, direction),
-                                    objects, distance);
-    // Do nothing without line of sight.
-    if (blocked)
-      continue;
-
-    // Bump the profiling counter.
-    profiling::counters::incRayCount();
-
-    // Apply Lambert (diffuse) shading.
-    const Scalar lambert = std::max(normal ^ direction,
-                                    static_cast<Scalar>(0));
-    output += illumination * material->diffuse * lambert;
-
-    // Apply Blinn-Phong (specular) shading.
-    const Vector bisector = (toRay + direction).normalise();
-    const Scalar phong = pow(std::max(normal ^ bisector,
-                                      static_cast<Scalar>(0)),
-                             material->shininess);
-    output += illumination * material->specular * phong;
+  // Return a point randomly offset from the light's centre.
+  const auto random = [&]() {
+    return Vector(position.x + sampler(rng),
+                  position.y + sampler(rng),
+                  position.z + sampler(rng));
+  };
+
+  profiling::counters::incShadowPointCount();
+
+  size_t *const occluder = lastOccluder(id);
+
+  if (!strata) {
+    // Product of material and light colour.
+    const Colour illumination = (colour * material->colour) / samples;
+
+    // Cast multiple light rays, nomrally distributed about the
+    // light's centre.
+    for (size_t i = 0; i < samples; i++)
+      cast(random(), point, normal, toRay, material, objects,
+           illumination, occluder, &output);
+
+    return output;
   }
 
-  return output;
-}
+  // Adaptive sampling accumulates unscaled shading, since the number
+  // of samples is not known in advance.
+  const Colour illumination = colour * material->colour;
+  const size_t batch = strata * strata * strata;
+  const Scalar cell = 2 * radius / strata;
+  size_t visible = 0;
+
+  // Cast the first batch with one jittered ray per cell of a
+  // strata^3 grid over the light.
+  for (size_t z = 0; z < strata; z++) {
+    for (size_t y = 0; y < strata; y++) {
+      for (size_t x = 0; x < strata; x++) {
+        const Vector origin(
+            position.x - radius + cell * x + (sampler(rng) + radius) / strata,
+            position.y - radius + cell * y + (sampler(rng) + radius) / strata,
+            position.z - radius + cell * z + (sampler(rng) + radius) / strata);
+
+        if (cast(origin, point, normal, toRay, material, objects,
+                 illumination, occluder, &output))
+          visible++;
+      }
+    }
+  }
+
+  // The variance of the batch's visibility, which is 0 if every ray
+  // agreed.
+  const Scalar p = static_cast<Scalar>(visible) / batch;
+  if (p * (1 - p) <= threshold)
+    return output / batch;
 
+  // Penumbra: cast the remaining rays.
+  profiling::counters::incPenumbraCount();
+  for (size_t i = batch; i < samples; i++)
+    cast(random(), point, normal, toRay, material, objects,
+         illumination, occluder, &output);
+
+  return output / samples;
+}
 
 }  // namespace rt
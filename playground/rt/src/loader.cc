@@ -0,0 +1,849 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/loader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace rt {
+
+namespace {
+
+/*
+ * Parsing.
+ */
+
+// A token of a scene file, and where it came from.
+class Token {
+ public:
+  std::string text;
+  std::string file;
+  size_t line;
+};
+
+// Throw a parse error at a token.
+[[noreturn]] void error(const Token &token, const std::string &message) {
+  throw std::runtime_error(token.file + ":" + std::to_string(token.line)
+                           + ": " + message);
+}
+
+std::string lower(std::string s) {
+  std::transform(s.begin(), s.end(), s.begin(),
+                 [](const unsigned char c) { return std::tolower(c); });
+  return s;
+}
+
+// Return the contents of a file.
+std::string read(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    throw std::runtime_error("Failed to open '" + path + "'");
+
+  std::stringstream contents;
+  contents << in.rdbuf();
+  return contents.str();
+}
+
+// The 64 bit FNV-1a hash of a string.
+uint64_t hash(const std::string &text) {
+  uint64_t h = 0xcbf29ce484222325;
+  for (const char c : text) {
+    h ^= static_cast<unsigned char>(c);
+    h *= 0x100000001b3;
+  }
+  return h;
+}
+
+// Split the text of a file into whitespace separated tokens, dropping
+// comments. Quoted strings are a single token.
+void tokenise(const std::string &path, const std::string &text,
+              std::vector<Token> *const tokens) {
+  bool inQuotes = false;
+  bool inComment = false;
+  size_t line = 1;
+  Token token{"", path, line};
+
+  const auto flush = [&]() {
+    if (!token.text.empty())
+      tokens->push_back(token);
+    token.text.clear();
+    token.line = line;
+  };
+
+  for (const char c : text) {
+    if (c == '\n' || c == '\r') {
+      inComment = false;
+      if (inQuotes) {
+        token.text += c;
+      } else {
+        flush();
+      }
+      if (c == '\n')
+        token.line = ++line;
+    } else if (inComment) {
+      continue;
+    } else if (c == '"') {
+      flush();
+      inQuotes = !inQuotes;
+    } else if (inQuotes) {
+      token.text += c;
+    } else if (c == '#') {
+      flush();
+      inComment = true;
+    } else if (c == ' ' || c == '\t') {
+      flush();
+    } else {
+      if (token.text.empty())
+        token.line = line;
+      token.text += c;
+    }
+  }
+  flush();
+}
+
+// The directory of a path, including the trailing separator.
+std::string dirname(const std::string &path) {
+  const size_t i = path.rfind('/');
+  return i == std::string::npos ? "" : path.substr(0, i + 1);
+}
+
+// Tokenise a file, expanding @def macros and @import directives, and
+// record each file read.
+void preprocess(const std::string &path,
+                std::map<std::string, std::string> *const macros,
+                std::vector<Token> *const out,
+                std::vector<SceneDescription::Source> *const sources,
+                const size_t depth = 0) {
+  if (depth > 16)
+    throw std::runtime_error("Too many nested imports in '" + path + "'");
+
+  const std::string text = read(path);
+  sources->push_back({path, text.size(), hash(text)});
+
+  std::vector<Token> tokens;
+  tokenise(path, text, &tokens);
+
+  for (size_t i = 0; i < tokens.size(); i++) {
+    Token token = tokens[i];
+
+    // Expand macros, which may refer to other macros.
+    for (size_t n = 0; token.text[0] == '@' && n < 16; n++) {
+      const auto macro = macros->find(token.text.substr(1));
+      if (macro == macros->end())
+        break;
+      token.text = macro->second;
+    }
+
+    const std::string keyword = lower(token.text);
+    if (keyword == "@def") {
+      if (i + 2 >= tokens.size())
+        error(token, "@def requires a name and a value");
+      (*macros)[tokens[i + 1].text] = tokens[i + 2].text;
+      i += 2;
+    } else if (keyword == "@import") {
+      if (i + 1 >= tokens.size())
+        error(token, "@import requires a path");
+      const std::string &import = tokens[++i].text;
+      preprocess(import[0] == '/' ? import : dirname(path) + import,
+                 macros, out, sources, depth + 1);
+    } else {
+      out->push_back(token);
+    }
+  }
+}
+
+// A [Section] and its key value pairs. Keys are lower case.
+class Section {
+ public:
+  Token name;
+  std::map<std::string, std::vector<Token>> pairs;
+
+  // Remove and return the value of a key, or an empty list if the key
+  // is not set.
+  std::vector<Token> consume(const std::string &key) {
+    const auto it = pairs.find(key);
+    if (it == pairs.end())
+      return {};
+
+    const std::vector<Token> value = it->second;
+    pairs.erase(it);
+    return value;
+  }
+
+  Scalar scalar(const std::string &key, const Scalar fallback) {
+    const std::vector<Token> value = consume(key);
+    if (value.empty())
+      return fallback;
+    if (value.size() != 1)
+      error(value[0], "Expected a single number for '" + key + "'");
+    return number(value[0]);
+  }
+
+  Scalar percent(const std::string &key, const Scalar fallback) {
+    return scalar(key, fallback * 100) / 100;
+  }
+
+  size_t integer(const std::string &key, const size_t fallback) {
+    const Scalar value = scalar(key, static_cast<Scalar>(fallback));
+    if (value < 0)
+      error(name, "Expected a positive integer for '" + key + "'");
+    return static_cast<size_t>(value);
+  }
+
+  void vector(const std::string &key, Scalar out[3]) {
+    const std::vector<Token> value = consume(key);
+    if (value.empty()) {
+      out[0] = out[1] = out[2] = 0;
+      return;
+    }
+    if (value.size() != 3)
+      error(value[0], "Expected three numbers for '" + key + "'");
+    for (size_t i = 0; i < 3; i++)
+      out[i] = number(value[i]);
+  }
+
+  void colour(const std::string &key, Scalar out[3]) {
+    const std::vector<Token> value = consume(key);
+    const Colour c(value.empty() ? 0 : hex(value));
+    out[0] = c.r;
+    out[1] = c.g;
+    out[2] = c.b;
+  }
+
+  std::string string(const std::string &key, const std::string &fallback) {
+    const std::vector<Token> value = consume(key);
+    if (value.empty())
+      return fallback;
+    if (value.size() != 1)
+      error(value[0], "Expected a single value for '" + key + "'");
+    return value[0].text;
+  }
+
+  // Return the first token of a value, or the section name if the
+  // key has no value.
+  Token token(const std::string &key) const {
+    const auto it = pairs.find(key);
+    return it == pairs.end() || it->second.empty()
+        ? name : it->second.front();
+  }
+
+  // Return the name of a reference of the form $Kind.name.
+  std::string reference(const std::string &key, const std::string &kind) {
+    const std::vector<Token> value = consume(key);
+    if (value.size() != 1)
+      error(value.empty() ? name : value[0],
+            "Expected a $" + kind + " reference for '" + key + "'");
+
+    const std::string prefix = "$" + kind + ".";
+    const std::string ref = lower(value[0].text);
+    if (ref.compare(0, prefix.size(), prefix))
+      error(value[0], "Expected a $" + kind + " reference for '" + key
+            + "', not '" + value[0].text + "'");
+    return ref.substr(prefix.size());
+  }
+
+  // Throw an error if any keys were not consumed.
+  void finish() const {
+    if (!pairs.empty())
+      error(pairs.begin()->second.empty()
+            ? name : pairs.begin()->second[0],
+            "Unrecognised attribute '" + pairs.begin()->first + "' in ["
+            + name.text + "]");
+  }
+
+ private:
+  static Scalar number(const Token &token) {
+    size_t end = 0;
+    double value = 0;
+    try {
+      value = std::stod(token.text, &end);
+    } catch (const std::logic_error&) {
+      end = 0;
+    }
+    if (end != token.text.size())
+      error(token, "Invalid number '" + token.text + "'");
+    return static_cast<Scalar>(value);
+  }
+
+  static int hex(const std::vector<Token> &value) {
+    const std::string &text = value[0].text;
+    if (value.size() != 1 || text.size() != 8 || lower(text.substr(0, 2))
+        != "0x" || text.find_first_not_of("0123456789abcdefABCDEF", 2)
+        != std::string::npos)
+      error(value[0], "Unrecognised colour '" + text + "'");
+    return static_cast<int>(std::stol(text, nullptr, 16));
+  }
+};
+
+// Group tokens into sections.
+std::vector<Section> sections(const std::vector<Token> &tokens) {
+  std::vector<Section> out;
+  std::string key;
+
+  for (const auto &token : tokens) {
+    const std::string &text = token.text;
+
+    if (text.front() == '[' && text.back() == ']') {
+      out.push_back(Section{token, {}});
+      out.back().name.text = text.substr(1, text.size() - 2);
+      key.clear();
+    } else if (out.empty()) {
+      error(token, "Expected a [Section]");
+    } else if (text.back() == ':') {
+      key = lower(text.substr(0, text.size() - 1));
+      if (out.back().pairs.count(key))
+        error(token, "Duplicate key '" + key + "'");
+      out.back().pairs[key];
+    } else if (key.empty()) {
+      error(token, "Value without key '" + text + "'");
+    } else {
+      out.back().pairs[key].push_back(token);
+    }
+  }
+
+  return out;
+}
+
+// Return whether a string starts with a prefix, and if so, set `rest'
+// to the remainder.
+bool startsWith(const std::string &s, const std::string &prefix,
+                std::string *const rest) {
+  if (s.compare(0, prefix.size(), prefix))
+    return false;
+  *rest = s.substr(prefix.size());
+  return true;
+}
+
+/*
+ * Caching.
+ */
+
+// The cache file header. Caches are only read by builds with the same
+// version, scalar type and byte order.
+struct CacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint64_t scalarSize;
+  uint64_t numMaterials;
+  uint64_t numObjects;
+  uint64_t numLights;
+  uint64_t numNodes;
+  uint64_t numIndices;
+  uint64_t pathSize;
+  uint64_t numSources;
+  SceneDescription::CameraRecord camera;
+  SceneDescription::SettingsRecord settings;
+};
+
+static const char cacheMagic[8] = "RTSCENE";
+static const uint32_t cacheVersion = 4;
+
+// Each source file follows the image path in the cache, as this
+// header and then its path.
+struct CacheSource {
+  uint64_t size;
+  uint64_t hash;
+  uint64_t pathSize;
+};
+
+// Return whether a source file still has the contents it was parsed
+// from.
+bool fresh(const SceneDescription::Source &source) {
+  try {
+    const std::string text = read(source.path);
+    return text.size() == source.size && hash(text) == source.hash;
+  } catch (const std::runtime_error&) {
+    return false;
+  }
+}
+static const uint32_t cacheByteOrder = 0x01020304;
+
+// Write an array of records to a stream.
+template<typename T>
+void writeArray(std::ostream &out, const std::vector<T> &values) {
+  out.write(reinterpret_cast<const char *>(values.data()),
+            static_cast<std::streamsize>(values.size() * sizeof(T)));
+}
+
+// A read-only memory mapped file, which is unmapped on destruction.
+class MappedFile {
+ public:
+  const char *data;
+  size_t size;
+
+  explicit MappedFile(const std::string &path) : data(nullptr), size(0) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error("Failed to open '" + path + "': "
+                               + std::strerror(errno));
+
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size <= 0) {
+      close(fd);
+      throw std::runtime_error("Failed to read '" + path + "'");
+    }
+    size = static_cast<size_t>(st.st_size);
+
+    void *const addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+      throw std::runtime_error("Failed to map '" + path + "': "
+                               + std::strerror(errno));
+    data = static_cast<const char *>(addr);
+  }
+
+  ~MappedFile() {
+    munmap(const_cast<char *>(data), size);
+  }
+};
+
+// Copy an array of n records out of a mapped file at *offset,
+// advancing the offset.
+template<typename T>
+std::vector<T> readArray(const MappedFile &file, size_t *const offset,
+                         const uint64_t n, const std::string &path) {
+  if (n > (file.size - *offset) / sizeof(T))
+    throw std::runtime_error("Truncated scene cache '" + path + "'");
+
+  std::vector<T> values(static_cast<size_t>(n));
+  std::memcpy(values.data(), file.data + *offset, n * sizeof(T));
+  *offset += n * sizeof(T);
+  return values;
+}
+
+/*
+ * Scene construction.
+ */
+
+Vector vector(const Scalar v[3]) {
+  return Vector(v[0], v[1], v[2]);
+}
+
+std::vector<std::unique_ptr<Material>> makeMaterials(
+    const SceneDescription &description) {
+  std::vector<std::unique_ptr<Material>> materials;
+
+  for (const auto &m : description.materials)
+    materials.emplace_back(new Material(
+        Colour(m.colour[0], m.colour[1], m.colour[2]), m.ambient,
+        m.diffuse, m.specular, m.shininess, m.reflectivity));
+
+  return materials;
+}
+
+Camera *makeCamera(const SceneDescription &description) {
+  const SceneDescription::CameraRecord &c = description.camera;
+
+  return new Camera(vector(c.position), vector(c.lookAt),
+                    c.width, c.height,
+                    Lens(c.focalLength, c.aperture, c.focus));
+}
+
+std::vector<Object *> makeObjects(
+    const SceneDescription &description,
+    const std::vector<std::unique_ptr<Material>> &materials) {
+  std::vector<Object *> objects;
+
+  const auto material = [&](const uint32_t index) {
+    if (index >= materials.size())
+      throw std::runtime_error("Invalid material index");
+    return materials[index].get();
+  };
+
+  for (const auto &o : description.objects) {
+    switch (o.type) {
+      case SceneDescription::plane:
+        objects.push_back(new Plane(vector(o.position),
+                                    vector(o.direction),
+                                    material(o.material1)));
+        break;
+      case SceneDescription::checkerboard:
+        objects.push_back(new CheckerBoard(vector(o.position),
+                                           vector(o.direction), o.size,
+                                           material(o.material1),
+                                           material(o.material2)));
+        break;
+      case SceneDescription::sphere:
+        objects.push_back(new Sphere(vector(o.position), o.size,
+                                     material(o.material1)));
+        break;
+      default:
+        throw std::runtime_error("Invalid object type");
+    }
+  }
+
+  return objects;
+}
+
+std::vector<Light *> makeLights(const SceneDescription &description) {
+  std::vector<Light *> lights;
+
+  for (const auto &l : description.lights)
+    lights.push_back(new SoftLight(
+        vector(l.position),
+        Colour(l.colour[0], l.colour[1], l.colour[2]), l.radius,
+        static_cast<size_t>(l.samples), static_cast<size_t>(l.minSamples),
+        l.threshold));
+
+  return lights;
+}
+
+}  // namespace
+
+LoadedScene::LoadedScene(const SceneDescription &_description)
+    : description(_description),
+      materials(makeMaterials(description)),
+      camera(makeCamera(description)),
+      scene(new Scene(makeObjects(description, materials),
+                      makeLights(description))) {}
+
+LoadedScene::LoadedScene(const SceneDescription &_description, BVH &&bvh)
+    : description(_description),
+      materials(makeMaterials(description)),
+      camera(makeCamera(description)),
+      scene(new Scene(makeObjects(description, materials),
+                      makeLights(description), std::move(bvh))) {}
+
+std::unique_ptr<Renderer> LoadedScene::renderer() const {
+  return std::unique_ptr<Renderer>(new Renderer(
+      *scene, camera.get(),
+      static_cast<size_t>(description.settings.dofSamples),
+      static_cast<size_t>(description.settings.rayDepth), 32,
+      description.settings.minRayWeight,
+      description.settings.rouletteWeight));
+}
+
+std::unique_ptr<DynamicImage> LoadedScene::image() const {
+  const SceneDescription::SettingsRecord &s = description.settings;
+
+  return std::unique_ptr<DynamicImage>(new DynamicImage(
+      static_cast<size_t>(s.width), static_cast<size_t>(s.height),
+      s.saturation, Colour(s.gamma[0], s.gamma[1], s.gamma[2])));
+}
+
+namespace scene {
+
+SceneDescription parse(const std::string &path) {
+  std::map<std::string, std::string> macros;
+  std::vector<Token> tokens;
+  SceneDescription description;
+  preprocess(path, &macros, &tokens, &description.sources);
+
+  std::map<std::string, uint32_t> materials;
+  std::map<std::string, SceneDescription::CameraRecord> lenses;
+  std::map<std::string, SceneDescription::SettingsRecord> films;
+  bool haveCamera = false;
+
+  // Renderer configuration.
+  size_t scale = 1;
+  description.settings.rayDepth = 100;
+  description.settings.dofSamples = 1;
+  description.settings.minRayWeight = 1 / Scalar(512);
+  description.settings.rouletteWeight = 0;
+  description.path = "render.ppm";
+
+  // Soft lights cast N = base + (scaleFactor * radius) ^ 3 rays.
+  size_t softLightBase = 3;
+  Scalar softLightScaleFactor = .01;
+
+  // Adaptive soft lights first cast a batch of `adaptive' rays, and
+  // only cast the rest if their visibility variance exceeds
+  // `threshold'. Zero disables adaptive sampling.
+  size_t softLightAdaptive = 0;
+  Scalar softLightThreshold = 0;
+
+  const auto material = [&](Section *const section, const std::string &key) {
+    const Token name = section->token(key);
+    const auto it = materials.find(section->reference(key, "material"));
+    if (it == materials.end())
+      error(name, "No material named '" + name.text + "'");
+    return it->second;
+  };
+
+  for (auto &section : sections(tokens)) {
+    const std::string name = lower(section.name.text);
+    std::string id;
+
+    if (name == "renderer") {
+      description.settings.rayDepth = section.integer("raydepth", 100);
+      description.settings.dofSamples = section.integer("dofsamples", 1);
+      description.settings.minRayWeight =
+          section.scalar("minrayweight", 1 / Scalar(512));
+      description.settings.rouletteWeight =
+          section.scalar("rouletteweight", 0);
+      scale = section.integer("scale", 1);
+      description.path = section.string("path", "render.ppm");
+    } else if (name == "renderer.antialiasing") {
+      // No configurable options.
+    } else if (name == "renderer.softlights") {
+      softLightBase = section.integer("base", 3);
+      softLightScaleFactor = section.scalar("scalefactor", .01);
+      softLightAdaptive = section.integer("adaptive", 0);
+      softLightThreshold = section.scalar("threshold", 0);
+    } else if (startsWith(name, "material.", &id)) {
+      if (materials.count(id))
+        error(section.name, "Duplicate material '" + id + "'");
+
+      SceneDescription::MaterialRecord m;
+      section.colour("colour", m.colour);
+      m.ambient = section.percent("ambient", 0);
+      m.diffuse = section.percent("diffuse", 0);
+      m.specular = section.percent("specular", 0);
+      m.shininess = section.scalar("shininess", 0);
+      m.reflectivity = section.percent("reflectivity", 0);
+
+      materials[id] = static_cast<uint32_t>(description.materials.size());
+      description.materials.push_back(m);
+    } else if (name == "object.plane" || name == "object.checkerboard" ||
+               name == "object.sphere") {
+      SceneDescription::ObjectRecord o = {};
+      section.vector("position", o.position);
+
+      if (name == "object.sphere") {
+        o.type = SceneDescription::sphere;
+        o.size = section.scalar("size", 0);
+        o.material1 = material(&section, "material");
+      } else if (name == "object.plane") {
+        o.type = SceneDescription::plane;
+        section.vector("direction", o.direction);
+        o.material1 = material(&section, "material");
+      } else {
+        o.type = SceneDescription::checkerboard;
+        section.vector("direction", o.direction);
+        o.size = section.scalar("size", 0);
+        o.material1 = material(&section, "material1");
+        o.material2 = material(&section, "material2");
+      }
+
+      description.objects.push_back(o);
+    } else if (name == "light.soft" || name == "light.point") {
+      SceneDescription::LightRecord l;
+      section.vector("position", l.position);
+      section.colour("colour", l.colour);
+      l.radius = 0;
+      l.threshold = 0;
+      l.samples = 1;
+      l.minSamples = 0;
+
+      if (name == "light.soft") {
+        l.radius = section.scalar("size", 0);
+        l.samples = static_cast<uint64_t>(std::ceil(
+            softLightBase + std::pow(l.radius * softLightScaleFactor, 3)));
+        l.minSamples = softLightAdaptive;
+        l.threshold = softLightThreshold;
+      }
+
+      description.lights.push_back(l);
+    } else if (startsWith(name, "lens.", &id)) {
+      if (lenses.count(id))
+        error(section.name, "Duplicate lens '" + id + "'");
+
+      SceneDescription::CameraRecord &lens = lenses[id];
+      lens.focalLength = section.scalar("focallength", 0);
+      lens.aperture = section.scalar("aperture", 1);
+      lens.focus = section.scalar("focus", 1);
+    } else if (startsWith(name, "film.", &id)) {
+      if (films.count(id))
+        error(section.name, "Duplicate film '" + id + "'");
+
+      SceneDescription::SettingsRecord &film = films[id];
+      film.saturation = section.percent("saturation", 1);
+      film.width = section.integer("width", 0);
+      film.height = section.integer("height", 0);
+
+      Scalar gamma[3] = {100, 100, 100};
+      if (section.pairs.count("rgbgamma"))
+        section.vector("rgbgamma", gamma);
+      for (size_t i = 0; i < 3; i++)
+        film.gamma[i] = gamma[i] / 100;
+    } else if (name == "camera.perspective") {
+      if (haveCamera)
+        error(section.name, "Duplicate camera");
+      haveCamera = true;
+
+      const Token lensToken = section.token("lens");
+      const Token filmToken = section.token("film");
+      const auto lens = lenses.find(section.reference("lens", "lens"));
+      if (lens == lenses.end())
+        error(lensToken, "No lens named '" + lensToken.text + "'");
+      const auto film = films.find(section.reference("film", "film"));
+      if (film == films.end())
+        error(filmToken, "No film named '" + filmToken.text + "'");
+
+      SceneDescription::CameraRecord &c = description.camera;
+      c = lens->second;
+      section.vector("position", c.position);
+      section.vector("lookat", c.lookAt);
+      c.width = static_cast<Scalar>(film->second.width);
+      c.height = static_cast<Scalar>(film->second.height);
+
+      description.settings.saturation = film->second.saturation;
+      for (size_t i = 0; i < 3; i++)
+        description.settings.gamma[i] = film->second.gamma[i];
+      description.settings.width = film->second.width;
+      description.settings.height = film->second.height;
+    } else {
+      error(section.name, "Unknown section [" + section.name.text + "]");
+    }
+
+    section.finish();
+  }
+
+  if (!haveCamera)
+    throw std::runtime_error(path + ": No [Camera.Perspective] section");
+
+  // The output image is the size of the film, scaled.
+  description.settings.width *= scale;
+  description.settings.height *= scale;
+
+  return description;
+}
+
+void writeCache(const std::string &path,
+                const SceneDescription &description,
+                const BVH &bvh) {
+  CacheHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, cacheMagic, sizeof(header.magic));
+  header.version = cacheVersion;
+  header.byteOrder = cacheByteOrder;
+  header.scalarSize = sizeof(Scalar);
+  header.numMaterials = description.materials.size();
+  header.numObjects = description.objects.size();
+  header.numLights = description.lights.size();
+  header.numNodes = bvh.nodes.size();
+  header.numIndices = bvh.indices.size();
+  header.pathSize = description.path.size();
+  header.numSources = description.sources.size();
+  header.camera = description.camera;
+  header.settings = description.settings;
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  writeArray(out, description.materials);
+  writeArray(out, description.objects);
+  writeArray(out, description.lights);
+  writeArray(out, bvh.nodes);
+  writeArray(out, bvh.indices);
+  out.write(description.path.data(),
+            static_cast<std::streamsize>(description.path.size()));
+  for (const auto &source : description.sources) {
+    const CacheSource record = {source.size, source.hash,
+                                source.path.size()};
+    out.write(reinterpret_cast<const char *>(&record), sizeof(record));
+    out.write(source.path.data(),
+              static_cast<std::streamsize>(source.path.size()));
+  }
+
+  if (!out)
+    throw std::runtime_error("Failed to write scene cache '" + path + "'");
+}
+
+std::unique_ptr<LoadedScene> readCache(const std::string &path) {
+  const MappedFile file(path);
+
+  CacheHeader header;
+  if (file.size < sizeof(header))
+    throw std::runtime_error("Truncated scene cache '" + path + "'");
+  std::memcpy(&header, file.data, sizeof(header));
+
+  if (std::memcmp(header.magic, cacheMagic, sizeof(header.magic)) ||
+      header.version != cacheVersion ||
+      header.byteOrder != cacheByteOrder ||
+      header.scalarSize != sizeof(Scalar))
+    throw std::runtime_error("Incompatible scene cache '" + path + "'");
+
+  SceneDescription description;
+  size_t offset = sizeof(header);
+  description.materials = readArray<SceneDescription::MaterialRecord>(
+      file, &offset, header.numMaterials, path);
+  description.objects = readArray<SceneDescription::ObjectRecord>(
+      file, &offset, header.numObjects, path);
+  description.lights = readArray<SceneDescription::LightRecord>(
+      file, &offset, header.numLights, path);
+  std::vector<BVH::Node> nodes = readArray<BVH::Node>(
+      file, &offset, header.numNodes, path);
+  std::vector<uint32_t> indices = readArray<uint32_t>(
+      file, &offset, header.numIndices, path);
+  const std::vector<char> name = readArray<char>(
+      file, &offset, header.pathSize, path);
+  description.path.assign(name.begin(), name.end());
+  description.camera = header.camera;
+  description.settings = header.settings;
+
+  for (uint64_t i = 0; i < header.numSources; i++) {
+    const CacheSource record = readArray<CacheSource>(
+        file, &offset, 1, path).front();
+    const std::vector<char> sourcePath = readArray<char>(
+        file, &offset, record.pathSize, path);
+    description.sources.push_back(
+        {std::string(sourcePath.begin(), sourcePath.end()),
+         record.size, record.hash});
+
+    if (!fresh(description.sources.back()))
+      throw std::runtime_error("Stale scene cache '" + path + "'");
+  }
+
+  try {
+    return std::unique_ptr<LoadedScene>(new LoadedScene(
+        description, BVH(std::move(nodes), std::move(indices))));
+  } catch (const std::exception &e) {
+    throw std::runtime_error("Invalid scene cache '" + path + "': "
+                             + e.what());
+  }
+}
+
+std::unique_ptr<LoadedScene> load(const std::string &path,
+                                  const std::string &cachePath) {
+  if (cachePath.empty())
+    return std::unique_ptr<LoadedScene>(new LoadedScene(parse(path)));
+
+  // Use the cache if it is up to date, and of this scene file.
+  try {
+    std::unique_ptr<LoadedScene> cached = readCache(cachePath);
+    const auto &sources = cached->description.sources;
+    if (!sources.empty() && sources.front().path == path)
+      return cached;
+  } catch (const std::runtime_error&) {
+    // Fall through to rebuild the cache.
+  }
+
+  std::unique_ptr<LoadedScene> loaded(new LoadedScene(parse(path)));
+  writeCache(cachePath, loaded->description,
+             loaded->scene->index.hierarchy());
+  return loaded;
+}
+
+}  // namespace scene
+
+}  // namespace rt
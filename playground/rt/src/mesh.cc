@@ -0,0 +1,300 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rt/objects.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace rt {
+
+namespace {
+
+// Return the cross product of a and b.
+inline Vector cross(const Vector &a, const Vector &b) {
+  return Vector(a.y * b.z - a.z * b.y,
+                a.z * b.x - a.x * b.z,
+                a.x * b.y - a.y * b.x);
+}
+
+// Return the triangles reordered into the leaf order of a hierarchy.
+std::vector<uint32_t> leafOrder(const std::vector<uint32_t> &triangles,
+                                const BVH &bvh) {
+  std::vector<uint32_t> ordered;
+  ordered.reserve(triangles.size());
+
+  for (const uint32_t i : bvh.indices)
+    for (size_t j = 0; j < 3; j++)
+      ordered.push_back(triangles[3 * i + j]);
+
+  return ordered;
+}
+
+// Return the area weighted vertex normals of a mesh.
+std::vector<Scalar> vertexNormals(const std::vector<Scalar> &vertices,
+                                  const std::vector<uint32_t> &triangles) {
+  std::vector<Scalar> normals(vertices.size());
+
+  for (size_t i = 0; i < triangles.size(); i += 3) {
+    const Scalar *const a = &vertices[3 * triangles[i]];
+    const Scalar *const b = &vertices[3 * triangles[i + 1]];
+    const Scalar *const c = &vertices[3 * triangles[i + 2]];
+    // The cross product of two edges, whose length is twice the
+    // triangle's area.
+    const Vector n = cross(Vector(b[0] - a[0], b[1] - a[1], b[2] - a[2]),
+                           Vector(c[0] - a[0], c[1] - a[1], c[2] - a[2]));
+
+    for (size_t j = 0; j < 3; j++) {
+      Scalar *const normal = &normals[3 * triangles[i + j]];
+      normal[0] += n.x;
+      normal[1] += n.y;
+      normal[2] += n.z;
+    }
+  }
+
+  for (size_t i = 0; i < normals.size(); i += 3) {
+    const Scalar size = std::sqrt(normals[i] * normals[i]
+                                  + normals[i + 1] * normals[i + 1]
+                                  + normals[i + 2] * normals[i + 2]);
+    if (size > 0) {
+      normals[i] /= size;
+      normals[i + 1] /= size;
+      normals[i + 2] /= size;
+    }
+  }
+
+  return normals;
+}
+
+// Return the centre of a hierarchy's bounds.
+Vector centre(const BVH &bvh) {
+  const BoundingBox box = bvh.bounds();
+  return bvh.nodes.empty()
+      ? Vector(0, 0, 0)
+      : Vector(box.centre(0), box.centre(1), box.centre(2));
+}
+
+}  // namespace
+
+Mesh::Mesh(std::vector<Scalar> &&_vertices,
+           std::vector<uint32_t> &&_triangles,
+           const Material *const restrict _material)
+    : Mesh(std::move(_vertices), std::move(_triangles), _material,
+           hierarchy(_vertices, _triangles)) {}
+
+Mesh::Mesh(std::vector<Scalar> &&_vertices,
+           std::vector<uint32_t> &&_triangles,
+           const Material *const restrict _material,
+           BVH &&_bvh)
+    : Object(centre(_bvh)),
+      vertices(std::move(_vertices)),
+      triangles(leafOrder(_triangles, _bvh)),
+      normals(vertexNormals(vertices, triangles)),
+      material(_material),
+      bvh(std::move(_bvh)) {}
+
+BVH Mesh::hierarchy(const std::vector<Scalar> &vertices,
+                    const std::vector<uint32_t> &triangles) {
+  const size_t numVertices = vertices.size() / 3;
+  if (vertices.size() % 3 || triangles.size() % 3)
+    throw std::invalid_argument("Mesh buffers are not triples");
+
+  std::vector<BoundingBox> boxes(triangles.size() / 3);
+  for (size_t i = 0; i < triangles.size(); i++) {
+    if (triangles[i] >= numVertices)
+      throw std::invalid_argument("Mesh vertex index out of range");
+    boxes[i / 3].extend(&vertices[3 * triangles[i]]);
+  }
+
+  return BVH(boxes);
+}
+
+Scalar Mesh::intersect(const Ray &ray) const {
+  Scalar t = ScalarInfinity;
+  const size_t slot = bvh.closest(
+      ray, &t, [this](const size_t i, const Ray &r) {
+        return intersectTriangle(i, r);
+      });
+
+  return slot < size() ? t : 0;
+}
+
+Vector Mesh::normal(const Vector &p) const {
+  // Find the triangle which p lies on, allowing for rounding error:
+  // among the triangles whose boxes contain p, the one for which p is
+  // the least distance from its plane and outside of its edges.
+  const Scalar point[3] = {p.x, p.y, p.z};
+  const Scalar margin = ScalarPrecision
+      * (1 + std::max(std::abs(p.x), std::max(std::abs(p.y),
+                                              std::abs(p.z))));
+  Scalar bestError = std::numeric_limits<Scalar>::max();
+  Scalar u = 0, v = 0;
+  size_t best = size();
+
+  bvh.visit(point, margin, [&](const size_t i) {
+    const uint32_t *const t = &triangles[3 * i];
+    const Vector a(vertices[3 * t[0]], vertices[3 * t[0] + 1],
+                   vertices[3 * t[0] + 2]);
+    const Vector e1 = Vector(vertices[3 * t[1]], vertices[3 * t[1] + 1],
+                             vertices[3 * t[1] + 2]) - a;
+    const Vector e2 = Vector(vertices[3 * t[2]], vertices[3 * t[2] + 1],
+                             vertices[3 * t[2] + 2]) - a;
+    const Vector n = cross(e1, e2);
+    const Scalar area2 = n ^ n;
+    if (area2 == 0)
+      return;
+
+    // Barycentric coordinates of p projected onto the plane.
+    const Vector s = p - a;
+    const Scalar bu = (cross(s, e2) ^ n) / area2;
+    const Scalar bv = (cross(e1, s) ^ n) / area2;
+    const Scalar outside = std::max(-bu, Scalar(0))
+                           + std::max(-bv, Scalar(0))
+                           + std::max(bu + bv - 1, Scalar(0));
+    const Scalar error = std::abs(s ^ n) / std::sqrt(area2)
+                         + outside * std::sqrt(std::sqrt(area2));
+
+    if (error < bestError) {
+      bestError = error;
+      best = i;
+      u = bu;
+      v = bv;
+    }
+  });
+
+  if (best == size())
+    return Vector(0, 1, 0);
+
+  // Interpolate the vertex normals.
+  const uint32_t *const t = &triangles[3 * best];
+  const Scalar w = 1 - u - v;
+  Scalar n[3];
+  for (size_t j = 0; j < 3; j++)
+    n[j] = normals[3 * t[0] + j] * w + normals[3 * t[1] + j] * u
+           + normals[3 * t[2] + j] * v;
+
+  return Vector(n[0], n[1], n[2]).normalise();
+}
+
+namespace obj {
+
+namespace {
+
+// Parse the vertex index of a face element "v", "v/vt", "v//vn" or
+// "v/vt/vn", which may be negative to count back from the last
+// vertex. Advances `str' past the element.
+uint32_t vertexIndex(const char **const str, const size_t numVertices,
+                     const size_t line) {
+  char *end;
+  const long i = std::strtol(*str, &end, 10);
+  if (end == *str)
+    throw std::runtime_error("OBJ line " + std::to_string(line)
+                             + ": expected a vertex index");
+
+  // Skip texture and normal indices.
+  while (*end && *end != ' ' && *end != '\t' && *end != '\r')
+    end++;
+  *str = end;
+
+  const long n = static_cast<long>(numVertices);
+  const long index = i < 0 ? n + i : i - 1;
+  if (i == 0 || index < 0 || index >= n)
+    throw std::runtime_error("OBJ line " + std::to_string(line)
+                             + ": vertex index out of range");
+
+  return static_cast<uint32_t>(index);
+}
+
+// Return whether any non-whitespace remains in a string.
+bool more(const char **const str) {
+  while (**str == ' ' || **str == '\t' || **str == '\r')
+    (*str)++;
+  return **str != '\0';
+}
+
+}  // namespace
+
+std::unique_ptr<Mesh> read(std::istream &in,
+                           const Material *const restrict material,
+                           const Vector &offset,
+                           const Scalar scale) {
+  std::vector<Scalar> vertices;
+  std::vector<uint32_t> triangles;
+  std::vector<uint32_t> face;
+  std::string text;
+  size_t line = 0;
+
+  while (std::getline(in, text)) {
+    line++;
+    const char *str = text.c_str();
+
+    if (str[0] == 'v' && (str[1] == ' ' || str[1] == '\t')) {
+      // A vertex position.
+      const Scalar origin[3] = {offset.x, offset.y, offset.z};
+      str++;
+      for (size_t i = 0; i < 3; i++) {
+        char *end;
+        const double x = std::strtod(str, &end);
+        if (end == str)
+          throw std::runtime_error("OBJ line " + std::to_string(line)
+                                   + ": expected a coordinate");
+        vertices.push_back(static_cast<Scalar>(x) * scale + origin[i]);
+        str = end;
+      }
+    } else if (str[0] == 'f' && (str[1] == ' ' || str[1] == '\t')) {
+      // A polygon, which is split into a fan of triangles.
+      str++;
+      face.clear();
+      while (more(&str))
+        face.push_back(vertexIndex(&str, vertices.size() / 3, line));
+
+      if (face.size() < 3)
+        throw std::runtime_error("OBJ line " + std::to_string(line)
+                                 + ": face has fewer than 3 vertices");
+
+      for (size_t i = 2; i < face.size(); i++) {
+        triangles.push_back(face[0]);
+        triangles.push_back(face[i - 1]);
+        triangles.push_back(face[i]);
+      }
+    }
+  }
+
+  return std::unique_ptr<Mesh>(
+      new Mesh(std::move(vertices), std::move(triangles), material));
+}
+
+std::unique_ptr<Mesh> load(const std::string &path,
+                           const Material *const restrict material,
+                           const Vector &offset,
+                           const Scalar scale) {
+  std::ifstream in(path);
+  if (!in)
+    throw std::runtime_error("Failed to open '" + path + "'");
+
+  return read(in, material, offset, scale);
+}
+
+}  // namespace obj
+
+}  // namespace rt
@@ -18,8 +18,226 @@
  */
 #include "rt/objects.h"
 
+#include <stdexcept>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#include "rt/profiling.h"
+
 namespace rt {
 
+  namespace {
+
+  // Return the objects which either do, or do not have bounds.
+  std::vector<const Object *> partition(const Objects &objects,
+                                        const bool bounded) {
+    std::vector<const Object *> out;
+    BoundingBox box;
+
+    for (const auto object : objects)
+      if (object->bounds(&box) == bounded)
+        out.push_back(object);
+
+    return out;
+  }
+
+  // Return the bounding boxes of a list of bounded objects.
+  std::vector<BoundingBox> bounds(const std::vector<const Object *> &objects) {
+    std::vector<BoundingBox> boxes(objects.size());
+
+    for (size_t i = 0; i < objects.size(); i++)
+      objects[i]->bounds(&boxes[i]);
+
+    return boxes;
+  }
+
+  // Check that a hierarchy refers to each of n objects once, and
+  // that it is a tree no deeper than the traversal stacks allow, with
+  // its nodes in range.
+  BVH validate(BVH &&bvh, const size_t n) {
+    std::vector<bool> seen(n);
+    bool valid = bvh.indices.size() == n && (n == 0 || !bvh.nodes.empty());
+
+    for (size_t i = 0; valid && i < bvh.indices.size(); i++) {
+      valid = bvh.indices[i] < n && !seen[bvh.indices[i]];
+      if (valid)
+        seen[bvh.indices[i]] = true;
+    }
+
+    // Walk the tree from the root, visiting each node at most once.
+    std::vector<bool> reached(bvh.nodes.size());
+    std::vector<std::pair<size_t, size_t>> stack;  // node, depth
+    if (valid && !bvh.nodes.empty())
+      stack.emplace_back(0, 0);
+
+    while (valid && !stack.empty()) {
+      const size_t i = stack.back().first;
+      const size_t depth = stack.back().second;
+      stack.pop_back();
+
+      valid = i < bvh.nodes.size() && !reached[i] && depth < BVH::maxDepth;
+      if (!valid)
+        break;
+      reached[i] = true;
+
+      const BVH::Node &node = bvh.nodes[i];
+      if (node.leaf()) {
+        valid = static_cast<size_t>(node.offset) + node.count <=
+                bvh.indices.size();
+      } else {
+        valid = node.offset > i + 1;
+        stack.emplace_back(i + 1, depth + 1);
+        stack.emplace_back(node.offset, depth + 1);
+      }
+    }
+
+    if (!valid)
+      throw std::invalid_argument("BVH does not match objects");
+
+    return std::move(bvh);
+  }
+
+  }  // namespace
+
   const Scalar CheckerBoard::gridOffset = 3e6;
 
+  ObjectIndex::ObjectIndex(const Objects &objects, const bool _typed)
+    : bounded(partition(objects, true)),
+      unbounded(partition(objects, false)),
+      typed(_typed),
+      bvh(bounds(bounded)),
+      packed(pack(bounded, unbounded, bvh)) {}
+
+  ObjectIndex::ObjectIndex(const Objects &objects, BVH &&_bvh,
+                           const bool _typed)
+    : bounded(partition(objects, true)),
+      unbounded(partition(objects, false)),
+      typed(_typed),
+      bvh(validate(std::move(_bvh), bounded.size())),
+      packed(pack(bounded, unbounded, bvh)) {}
+
+  ObjectIndex::Packed ObjectIndex::pack(
+      const std::vector<const Object *> &bounded,
+      const std::vector<const Object *> &unbounded,
+      const BVH &bvh) {
+    Packed p;
+    p.spheres.reserve(bvh.indices.size());
+    p.planes.reserve(unbounded.size());
+
+    // Only objects of exactly these types are typed, since a subclass
+    // may override intersect(). CheckerBoard inherits Plane's.
+    for (const auto i : bvh.indices) {
+      const auto sphere = typeid(*bounded[i]) == typeid(Sphere)
+          ? static_cast<const Sphere *>(bounded[i]) : nullptr;
+      const Vector &position = bounded[i]->position;
+      const Scalar r2 = sphere ? sphere->radius * sphere->radius : -1;
+
+      p.spheres.push_back({position.x, position.y, position.z, r2});
+    }
+
+    for (const auto object : unbounded) {
+      const auto plane = typeid(*object) == typeid(Plane) ||
+                         typeid(*object) == typeid(CheckerBoard)
+          ? static_cast<const Plane *>(object) : nullptr;
+      const Vector normal = plane ? plane->direction : Vector(0, 0, 0);
+      const Vector &position = object->position;
+
+      p.planes.push_back({position.x, position.y, position.z,
+                          normal.x, normal.y, normal.z});
+    }
+
+    return p;
+  }
+
+  const Object *ObjectIndex::closestIntersect(
+      const Ray &ray, Scalar *const restrict t) const {
+    const Object *closest = nullptr;
+    size_t tests = unbounded.size();
+    *t = ScalarInfinity;
+
+    // Test the unbounded objects first, since their intersection
+    // distance can then be used to cull the BVH traversal.
+    for (size_t i = 0; i < unbounded.size(); i++) {
+      const Scalar currentT = intersectUnbounded(i, ray);
+
+      if (currentT != 0 && currentT < *t) {
+        *t = currentT;
+        closest = unbounded[i];
+      }
+    }
+
+    const size_t slot = bvh.closest(
+        ray, t, [this, &tests](const size_t i, const Ray &r) {
+          tests++;
+          return intersectBounded(i, r);
+        });
+    if (slot < bvh.size())
+      closest = bounded[bvh.indices[slot]];
+
+    profiling::counters::incIntersectionCount(tests);
+
+    return closest;
+  }
+
+  constexpr size_t ObjectIndex::noOccluder;
+
+  bool ObjectIndex::intersects(const Ray &ray,
+                               const Scalar distance) const {
+    size_t occluder = noOccluder;
+    return intersects(ray, distance, &occluder);
+  }
+
+  bool ObjectIndex::intersects(const Ray &ray,
+                               const Scalar distance,
+                               size_t *const restrict occluder) const {
+    size_t tests = 0;
+    bool blocked = false;
+
+    // Test the last occluder first.
+    if (*occluder < bounded.size() + unbounded.size()) {
+      const Scalar t = *occluder < bounded.size()
+          ? intersectBounded(*occluder, ray)
+          : intersectUnbounded(*occluder - bounded.size(), ray);
+      tests++;
+
+      if (t > 0 && t < distance) {
+        profiling::counters::incIntersectionCount(tests);
+        profiling::counters::incOccluderHitCount();
+        return true;
+      }
+
+      profiling::counters::incOccluderMissCount();
+    }
+
+    // Test the BVH next, since bounded objects are the most likely
+    // occluders.
+    blocked = bvh.any(ray, distance,
+                      [this, &tests, occluder, distance](
+                          const size_t i, const Ray &r) {
+                        tests++;
+                        const Scalar t = intersectBounded(i, r);
+                        if (t > 0 && t < distance)
+                          *occluder = i;
+                        return t;
+                      });
+
+    for (size_t i = 0; !blocked && i < unbounded.size(); i++) {
+      const Scalar t = intersectUnbounded(i, ray);
+      tests++;
+      blocked = t > 0 && t < distance;
+      if (blocked)
+        *occluder = bounded.size() + i;
+    }
+
+    // Forget the occluder of an unblocked ray, since the next ray is
+    // most likely unblocked too.
+    if (!blocked)
+      *occluder = noOccluder;
+
+    profiling::counters::incIntersectionCount(tests);
+
+    return blocked;
+  }
+
 }  // namespace rt
@@ -0,0 +1,411 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Packet tracing. This is the only translation unit which uses
+// vector intrinsics, so that the public headers are independent of
+// the instruction set.
+#include "rt/objects.h"
+
+#include <cmath>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "rt/profiling.h"
+
+namespace rt {
+
+namespace {
+
+#if defined(__AVX2__) && !defined(RT_SINGLE_PRECISION)
+
+static_assert(packetSize == 4, "AVX2 lanes hold 4 doubles");
+
+// One Scalar per ray of a packet, held in a vector register.
+class Lanes {
+ public:
+  __m256d v;
+
+  inline Lanes() {}
+  inline Lanes(const __m256d _v) : v(_v) {}  // NOLINT
+  explicit inline Lanes(const Scalar x) : v(_mm256_set1_pd(x)) {}
+
+  static inline Lanes load(const Scalar *const restrict p) {
+    return _mm256_load_pd(p);
+  }
+
+  inline void store(Scalar *const restrict p) const {
+    _mm256_storeu_pd(p, v);
+  }
+
+  inline Lanes operator+(const Lanes &b) const {
+    return _mm256_add_pd(v, b.v);
+  }
+  inline Lanes operator-(const Lanes &b) const {
+    return _mm256_sub_pd(v, b.v);
+  }
+  inline Lanes operator*(const Lanes &b) const {
+    return _mm256_mul_pd(v, b.v);
+  }
+  inline Lanes operator/(const Lanes &b) const {
+    return _mm256_div_pd(v, b.v);
+  }
+
+  // Comparisons return a mask with all bits set in matching lanes.
+  inline Lanes operator<(const Lanes &b) const {
+    return _mm256_cmp_pd(v, b.v, _CMP_LT_OQ);
+  }
+  inline Lanes operator>(const Lanes &b) const {
+    return _mm256_cmp_pd(v, b.v, _CMP_GT_OQ);
+  }
+  inline Lanes operator<=(const Lanes &b) const {
+    return _mm256_cmp_pd(v, b.v, _CMP_LE_OQ);
+  }
+  inline Lanes operator!=(const Lanes &b) const {
+    return _mm256_cmp_pd(v, b.v, _CMP_NEQ_OQ);
+  }
+  inline Lanes operator&(const Lanes &b) const {
+    return _mm256_and_pd(v, b.v);
+  }
+
+  // Return a bitmask of the lanes set in a comparison mask.
+  inline int mask() const {
+    return _mm256_movemask_pd(v);
+  }
+
+  friend inline Lanes sqrt(const Lanes &a) {
+    return _mm256_sqrt_pd(a.v);
+  }
+  friend inline Lanes min(const Lanes &a, const Lanes &b) {
+    return _mm256_min_pd(a.v, b.v);
+  }
+  friend inline Lanes max(const Lanes &a, const Lanes &b) {
+    return _mm256_max_pd(a.v, b.v);
+  }
+  // Return `a' in lanes where mask is set, else `b'.
+  friend inline Lanes select(const Lanes &mask, const Lanes &a,
+                             const Lanes &b) {
+    return _mm256_blendv_pd(b.v, a.v, mask.v);
+  }
+};
+
+#elif defined(__AVX2__)
+
+static_assert(packetSize == 8, "AVX2 lanes hold 8 floats");
+
+// One Scalar per ray of a packet, held in a vector register.
+class Lanes {
+ public:
+  __m256 v;
+
+  inline Lanes() {}
+  inline Lanes(const __m256 _v) : v(_v) {}  // NOLINT
+  explicit inline Lanes(const Scalar x) : v(_mm256_set1_ps(x)) {}
+
+  static inline Lanes load(const Scalar *const restrict p) {
+    return _mm256_load_ps(p);
+  }
+
+  inline void store(Scalar *const restrict p) const {
+    _mm256_storeu_ps(p, v);
+  }
+
+  inline Lanes operator+(const Lanes &b) const {
+    return _mm256_add_ps(v, b.v);
+  }
+  inline Lanes operator-(const Lanes &b) const {
+    return _mm256_sub_ps(v, b.v);
+  }
+  inline Lanes operator*(const Lanes &b) const {
+    return _mm256_mul_ps(v, b.v);
+  }
+  inline Lanes operator/(const Lanes &b) const {
+    return _mm256_div_ps(v, b.v);
+  }
+
+  // Comparisons return a mask with all bits set in matching lanes.
+  inline Lanes operator<(const Lanes &b) const {
+    return _mm256_cmp_ps(v, b.v, _CMP_LT_OQ);
+  }
+  inline Lanes operator>(const Lanes &b) const {
+    return _mm256_cmp_ps(v, b.v, _CMP_GT_OQ);
+  }
+  inline Lanes operator<=(const Lanes &b) const {
+    return _mm256_cmp_ps(v, b.v, _CMP_LE_OQ);
+  }
+  inline Lanes operator!=(const Lanes &b) const {
+    return _mm256_cmp_ps(v, b.v, _CMP_NEQ_OQ);
+  }
+  inline Lanes operator&(const Lanes &b) const {
+    return _mm256_and_ps(v, b.v);
+  }
+
+  // Return a bitmask of the lanes set in a comparison mask.
+  inline int mask() const {
+    return _mm256_movemask_ps(v);
+  }
+
+  friend inline Lanes sqrt(const Lanes &a) {
+    return _mm256_sqrt_ps(a.v);
+  }
+  friend inline Lanes min(const Lanes &a, const Lanes &b) {
+    return _mm256_min_ps(a.v, b.v);
+  }
+  friend inline Lanes max(const Lanes &a, const Lanes &b) {
+    return _mm256_max_ps(a.v, b.v);
+  }
+  // Return `a' in lanes where mask is set, else `b'.
+  friend inline Lanes select(const Lanes &mask, const Lanes &a,
+                             const Lanes &b) {
+    return _mm256_blendv_ps(b.v, a.v, mask.v);
+  }
+};
+
+#else  // !__AVX2__
+
+// Portable fallback, written as fixed-length loops which the
+// compiler may vectorise. Comparison masks are 1 or 0.
+class Lanes {
+ public:
+  Scalar v[packetSize];
+
+  inline Lanes() {}
+  explicit inline Lanes(const Scalar x) {
+    for (size_t i = 0; i < packetSize; i++) v[i] = x;
+  }
+
+  static inline Lanes load(const Scalar *const restrict p) {
+    Lanes r;
+    for (size_t i = 0; i < packetSize; i++) r.v[i] = p[i];
+    return r;
+  }
+
+  inline void store(Scalar *const restrict p) const {
+    for (size_t i = 0; i < packetSize; i++) p[i] = v[i];
+  }
+
+#define RT_LANES_OP(op)                                         \
+  inline Lanes operator op(const Lanes &b) const {              \
+    Lanes r;                                                    \
+    for (size_t i = 0; i < packetSize; i++) r.v[i] = v[i] op b.v[i]; \
+    return r;                                                   \
+  }
+  RT_LANES_OP(+)
+  RT_LANES_OP(-)
+  RT_LANES_OP(*)
+  RT_LANES_OP(/)
+  RT_LANES_OP(<)
+  RT_LANES_OP(>)
+  RT_LANES_OP(<=)
+  RT_LANES_OP(!=)
+#undef RT_LANES_OP
+
+  inline Lanes operator&(const Lanes &b) const {
+    Lanes r;
+    for (size_t i = 0; i < packetSize; i++) r.v[i] = v[i] && b.v[i];
+    return r;
+  }
+
+  inline int mask() const {
+    int m = 0;
+    for (size_t i = 0; i < packetSize; i++)
+      if (v[i] != 0) m |= 1 << i;
+    return m;
+  }
+
+  friend inline Lanes sqrt(const Lanes &a) {
+    Lanes r;
+    for (size_t i = 0; i < packetSize; i++) r.v[i] = std::sqrt(a.v[i]);
+    return r;
+  }
+  friend inline Lanes min(const Lanes &a, const Lanes &b) {
+    Lanes r;
+    for (size_t i = 0; i < packetSize; i++)
+      r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i];
+    return r;
+  }
+  friend inline Lanes max(const Lanes &a, const Lanes &b) {
+    Lanes r;
+    for (size_t i = 0; i < packetSize; i++)
+      r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i];
+    return r;
+  }
+  friend inline Lanes select(const Lanes &mask, const Lanes &a,
+                             const Lanes &b) {
+    Lanes r;
+    for (size_t i = 0; i < packetSize; i++)
+      r.v[i] = mask.v[i] != 0 ? a.v[i] : b.v[i];
+    return r;
+  }
+};
+
+#endif  // !__AVX2__
+
+// Select the nearest positive root, using the same tolerances as
+// Sphere::intersect() and Plane::intersect(). Returns 0 in lanes
+// with no intersection.
+inline Lanes nearest(const Lanes &t0, const Lanes &t1) {
+  const Lanes precision(ScalarPrecision);
+  const Lanes zero(0);
+
+  return select(t0 > precision, t0, select(t1 > precision, t1, zero));
+}
+
+// The rays of a packet, loaded into registers.
+class Packet {
+ public:
+  const Lanes px, py, pz, dx, dy, dz;
+  const Lanes ix, iy, iz;  // Reciprocal directions.
+
+  explicit inline Packet(const RayPacket &p)
+      : px(Lanes::load(p.px)), py(Lanes::load(p.py)),
+        pz(Lanes::load(p.pz)), dx(Lanes::load(p.dx)),
+        dy(Lanes::load(p.dy)), dz(Lanes::load(p.dz)),
+        ix(Lanes(1) / dx), iy(Lanes(1) / dy), iz(Lanes(1) / dz) {}
+
+  // Return a mask of the rays which enter a box before `tmax'.
+  inline Lanes intersect(const BoundingBox &box, const Lanes &tmax) const {
+    Lanes t0 = (Lanes(box.min[0]) - px) * ix;
+    Lanes t1 = (Lanes(box.max[0]) - px) * ix;
+    Lanes near = max(Lanes(0), min(t0, t1));
+    Lanes far = min(tmax, max(t0, t1));
+
+    t0 = (Lanes(box.min[1]) - py) * iy;
+    t1 = (Lanes(box.max[1]) - py) * iy;
+    near = max(near, min(t0, t1));
+    far = min(far, max(t0, t1));
+
+    t0 = (Lanes(box.min[2]) - pz) * iz;
+    t1 = (Lanes(box.max[2]) - pz) * iz;
+    near = max(near, min(t0, t1));
+    far = min(far, max(t0, t1));
+
+    return near <= far;
+  }
+
+  // Return the distance to a sphere, or 0 if no intersection.
+  inline Lanes sphere(const Scalar x, const Scalar y, const Scalar z,
+                      const Scalar r2) const {
+    const Lanes distx = Lanes(x) - px;
+    const Lanes disty = Lanes(y) - py;
+    const Lanes distz = Lanes(z) - pz;
+    const Lanes b = dx * distx + dy * disty + dz * distz;
+    const Lanes d = b * b + Lanes(r2)
+                    - (distx * distx + disty * disty + distz * distz);
+    const Lanes zero(0);
+    const Lanes root = sqrt(max(d, zero));
+
+    return select(d < zero, zero, nearest(b - root, b + root));
+  }
+
+  // Return the distance to a plane, or 0 if no intersection.
+  inline Lanes plane(const Scalar x, const Scalar y, const Scalar z,
+                     const Scalar nx, const Scalar ny,
+                     const Scalar nz) const {
+    const Lanes f = (Lanes(x) - px) * Lanes(nx)
+                    + (Lanes(y) - py) * Lanes(ny)
+                    + (Lanes(z) - pz) * Lanes(nz);
+    const Lanes g = dx * Lanes(nx) + dy * Lanes(ny) + dz * Lanes(nz);
+    const Lanes t = f / g;
+    const Lanes half(ScalarPrecision / 2);
+
+    return nearest(t - half, t + half);
+  }
+};
+
+}  // namespace
+
+void ObjectIndex::closestIntersect(const RayPacket &rays,
+                                   PacketHit *const restrict hit) const {
+  const Packet packet(rays);
+  Lanes best(ScalarInfinity);
+  size_t tests = 0;
+
+  for (size_t i = 0; i < packetSize; i++)
+    hit->object[i] = nullptr;
+
+  // Update the closest hits with the distances to an object.
+  const auto update = [&](const Lanes &t, const Object *const object) {
+    tests += packetSize;
+    const int mask = ((t != Lanes(0)) & (t < best)).mask();
+    if (mask) {
+      best = select((t != Lanes(0)) & (t < best), t, best);
+      for (size_t i = 0; i < packetSize; i++)
+        if (mask & (1 << i))
+          hit->object[i] = object;
+    }
+  };
+
+  // Intersect a single object one ray at a time.
+  const auto scalar = [&](const Object *const object) {
+    alignas(32) Scalar t[packetSize];
+    for (size_t i = 0; i < packetSize; i++) {
+      t[i] = object->intersect(rays[i]);
+    }
+    update(Lanes::load(t), object);
+  };
+
+  // Unbounded objects.
+  for (size_t i = 0; i < unbounded.size(); i++) {
+    const Packed::Plane &p = packed.planes[i];
+
+    if (p.nx == 0 && p.ny == 0 && p.nz == 0)
+      scalar(unbounded[i]);
+    else
+      update(packet.plane(p.x, p.y, p.z, p.nx, p.ny, p.nz),
+             unbounded[i]);
+  }
+
+  // Traverse the BVH with the whole packet, descending into any
+  // node which is entered by at least one ray.
+  if (!bvh.nodes.empty()) {
+    uint32_t stack[BVH::maxDepth * 2];
+    size_t top = 0;
+    stack[top++] = 0;
+
+    while (top) {
+      const uint32_t index = stack[--top];
+      const BVH::Node &node = bvh.nodes[index];
+
+      if (!packet.intersect(node.box, best).mask())
+        continue;
+
+      if (node.leaf()) {
+        for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+          const Object *const object = bounded[bvh.indices[i]];
+          const Packed::Sphere &s = packed.spheres[i];
+
+          if (s.r2 < 0)
+            scalar(object);
+          else
+            update(packet.sphere(s.x, s.y, s.z, s.r2), object);
+        }
+      } else {
+        stack[top++] = node.offset;
+        stack[top++] = index + 1;
+      }
+    }
+  }
+
+  best.store(hit->t);
+  profiling::counters::incIntersectionCount(tests);
+}
+
+}  // namespace rt
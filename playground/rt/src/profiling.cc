@@ -18,51 +18,337 @@
  */
 #include "rt/profiling.h"
 
+#include <algorithm>
+#include <array>
+#include <mutex>
+#include <vector>
+
 namespace rt {
 
 namespace profiling {
 
 namespace counters {
 
-static std::atomic<Counter> objectsCount;
-static std::atomic<Counter> lightsCount;
-static std::atomic<Counter> traceCounter;
-static std::atomic<Counter> rayCounter;
+namespace {
+
+// Counter indices.
+enum Index : size_t {
+  objects,
+  lights,
+  traces,
+  rays,
+  intersections,
+  shadowHits,
+  shadowMisses,
+  shadowPoints,
+  penumbras,
+  occluderHits,
+  occluderMisses,
+  tiles,
+  tileTime,
+  maxTileTime,
+  refinements,
+  subsamples = refinements + maxRefinementDepth,
+  rayDepths = subsamples + maxRefinementDepth,
+  numCounters = rayDepths + numRayDepthBins
+};
+
+// A set of counters. Each thread only writes its own set, so updates
+// need not be atomic read-modify-write operations. The counters are
+// atomics only so that they can be read by other threads.
+class Counters {
+ public:
+  Counters() {
+    for (auto &value : values)
+      value.store(0, std::memory_order_relaxed);
+  }
+
+  inline Counter get(const size_t i) const {
+    return values[i].load(std::memory_order_relaxed);
+  }
+
+  inline void set(const size_t i, const Counter n) {
+    values[i].store(n, std::memory_order_relaxed);
+  }
+
+  inline void add(const size_t i, const Counter n) {
+    set(i, get(i) + n);
+  }
+
+  inline void max(const size_t i, const Counter n) {
+    set(i, std::max(get(i), n));
+  }
+
+ private:
+  std::array<std::atomic<Counter>, numCounters> values;
+};
+
+// Counters of all live threads, and the merged counters of threads
+// which have exited.
+std::mutex mutex;
+std::vector<Counters *> threads;
+Counters retired;
+
+// Merge a set of counters into another.
+void merge(const Counters &from, Counters *const to) {
+  for (size_t i = 0; i < numCounters; i++) {
+    if (i == maxTileTime)
+      to->max(i, from.get(i));
+    else
+      to->add(i, from.get(i));
+  }
+}
+
+// The counters of a thread, which are registered for its lifetime.
+class ThreadCounters : public Counters {
+ public:
+  ThreadCounters() {
+    std::lock_guard<std::mutex> lock(mutex);
+    threads.push_back(this);
+  }
+
+  ~ThreadCounters() {
+    std::lock_guard<std::mutex> lock(mutex);
+    merge(*this, &retired);
+    threads.erase(std::find(threads.begin(), threads.end(), this));
+  }
+};
+
+inline Counters &local() {
+  static thread_local ThreadCounters counters;
+  return counters;
+}
+
+// Merge the counters of every thread.
+void mergeAll(Counters *const total) {
+  std::lock_guard<std::mutex> lock(mutex);
+  merge(retired, total);
+  for (const auto counters : threads)
+    merge(*counters, total);
+}
+
+Counter get(const size_t i) {
+  Counters total;
+  mergeAll(&total);
+  return total.get(i);
+}
+
+}  // namespace
 
 void incObjectsCount(const size_t n) {
-  objectsCount += n;
+  local().add(objects, n);
 }
 
 Counter getObjectsCount() {
-  return static_cast<Counter>(objectsCount);
+  return get(objects);
 }
 
 void incLightsCount(const size_t n) {
-  lightsCount += n;
+  local().add(lights, n);
 }
 
 Counter getLightsCount() {
-  return static_cast<Counter>(lightsCount);
+  return get(lights);
 }
 
 void incTraceCount(const size_t n) {
-  traceCounter += n;
+  local().add(traces, n);
 }
 
 Counter getTraceCount() {
-  return static_cast<Counter>(traceCounter);
+  return get(traces);
 }
 
 void incRayCount(const size_t n) {
-  rayCounter += n;
+  local().add(rays, n);
 }
 
 Counter getRayCount() {
-  return static_cast<Counter>(rayCounter);
+  return get(rays);
+}
+
+void incIntersectionCount(const size_t n) {
+  local().add(intersections, n);
+}
+
+Counter getIntersectionCount() {
+  return get(intersections);
+}
+
+void incShadowHitCount(const size_t n) {
+  local().add(shadowHits, n);
+}
+
+Counter getShadowHitCount() {
+  return get(shadowHits);
+}
+
+void incShadowMissCount(const size_t n) {
+  local().add(shadowMisses, n);
+}
+
+Counter getShadowMissCount() {
+  return get(shadowMisses);
+}
+
+void incShadowPointCount(const size_t n) {
+  local().add(shadowPoints, n);
+}
+
+Counter getShadowPointCount() {
+  return get(shadowPoints);
+}
+
+void incPenumbraCount(const size_t n) {
+  local().add(penumbras, n);
+}
+
+Counter getPenumbraCount() {
+  return get(penumbras);
+}
+
+void incOccluderHitCount(const size_t n) {
+  local().add(occluderHits, n);
+}
+
+Counter getOccluderHitCount() {
+  return get(occluderHits);
+}
+
+void incOccluderMissCount(const size_t n) {
+  local().add(occluderMisses, n);
+}
+
+Counter getOccluderMissCount() {
+  return get(occluderMisses);
+}
+
+void addTileTime(const Counter microseconds) {
+  Counters &counters = local();
+  counters.add(tiles, 1);
+  counters.add(tileTime, microseconds);
+  counters.max(maxTileTime, microseconds);
+}
+
+Counter getTileCount() {
+  return get(tiles);
+}
+
+Counter getTileTime() {
+  return get(tileTime);
+}
+
+Counter getMaxTileTime() {
+  return get(maxTileTime);
+}
+
+void incRefinementCount(const size_t depth, const size_t n) {
+  local().add(refinements + std::min(depth, maxRefinementDepth - 1), n);
+}
+
+Counter getRefinementCount(const size_t depth) {
+  return get(refinements + std::min(depth, maxRefinementDepth - 1));
+}
+
+void incSubsampleCount(const size_t depth, const size_t n) {
+  local().add(subsamples + std::min(depth, maxRefinementDepth - 1), n);
+}
+
+Counter getSubsampleCount(const size_t depth) {
+  return get(subsamples + std::min(depth, maxRefinementDepth - 1));
+}
+
+void incRayDepthCount(const size_t depth, const size_t n) {
+  size_t bin = 0;
+  for (size_t d = depth; d && bin < numRayDepthBins - 1; d >>= 1)
+    bin++;
+  local().add(rayDepths + bin, n);
+}
+
+Counter getRayDepthCount(const size_t bin) {
+  return get(rayDepths + std::min(bin, numRayDepthBins - 1));
+}
+
+void reset() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  const auto clear = [](Counters *const counters) {
+    for (size_t i = 0; i < numCounters; i++)
+      if (i != objects && i != lights)
+        counters->set(i, 0);
+  };
+
+  clear(&retired);
+  for (const auto counters : threads)
+    clear(counters);
 }
 
 }  // namespace counters
 
+void writeJson(std::ostream &out, const size_t pixels,
+               const Scalar runTime) {
+  counters::Counters c;
+  counters::mergeAll(&c);
+  const auto rate = [&](const Counter n) {
+    return runTime > 0 ? static_cast<Counter>(n / runTime) : 0;
+  };
+  const Counter shadowRays = c.get(counters::shadowHits)
+                             + c.get(counters::shadowMisses);
+
+  out << "{\n"
+      << "  \"pixels\": " << pixels << ",\n"
+      << "  \"objects\": " << c.get(counters::objects) << ",\n"
+      << "  \"lights\": " << c.get(counters::lights) << ",\n"
+      << "  \"time\": " << runTime << ",\n"
+      << "  \"traces\": " << c.get(counters::traces) << ",\n"
+      << "  \"rays\": " << c.get(counters::rays) << ",\n"
+      << "  \"intersection_tests\": "
+      << c.get(counters::intersections) << ",\n"
+      << "  \"shadow_rays\": {\n"
+      << "    \"hits\": " << c.get(counters::shadowHits) << ",\n"
+      << "    \"misses\": " << c.get(counters::shadowMisses) << ",\n"
+      << "    \"points\": " << c.get(counters::shadowPoints) << ",\n"
+      << "    \"penumbra_points\": " << c.get(counters::penumbras) << ",\n"
+      << "    \"occluder_hits\": " << c.get(counters::occluderHits) << ",\n"
+      << "    \"occluder_misses\": "
+      << c.get(counters::occluderMisses) << ",\n"
+      << "    \"per_pixel\": "
+      << (pixels ? static_cast<double>(shadowRays) / pixels : 0) << "\n"
+      << "  },\n"
+      << "  \"tiles\": {\n"
+      << "    \"count\": " << c.get(counters::tiles) << ",\n"
+      << "    \"total_us\": " << c.get(counters::tileTime) << ",\n"
+      << "    \"max_us\": " << c.get(counters::maxTileTime) << "\n"
+      << "  },\n"
+      << "  \"supersampling\": [";
+
+  for (size_t depth = 0; depth < counters::maxRefinementDepth; depth++) {
+    const Counter regions = c.get(counters::refinements + depth);
+    if (!regions)
+      break;
+
+    out << (depth ? ",\n" : "\n")
+        << "    {\"depth\": " << depth
+        << ", \"regions\": " << regions
+        << ", \"samples\": " << c.get(counters::subsamples + depth) << "}";
+  }
+
+  out << "\n  ],\n"
+      << "  \"ray_depths\": [";
+
+  for (size_t bin = 0; bin < counters::numRayDepthBins; bin++)
+    out << (bin ? ", " : "") << c.get(counters::rayDepths + bin);
+
+  out << "],\n"
+      << "  \"rates\": {\n"
+      << "    \"rays_per_second\": " << rate(c.get(counters::rays)) << ",\n"
+      << "    \"traces_per_second\": "
+      << rate(c.get(counters::traces)) << ",\n"
+      << "    \"pixels_per_second\": " << rate(pixels) << "\n"
+      << "  }\n"
+      << "}\n";
+}
+
 }  // namespace profiling
 
 }  // namespace rt
@@ -18,201 +18,385 @@
  */
 #include "rt/renderer.h"
 
+#include <algorithm>
 #include <array>
+#include <stdexcept>
+#include <utility>
 
 #include "rt/debug.h"
 #include "rt/profiling.h"
 
-namespace {
-
-  // We're using an anonymous namespace so we're allowed to import rt::
-  using namespace rt;  // NOLINT(build/namespaces)
-
-  // Return the object with the closest intersection to ray, and set the
-  // distance to the intersection `t'. If no intersection, returns a
-  // nullptr.
-  static inline auto closestIntersect(const Ray &ray,
-                                      const Objects &objects,
-                                      Scalar *const restrict t) {
-    // Index of, and distance to closest intersect:
-    const Object *closest = nullptr;
-    *t = INFINITY;
-
-    // For each object:
-    for (size_t i = 0; i < objects.size(); i++) {
-      // Get intersect distance.
-      Scalar currentT = objects[i]->intersect(ray);
-
-      // Check if intersects, and if so, whether the
-      // intersection is closer than the current best.
-      if (currentT != 0 && currentT < *t) {
-        // New closest intersection.
-        *t = currentT;
-        closest = objects[i];
-      }
-    }
-
-    return closest;
-  }
-
-}  // namespace
-
 namespace rt {
 
   Renderer::Renderer(const Scene &_scene,
                      const rt::Camera *const restrict _camera,
                      const size_t _numDofSamples,
-                     const size_t _maxRayDepth)
+                     const size_t _maxRayDepth,
+                     const size_t _tileSize,
+                     const Scalar _minRayWeight,
+                     const Scalar _rouletteWeight)
     : scene(_scene), camera(_camera),
       maxRayDepth(_maxRayDepth),
-      numDofSamples(_numDofSamples) {}
+      minRayWeight(_minRayWeight),
+      rouletteWeight(_rouletteWeight),
+      numDofSamples(_numDofSamples),
+      tileSize(_tileSize) {
+    if (!tileSize)
+      throw std::invalid_argument("Tile size must be non-zero");
+  }
 
   Renderer::~Renderer() {}
 
+  CameraRays Renderer::cameraRays(const size_t width,
+                                  const size_t height) const {
+    return CameraRays(*camera, width, height, numDofSamples);
+  }
 
-  Colour Renderer::renderRegion(const Scalar regionX,
-                                const Scalar regionY,
-                                const Scalar regionSize,
-                                const Matrix &transform,
-                                const size_t depth) const {
-    std::array<Colour, 4> samples;
-    Colour supersamples[4];
-    Scalar subregion_x[4];
-    Scalar subregion_y[4];
-    Colour *sample;
-
-    if (debug::RECURSIVE_HIGHLIGHT_DEPTH > 0 &&
-        depth == debug::RECURSIVE_HIGHLIGHT_DEPTH) {
-      return Colour(debug::RECURSIVE_HIGHLIGHT_COLOUR);
-    }
+  void Renderer::sample(std::vector<Colour> *const sampled,
+                        const size_t width,
+                        const size_t height,
+                        const CameraRays &rays,
+                        const size_t stride,
+                        const bool skipCoarser,
+                        const size_t originX,
+                        const size_t originY) const {
+    // Iterate over the grid of points to sample.
+    const size_t columns = (width + stride - 1) / stride;
+    const size_t rows = (height + stride - 1) / stride;
+
+    forEachTile(columns, rows, [&](const size_t i, const size_t j) {
+      // Skip points sampled by a previous pass.
+      if (skipCoarser && !(i % 2) && !(j % 2))
+        return;
+
+      const size_t x = i * stride;
+      const size_t y = j * stride;
+
+      // Sample a point in the centre of the pixel.
+      (*sampled)[image::index(x, y, width)] =
+          renderPoint(originX + x + .5, originY + y + .5, rays);
+    }, true);
+  }
 
-    // Determine the size of a sample.
-    const Scalar subregionSize = regionSize / 2;
-    // Determine the offset to centre of a sample.
-    const Scalar subregionOffset = subregionSize / 2;
-
-    // Iterate over each subregion.
-    sample = &samples[0];
-    for (size_t index = 0; index < 4; index ++) {
-      const size_t i = image::x<size_t>(index, 2);
-      const size_t j = image::y<size_t>(index, 2);
-
-      // Determine subregion origin.
-      const Scalar x = regionX + i * subregionSize;
-      const Scalar y = regionY + j * subregionSize;
-
-      // Save X,Y coordinates for later.
-      subregion_x[index] = x;
-      subregion_y[index] = y;
-
-      // Take a sample at the centre of the subregion.
-      *sample++ = renderPoint(x + subregionOffset,
-                              y + subregionOffset,
-                              transform);
-    }
 
-    // Determine the average region colour.
-    Colour mean;
-    mean += samples[0];
-    mean += samples[1];
-    mean += samples[2];
-    mean += samples[3];
-    mean /= 4;
-
-    // If we've already recursed as far as we can do, there's
-    // nothing more to do.
-    if (depth >= maxSubpixelDepth)
-      return mean;
-
-    // Iterate over each sub-region.
-    for (size_t i = 0; i < 4; i++) {
-      sample = &samples[i];
-
-      // Determine the difference between the average region
-      // colour and the subregion sample.
-      const Scalar diff = mean.diff(*sample);
-
-      // If the difference is above a threshold, recursively
-      // supersample this region.
-      if (diff > maxSubpixelDiff) {
-        const auto x = subregion_x[i];
-        const auto y = subregion_y[i];
-
-        // Recursively evaluate sample.
-        *sample = renderRegion(x, y,
-                               regionSize / 4,
-                               transform,
-                               depth + 1);
+  void Renderer::antialias(std::vector<Colour> *const pixels,
+                           const size_t width,
+                           const size_t height,
+                           const std::vector<Colour> &sampled,
+                           const CameraRays &rays,
+                           const size_t originX,
+                           const size_t originY) const {
+    const size_t borderedWidth = width + 2;
+    std::vector<uint8_t> flagged(width * height);
+
+    // For each pixel in the image:
+    forEachTile(width, height, [&](const size_t x, const size_t y) {
+      const size_t index = image::index(x, y, width);
+
+      // Get the previously sampled pixel value.
+      const Colour &pixel = sampled[image::index(x + 1, y + 1,
+                                                 borderedWidth)];
+
+      // Create a list of all neighbouring element indices. The
+      // sampled grid has a 1 pixel border, so the neighbours of
+      // image pixel [x,y] are at [x,y] to [x+2,y+2] in the sampled
+      // grid.
+      const std::array<size_t, 8> neighbour_indices = {
+        image::index(x,     y,     borderedWidth),
+        image::index(x + 1, y,     borderedWidth),
+        image::index(x + 2, y,     borderedWidth),
+        image::index(x,     y + 1, borderedWidth),
+        image::index(x + 2, y + 1, borderedWidth),
+        image::index(x,     y + 2, borderedWidth),
+        image::index(x + 1, y + 2, borderedWidth),
+        image::index(x + 2, y + 2, borderedWidth)
+      };
+
+      // Calculate the difference between the neighbouring
+      // pixel values.
+      Scalar diffSum = 0;
+      for (const auto neighbour_index : neighbour_indices) {
+        const auto diff = pixel.diff(sampled[neighbour_index]);
+        diffSum += diff;
+      }
+
+      // If the difference is above a given threshold, flag the
+      // pixel for supersampling, which accumulates its colour from
+      // zero. Otherwise use the sample.
+      if (diffSum > maxPixelDiff * neighbour_indices.size())
+        flagged[index] = 1;
+      else
+        (*pixels)[index] = pixel;
+    });
+
+    // Queue a work item for each flagged pixel. Pixel regions are
+    // in the same (bordered) coordinates as the samples, so that
+    // the centre of each region is the pixel sample. The queue is
+    // drained one band of rows at a time, which bounds the memory
+    // used for memoised samples.
+    std::vector<Region> queue;
+    for (size_t band = 0; band < height; band += tileSize) {
+      queue.clear();
+      for (size_t y = band; y < std::min(band + tileSize, height); y++) {
+        for (size_t x = 0; x < width; x++) {
+          const size_t index = image::index(x, y, width);
+          if (flagged[index])
+            queue.push_back({static_cast<uint32_t>(index),
+                             static_cast<uint32_t>((x + 1) * latticeSize),
+                             static_cast<uint32_t>((y + 1) * latticeSize),
+                             0, {Region::unknown, Region::unknown,
+                                 Region::unknown, Region::unknown,
+                                 Region::unknown}});
+        }
       }
 
-      // Write updated value.
-      supersamples[i] = *sample;
+      refine(pixels, queue, sampled, borderedWidth, rays,
+             originX, originY);
     }
+  }
 
-    // Determine mean colour of supersampled subregions.
-    Colour output;
-    output += supersamples[0];
-    output += supersamples[1];
-    output += supersamples[2];
-    output += supersamples[3];
-    output /= 4;
+  void Renderer::renderTile(std::vector<Colour> *const pixels,
+                            const size_t width,
+                            const size_t height,
+                            const size_t x,
+                            const size_t y,
+                            const size_t w,
+                            const size_t h) const {
+    const CameraRays rays = cameraRays(width, height);
+
+    // Sample the tile with a 1 pixel border, which in the bordered
+    // coordinates of the whole image starts at [x,y].
+    const size_t borderedWidth = w + 2;
+    const size_t borderedHeight = h + 2;
+    std::vector<Colour> sampled(borderedWidth * borderedHeight);
+    sample(&sampled, borderedWidth, borderedHeight, rays, 1,
+           false, x, y);
+
+    pixels->assign(w * h, Colour());
+    antialias(pixels, w, h, sampled, rays, x, y);
+  }
 
-    return output;
+  void Renderer::refine(std::vector<Colour> *const pixels,
+                        std::vector<Region> queue,
+                        const std::vector<Colour> &sampled,
+                        const size_t borderedWidth,
+                        const CameraRays &rays,
+                        const size_t originX,
+                        const size_t originY) const {
+    // Sample values, indexed by Region::samples.
+    std::vector<Colour> values;
+
+    // The centres of whole pixels were sampled by the first pass.
+    for (auto &region : queue) {
+      region.samples[0] = static_cast<uint32_t>(values.size());
+      values.push_back(sampled[image::index<size_t>(
+          region.x / latticeSize, region.y / latticeSize,
+          borderedWidth)]);
+    }
+
+    // Corners which are requested by a region sample, as pairs of
+    // packed lattice coordinates and sample slots.
+    std::vector<std::pair<uint64_t, uint32_t>> requests;
+    // Sample index of each distinct corner, hashed by coordinates.
+    std::vector<std::pair<uint64_t, uint32_t>> table;
+    const uint64_t empty = UINT64_MAX;
+    // Lattice points to sample at this depth.
+    std::vector<uint64_t> points;
+    std::vector<Colour> estimates;
+    std::vector<uint8_t> split;
+    std::vector<Region> next;
+
+    for (uint32_t depth = 0; !queue.empty(); depth++) {
+      profiling::counters::incRefinementCount(depth, queue.size());
+
+      const uint32_t size = latticeSize >> depth;
+      const size_t first = values.size();
+
+      // Gather the unknown samples. Centres are never shared, but
+      // corners may be shared by up to four regions.
+      requests.clear();
+      points.clear();
+      for (size_t i = 0; i < queue.size(); i++) {
+        Region &region = queue[i];
+
+        if (region.samples[0] == Region::unknown) {
+          region.samples[0] = static_cast<uint32_t>(
+              first + points.size());
+          points.push_back(static_cast<uint64_t>(region.y + size / 2)
+                           << 32 | (region.x + size / 2));
+        }
+
+        for (uint32_t j = 1; j < 5; j++) {
+          if (region.samples[j] == Region::unknown) {
+            const uint32_t x = region.x + (j - 1) % 2 * size;
+            const uint32_t y = region.y + (j - 1) / 2 * size;
+            requests.push_back({static_cast<uint64_t>(y) << 32 | x,
+                                static_cast<uint32_t>(5 * i + j)});
+          }
+        }
+      }
+
+      // Assign one sample to each distinct corner, using an open
+      // addressing hash table of lattice points.
+      size_t capacity = 1;
+      while (capacity < 2 * requests.size())
+        capacity *= 2;
+      table.assign(capacity, {empty, 0});
+
+      for (const auto &request : requests) {
+        size_t slot = random::mix(request.first) & (capacity - 1);
+        while (table[slot].first != empty &&
+               table[slot].first != request.first)
+          slot = (slot + 1) & (capacity - 1);
+
+        if (table[slot].first == empty) {
+          table[slot] = {request.first,
+                         static_cast<uint32_t>(first + points.size())};
+          points.push_back(request.first);
+        }
+
+        queue[request.second / 5].samples[request.second % 5] =
+            table[slot].second;
+      }
+      profiling::counters::incSubsampleCount(depth, points.size());
+
+      // Trace the samples.
+      values.resize(first + points.size());
+      forEachIndex(points.size(), [&](const size_t i) {
+        const Scalar x = static_cast<Scalar>(points[i] & 0xffffffff);
+        const Scalar y = static_cast<Scalar>(points[i] >> 32);
+
+        // Lattice coordinates are exact in a Scalar, so the point is
+        // the same wherever the grid's origin is.
+        values[first + i] = renderPoint(originX + x / latticeSize,
+                                        originY + y / latticeSize,
+                                        rays);
+      });
+
+      // Evaluate each region.
+      estimates.resize(queue.size());
+      split.resize(queue.size());
+      forEachIndex(queue.size(), [&](const size_t i) {
+        const Region &region = queue[i];
+
+        if (debug::RECURSIVE_HIGHLIGHT_DEPTH > 0 &&
+            depth == debug::RECURSIVE_HIGHLIGHT_DEPTH) {
+          estimates[i] = Colour(debug::RECURSIVE_HIGHLIGHT_COLOUR);
+          split[i] = 0;
+          return;
+        }
+
+        // Determine the average region colour.
+        Colour mean;
+        for (const auto sample : region.samples)
+          mean += values[sample];
+        mean /= 5;
+
+        // If any sample differs from the mean by more than a
+        // threshold, and we haven't recursed as far as we can,
+        // subdivide the region.
+        split[i] = 0;
+        if (depth < maxSubpixelDepth) {
+          for (const auto sample : region.samples)
+            if (mean.diff(values[sample]) > maxSubpixelDiff)
+              split[i] = 1;
+        }
+
+        estimates[i] = mean;
+      });
+
+      // Accumulate finished regions into their pixels, weighted by
+      // area, and queue the subregions of those which need
+      // refinement. This is cheap compared to sampling, so is done
+      // serially, which keeps the output independent of thread
+      // scheduling.
+      const Scalar area = Scalar(1) / static_cast<Scalar>(1u << (2 * depth));
+      next.clear();
+      for (size_t i = 0; i < queue.size(); i++) {
+        const Region &region = queue[i];
+
+        if (!split[i]) {
+          (*pixels)[region.pixel] += estimates[i] * area;
+          continue;
+        }
+
+        // Each subregion shares one corner with its parent, and its
+        // opposite corner is the parent's centre.
+        for (uint32_t j = 0; j < 4; j++) {
+          Region subregion{region.pixel,
+                           region.x + j % 2 * (size / 2),
+                           region.y + j / 2 * (size / 2),
+                           depth + 1,
+                           {Region::unknown, Region::unknown,
+                            Region::unknown, Region::unknown,
+                            Region::unknown}};
+          subregion.samples[1 + j] = region.samples[1 + j];
+          subregion.samples[4 - j] = region.samples[0];
+          next.push_back(subregion);
+        }
+      }
+      queue.swap(next);
+    }
   }
 
   Colour Renderer::renderPoint(const Scalar x,
                                const Scalar y,
-                               const Matrix &transform) const {
+                               const CameraRays &rays) const {
     Colour output;
 
-    // Convert image to camera space coordinates.
-    const Vector imageOrigin = transform * Vector(x, y, 0);
-
-    // Translate camera space to world space.
-    const Vector focalOrigin =
-      camera->right * imageOrigin.x +
-      camera->up * imageOrigin.y +
-      camera->position * 1;
-
-    // Determine direction from point on lens to
-    // exposure point.
-    const Vector focalDirection =
-      (focalOrigin - camera->filmBack).normalise();
-
-    // Determine the focus point of the pixel.
-    const Vector focalPoint = camera->filmBack +
-      focalDirection * camera->focusDistance;
-
-    // Accumulate numDofSamples samples.
-    for (size_t i = 0; i < numDofSamples; i++) {
-      // Convert image to camera space coordinates.
-      const Vector cameraSpace = imageOrigin +
-        camera->lens.aperture();
-
-      // Translate camera space to world space.
-      const Vector worldSpace =
-        camera->right * cameraSpace.x +
-        camera->up * cameraSpace.y +
-        camera->position;
-
-      // Determine direction from point on lens
-      // to focus point.
-      const Vector direction =
-        (focalPoint - worldSpace)
-        .normalise();
-
-      // Create a ray.
-      const Ray ray = Ray(worldSpace, direction);
-
-      // Sample the ray.
-      output += trace(ray) / numDofSamples;
+    // The point on the film, and the point which rays through it are
+    // focused on.
+    const Vector film = rays.film(x, y);
+    const Vector focus = rays.focus(film);
+
+    // Random streams are keyed by the sample position. Shading
+    // samples use odd streams.
+    const seed key = random::key(x, y);
+
+    // Return the primary ray of the i-th DoF sample.
+    const auto primaryRay = [&](const size_t i) {
+      return rays.ray(film, focus, i);
+    };
+
+    // With a single sample there is nothing to gain from packets.
+    if (numDofSamples == 1) {
+      RandomStream rng(key, 1);
+      return trace(primaryRay(0), rng);
+    }
+
+    // Accumulate numDofSamples samples, tracing the primary rays
+    // in packets. The rays of a pixel all converge on its focus
+    // point, so they are coherent.
+    for (size_t i = 0; i < numDofSamples; i += packetSize) {
+      const size_t n = std::min(packetSize, numDofSamples - i);
+      const RayPacket packet(n, [&](const size_t j) {
+        return primaryRay(i + j);
+      });
+
+      PacketHit hit;
+      scene.index.closestIntersect(packet, &hit);
+
+      for (size_t j = 0; j < n; j++) {
+        // Bump profiling counter.
+        profiling::counters::incTraceCount();
+
+        // If the ray doesn't intersect any object, do nothing.
+        if (hit.object[j] == nullptr) {
+          profiling::counters::incRayDepthCount(0);
+          continue;
+        }
+
+        RandomStream rng(key, 2 * (i + j) + 1);
+        output += shade(packet[j], hit.object[j], hit.t[j], rng)
+                  / numDofSamples;
+      }
     }
 
     return output;
   }
 
   Colour Renderer::trace(const Ray &ray,
-                         const unsigned int depth) const {
+                         RandomStream &rng) const {
     Colour colour;
 
     // Bump profiling counter.
@@ -221,40 +405,91 @@ namespace rt {
     // Determine the closet ray-object intersection (if any).
     Scalar t;
     const Object *const restrict object =
-      closestIntersect(ray, scene.objects, &t);
+      scene.index.closestIntersect(ray, &t);
     // If the ray doesn't intersect any object, do nothing.
-    if (object == nullptr)
+    if (object == nullptr) {
+      profiling::counters::incRayDepthCount(0);
       return colour;
+    }
+
+    return shade(ray, object, t, rng);
+  }
+
+  Colour Renderer::shade(const Ray &ray,
+                         const Object *restrict object,
+                         Scalar t,
+                         RandomStream &rng) const {
+    Colour colour;
+    // The current ray of the path. Rays are immutable, so the ray is
+    // rebuilt on each bounce.
+    Scalar position[3] = {ray.position.x, ray.position.y, ray.position.z};
+    Scalar direction[3] = {ray.direction.x, ray.direction.y,
+                           ray.direction.z};
+    // The product of the reflectivities along the path.
+    Scalar weight = 1;
+    size_t depth = 0;
+
+    while (true) {
+      const Ray current(Vector(position[0], position[1], position[2]),
+                        Vector(direction[0], direction[1], direction[2]));
+      // Point of intersection.
+      const Vector intersect = current.position + current.direction * t;
+      // Surface normal at point of intersection.
+      const Vector normal = object->normal(intersect);
+      // Direction between intersection and source ray.
+      const Vector toRay = (current.position - intersect).normalise();
+      // Material at point of intersection.
+      const Material *material = object->surface(intersect);
+
+      // Apply ambient lighting.
+      Colour local = material->colour * material->ambient;
+
+      // Apply shading from each light source.
+      for (size_t i = 0; i < scene.lights.size(); i++)
+        local += scene.lights[i]->shade(intersect, normal, toRay,
+                                        material, scene.index, rng);
+
+      colour += local * weight;
+
+      // Stop if there is no reflection, or it would be too faint to
+      // see.
+      const Scalar reflectivity = material->reflectivity;
+      if (depth >= maxRayDepth || reflectivity <= 0 ||
+          weight * reflectivity < minRayWeight)
+        break;
+      weight *= reflectivity;
+
+      // Russian roulette.
+      if (weight < rouletteWeight) {
+        const Scalar survival = weight / rouletteWeight;
+        if (rng() >= survival)
+          break;
+        weight /= survival;
+      }
 
-    // Point of intersection.
-    const Vector intersect = ray.position + ray.direction * t;
-    // Surface normal at point of intersection.
-    const Vector normal = object->normal(intersect);
-    // Direction between intersection and source ray.
-    const Vector toRay = (ray.position - intersect).normalise();
-    // Material at point of intersection.
-    const Material *material = object->surface(intersect);
-
-    // Apply ambient lighting.
-    colour += material->colour * material->ambient;
-
-    // Apply shading from each light source.
-    for (size_t i = 0; i < scene.lights.size(); i++)
-      colour += scene.lights[i]->shade(intersect, normal, toRay,
-                                       material, scene.objects);
-
-    // Create reflection ray and recursive evaluate.
-    const Scalar reflectivity = material->reflectivity;
-    if (depth < maxRayDepth && reflectivity > 0) {
       // Direction of reflected ray.
       const Vector reflectionDirection = (normal * 2*(normal ^ toRay)
                                           - toRay).normalise();
       // Create a reflection.
       const Ray reflection(intersect, reflectionDirection);
-      // Add reflection light.
-      colour += trace(reflection, depth + 1) * reflectivity;
+      depth++;
+
+      // Bump profiling counter.
+      profiling::counters::incTraceCount();
+
+      object = scene.index.closestIntersect(reflection, &t);
+      if (object == nullptr)
+        break;
+
+      position[0] = intersect.x;
+      position[1] = intersect.y;
+      position[2] = intersect.z;
+      direction[0] = reflectionDirection.x;
+      direction[1] = reflectionDirection.y;
+      direction[2] = reflectionDirection.z;
     }
 
+    profiling::counters::incRayDepthCount(depth);
     return colour;
   }
 
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2015, 2016 Chris Cummins.
+ *
+ * This file is part of rt.
+ *
+ * rt is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the
+ * Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * rt is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rt.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// Scene files and the compiled scene cache.
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "rt/loader.h"
+
+namespace {
+
+// A path in the test's scratch directory.
+std::string scratch(const std::string &name) {
+  const char *const dir = std::getenv("TEST_TMPDIR");
+  return std::string(dir ? dir : "/tmp") + "/rt_loader_" + name;
+}
+
+void write(const std::string &path, const std::string &text) {
+  std::ofstream out(path, std::ios::trunc);
+  out << text;
+}
+
+std::string sphere(const std::string &size) {
+  return "[Object.Sphere]\nPosition: 0 0 0\nSize: " + size
+      + "\nMaterial: $Material.m\n";
+}
+
+// A scene file which imports its spheres from another file.
+class LoaderTest : public ::testing::Test {
+ protected:
+  const std::string scene = scratch("scene.rt");
+  const std::string spheres = scratch("spheres.rt");
+  const std::string cache = scratch("scene.cache");
+
+  void SetUp() override {
+    write(scene,
+          "[Lens.l]\nFocalLength: 36\n"
+          "[Film.f]\nWidth: 36\nHeight: 24\n"
+          "[Camera.Perspective]\nPosition: 0 0 3000\nLookat: 0 0 0\n"
+          "Lens: $Lens.l\nFilm: $Film.f\n"
+          "[Material.m]\nColour: 0xff8000\nDiffuse: 100\n"
+          "[Light.Soft]\nPosition: 0 2000 0\nSize: 100\n"
+          "[Object.Plane]\nPosition: 0 -1000 0\nDirection: 0 1 0\n"
+          "Material: $Material.m\n"
+          "@import rt_loader_spheres.rt\n");
+    write(spheres, sphere("100") + sphere("200"));
+    std::remove(cache.c_str());
+  }
+
+  void TearDown() override {
+    std::remove(scene.c_str());
+    std::remove(spheres.c_str());
+    std::remove(cache.c_str());
+  }
+};
+
+TEST_F(LoaderTest, parseRecordsSources) {
+  const rt::SceneDescription d = rt::scene::parse(scene);
+
+  ASSERT_EQ(2u, d.sources.size());
+  ASSERT_EQ(scene, d.sources[0].path);
+  ASSERT_EQ(spheres, d.sources[1].path);
+  ASSERT_EQ(3u, d.objects.size());
+}
+
+TEST_F(LoaderTest, cacheRoundTrip) {
+  const rt::LoadedScene parsed(rt::scene::parse(scene));
+  rt::scene::writeCache(cache, parsed.description,
+                        parsed.scene->index.hierarchy());
+  const std::unique_ptr<rt::LoadedScene> cached =
+      rt::scene::readCache(cache);
+
+  const rt::SceneDescription &a = parsed.description;
+  const rt::SceneDescription &b = cached->description;
+
+  ASSERT_EQ(a.materials.size(), b.materials.size());
+  ASSERT_EQ(0, std::memcmp(a.materials.data(), b.materials.data(),
+                           a.materials.size() * sizeof(a.materials[0])));
+  ASSERT_EQ(a.objects.size(), b.objects.size());
+  ASSERT_EQ(0, std::memcmp(a.objects.data(), b.objects.data(),
+                           a.objects.size() * sizeof(a.objects[0])));
+  ASSERT_EQ(a.lights.size(), b.lights.size());
+  ASSERT_EQ(0, std::memcmp(a.lights.data(), b.lights.data(),
+                           a.lights.size() * sizeof(a.lights[0])));
+  ASSERT_EQ(0, std::memcmp(&a.camera, &b.camera, sizeof(a.camera)));
+  ASSERT_EQ(0, std::memcmp(&a.settings, &b.settings, sizeof(a.settings)));
+  ASSERT_EQ(a.path, b.path);
+
+  ASSERT_EQ(a.sources.size(), b.sources.size());
+  for (size_t i = 0; i < a.sources.size(); i++) {
+    ASSERT_EQ(a.sources[i].path, b.sources[i].path);
+    ASSERT_EQ(a.sources[i].size, b.sources[i].size);
+    ASSERT_EQ(a.sources[i].hash, b.sources[i].hash);
+  }
+
+  const rt::BVH &x = parsed.scene->index.hierarchy();
+  const rt::BVH &y = cached->scene->index.hierarchy();
+  ASSERT_EQ(x.indices, y.indices);
+  ASSERT_EQ(x.nodes.size(), y.nodes.size());
+  ASSERT_EQ(0, std::memcmp(x.nodes.data(), y.nodes.data(),
+                           x.nodes.size() * sizeof(x.nodes[0])));
+}
+
+TEST_F(LoaderTest, readCacheRejectsChangedImport) {
+  const rt::LoadedScene parsed(rt::scene::parse(scene));
+  rt::scene::writeCache(cache, parsed.description,
+                        parsed.scene->index.hierarchy());
+
+  // The same size, and most likely within the same second.
+  write(spheres, sphere("100") + sphere("300"));
+  ASSERT_THROW(rt::scene::readCache(cache), std::runtime_error);
+}
+
+TEST_F(LoaderTest, readCacheRejectsMissingSource) {
+  const rt::LoadedScene parsed(rt::scene::parse(scene));
+  rt::scene::writeCache(cache, parsed.description,
+                        parsed.scene->index.hierarchy());
+
+  std::remove(spheres.c_str());
+  ASSERT_THROW(rt::scene::readCache(cache), std::runtime_error);
+}
+
+TEST_F(LoaderTest, loadRebuildsCacheOnImportChange) {
+  ASSERT_EQ(3u, rt::scene::load(scene, cache)->description.objects.size());
+  ASSERT_EQ(3u, rt::scene::load(scene, cache)->description.objects.size());
+
+  write(spheres, sphere("100") + sphere("200") + sphere("300"));
+  ASSERT_EQ(4u, rt::scene::load(scene, cache)->description.objects.size());
+  ASSERT_EQ(4u, rt::scene::readCache(cache)->description.objects.size());
+}
+
+TEST_F(LoaderTest, loadRebuildsCacheOfAnotherScene) {
+  const std::string other = scratch("other.rt");
+  write(other, "@import rt_loader_scene.rt\n" + sphere("400"));
+
+  ASSERT_EQ(3u, rt::scene::load(scene, cache)->description.objects.size());
+  ASSERT_EQ(4u, rt::scene::load(other, cache)->description.objects.size());
+
+  std::remove(other.c_str());
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}